@@ -0,0 +1,323 @@
+/** @file
+ * @brief Implementacja wielkich liczb całkowitych we współczynnikach wielomianów.
+ *
+ * @author Maurycy Wojda
+ * @date 2021
+ */
+
+#include "bigcoeff.h"
+#include "coeff.h"
+#include "safealloc.h"
+#include <limits.h>
+#include <string.h>
+
+/**
+ * Największa potęga dziesięciu mieszcząca się w słowie.
+ */
+#define BIG_DECIMAL_BASE 10000000000000000000ULL
+
+/**
+ * Liczba cyfr dziesiętnych potęgi BIG_DECIMAL_BASE.
+ */
+#define BIG_DECIMAL_DIGITS 19
+
+/**
+ * To jest struktura widoku wielomianu stałego jako znaku
+ * i wartości bezwzględnej.
+ */
+typedef struct BigView
+{
+	const uint64_t *limbs; ///< słowa wartości bezwzględnej od najmniej znaczącego
+	size_t length; ///< liczba słów, 0 dla zera
+	bool negative; ///< czy liczba jest ujemna?
+} BigView;
+
+/**
+ * Tworzy widok wielomianu stałego.
+ * @param[in] p : wielomian stały
+ * @param[out] word : miejsce na słowo współczynnika, który nie jest wielką liczbą
+ * @return widok liczby
+ */
+static BigView BigViewOf(const Poly *p, uint64_t *word)
+{
+	if (PolyIsBig(p))
+	{
+		const BigCoeff *big = BigOf(p);
+		return (BigView){.limbs = big->limbs, .length = big->length, .negative = big->negative};
+	}
+	*word = p->coeff < 0 ? -(uint64_t)p->coeff : (uint64_t)p->coeff;
+	return (BigView){.limbs = word, .length = *word != 0, .negative = p->coeff < 0};
+}
+
+/**
+ * Alokuje blok wielkiej liczby nieujemnej.
+ * @param[in] length : liczba słów
+ * @return blok zaalokowany funkcją poolMalloc
+ */
+static BigCoeff *BigAlloc(size_t length)
+{
+	BigCoeff *big = poolMalloc(sizeof(BigCoeff) + length * sizeof(uint64_t));
+	big->length = length;
+	big->negative = false;
+	return big;
+}
+
+/**
+ * Porównuje wartości bezwzględne liczb.
+ * @param[in] a : widok pierwszej liczby
+ * @param[in] b : widok drugiej liczby
+ * @return znormalizowana różnica wartości bezwzględnych @f$\in\{-1,0,1\}@f$
+ */
+static int BigCompareAbs(BigView a, BigView b)
+{
+	if (a.length != b.length)
+		return a.length < b.length ? -1 : 1;
+	for (size_t i = a.length; i-- > 0;)
+		if (a.limbs[i] != b.limbs[i])
+			return a.limbs[i] < b.limbs[i] ? -1 : 1;
+	return 0;
+}
+
+/**
+ * Wylicza resztę z dzielenia wartości bezwzględnej liczby przez moduł.
+ * @param[in] limbs : słowa wartości bezwzględnej
+ * @param[in] length : liczba słów
+ * @param[in] mod : niezerowy moduł
+ * @return reszta z dzielenia
+ */
+static uint64_t BigModAbs(const uint64_t limbs[], size_t length, uint64_t mod)
+{
+	uint64_t rest = 0;
+	for (size_t i = length; i-- > 0;)
+		rest = (uint64_t)((((unsigned __int128)rest << 64) | limbs[i]) % mod);
+	return rest;
+}
+
+/*
+Wyjaśnienie implementacji:
+Liczbę, która mieści się w typie poly_coeff_t, zamieniam na zwykły
+	współczynnik, więc wielka liczba nigdy nie ma dwóch reprezentacji.
+	Pozostałe liczby w trybie sprawdzanym zostają wielkimi liczbami,
+	o ile nie są dłuższe niż BIG_MAX_LIMBS słów. Dłuższy wynik w trybie
+	sprawdzanym jest błędem: zawinięta wartość udawałaby dokładną, więc
+	zamiast niej daję zero i podnoszę flagę przekroczenia limitu.
+	W trybie modularnym liczę dokładną resztę, a w trybie domyślnym
+	zawijam liczbę modulo @f$2^{64}@f$.
+*/
+/**
+ * Sprowadza wynik działania do postaci kanonicznej w bieżącym trybie
+ * arytmetyki, przejmując jego blok na własność.
+ * @param[in] big : blok wyniku, którego słowa mogą mieć zera na początku
+ * @return wielomian stały równy wynikowi
+ */
+static Poly BigFinish(BigCoeff *big)
+{
+	while (big->length > 0 && big->limbs[big->length - 1] == 0)
+		big->length--;
+
+	uint64_t low = big->length > 0 ? big->limbs[0] : 0;
+	uint64_t wrapped = big->negative ? -low : low;
+	bool fits = big->length <= 1 &&
+	            (low <= (uint64_t)LONG_MAX || (big->negative && low == (uint64_t)LONG_MAX + 1));
+	Poly result;
+	if (fits)
+	{
+		result = PolyFromCoeff(CoeffReduce((poly_coeff_t)wrapped));
+	}
+	else if (CoeffIsChecked())
+	{
+		if (big->length <= BIG_MAX_LIMBS)
+		{
+			poolRealloc((void**)&big, sizeof(BigCoeff) + big->length * sizeof(uint64_t));
+			return (Poly){.size = 0, .arr = (Mono*)(void*)big};
+		}
+		CoeffTooBig();
+		result = PolyZero();
+	}
+	else if (CoeffIsModular())
+	{
+		uint64_t rest = BigModAbs(big->limbs, big->length, coeffMode.mod);
+		result = PolyFromCoeff((poly_coeff_t)(big->negative && rest != 0 ? coeffMode.mod - rest : rest));
+	}
+	else
+	{
+		result = PolyFromCoeff((poly_coeff_t)wrapped);
+	}
+
+	poolFree(big);
+	return result;
+}
+
+/*
+Wyjaśnienie implementacji:
+Przy równych znakach dodaję wartości bezwzględne, a przy różnych
+	odejmuję mniejszą od większej, więc wynik ma znak liczby o większej
+	wartości bezwzględnej. Przeniesienia i pożyczki liczę słowo po słowie.
+*/
+Poly BigAdd(const Poly *a, const Poly *b)
+{
+	uint64_t wordA, wordB;
+	BigView x = BigViewOf(a, &wordA), y = BigViewOf(b, &wordB);
+	if (x.negative != y.negative && BigCompareAbs(x, y) < 0)
+	{
+		BigView swap = x;
+		x = y;
+		y = swap;
+	}
+
+	BigCoeff *sum = BigAlloc((x.length > y.length ? x.length : y.length) + 1);
+	sum->negative = x.negative;
+	uint64_t carry = 0;
+	for (size_t i = 0; i < sum->length; i++)
+	{
+		uint64_t u = i < x.length ? x.limbs[i] : 0, v = i < y.length ? y.limbs[i] : 0;
+		if (x.negative == y.negative)
+		{
+			unsigned __int128 digit = (unsigned __int128)u + v + carry;
+			sum->limbs[i] = (uint64_t)digit;
+			carry = (uint64_t)(digit >> 64);
+		}
+		else
+		{
+			uint64_t difference = u - v;
+			sum->limbs[i] = difference - carry;
+			carry = (u < v) | (difference < carry);
+		}
+	}
+	return BigFinish(sum);
+}
+
+Poly BigMul(const Poly *a, const Poly *b)
+{
+	uint64_t wordA, wordB;
+	BigView x = BigViewOf(a, &wordA), y = BigViewOf(b, &wordB);
+	if (x.length == 0 || y.length == 0)
+		return PolyZero();
+
+	BigCoeff *product = BigAlloc(x.length + y.length);
+	product->negative = x.negative != y.negative;
+	memset(product->limbs, 0, product->length * sizeof(uint64_t));
+	for (size_t i = 0; i < x.length; i++)
+	{
+		uint64_t carry = 0;
+		for (size_t j = 0; j < y.length; j++)
+		{
+			unsigned __int128 digit = (unsigned __int128)x.limbs[i] * y.limbs[j] +
+			                          product->limbs[i + j] + carry;
+			product->limbs[i + j] = (uint64_t)digit;
+			carry = (uint64_t)(digit >> 64);
+		}
+		product->limbs[i + y.length] = carry;
+	}
+	return BigFinish(product);
+}
+
+Poly BigNeg(const Poly *a)
+{
+	uint64_t word;
+	BigView x = BigViewOf(a, &word);
+	BigCoeff *neg = BigAlloc(x.length);
+	neg->negative = !x.negative;
+	memcpy(neg->limbs, x.limbs, x.length * sizeof(uint64_t));
+	return BigFinish(neg);
+}
+
+Poly BigExp(poly_coeff_t a, poly_exp_t b)
+{
+	assert(b >= 0);
+	Poly base = PolyFromCoeff(a), result = PolyFromCoeff(1), next;
+	for (; b; b /= 2)
+	{
+		if (b&1)
+		{
+			next = LeafMul(&result, &base);
+			PolyDestroy(&result);
+			result = next;
+		}
+		if (b > 1)
+		{
+			next = LeafMul(&base, &base);
+			PolyDestroy(&base);
+			base = next;
+		}
+	}
+	PolyDestroy(&base);
+	return result;
+}
+
+bool BigIsEq(const Poly *a, const Poly *b)
+{
+	uint64_t wordA, wordB;
+	BigView x = BigViewOf(a, &wordA), y = BigViewOf(b, &wordB);
+	return x.negative == y.negative && BigCompareAbs(x, y) == 0;
+}
+
+Poly BigFromLimbs(bool negative, const uint64_t limbs[], size_t length)
+{
+	BigCoeff *big = BigAlloc(length);
+	big->negative = negative;
+	memcpy(big->limbs, limbs, length * sizeof(uint64_t));
+	return BigFinish(big);
+}
+
+Poly BigReduce(const Poly *a)
+{
+	if (CoeffIsChecked())
+		return PolyClone(a);
+	const BigCoeff *big = BigOf(a);
+	return BigFromLimbs(big->negative, big->limbs, big->length);
+}
+
+poly_coeff_t BigWrap(const Poly *a)
+{
+	const BigCoeff *big = BigOf(a);
+	return (poly_coeff_t)(big->negative ? -big->limbs[0] : big->limbs[0]);
+}
+
+/*
+Wyjaśnienie implementacji:
+Dzielę kopię wartości bezwzględnej przez BIG_DECIMAL_BASE, dopóki nie
+	wyzeruje się, i dopisuję cyfry kolejnych reszt od najmniej
+	znaczącej. Wszystkie reszty poza ostatnią mają dokładnie
+	BIG_DECIMAL_DIGITS cyfr, razem z zerami wiodącymi. Na końcu odwracam
+	zapis, więc cyfry trafiają na swoje miejsca.
+*/
+char *BigToString(const Poly *a, size_t *length)
+{
+	const BigCoeff *big = BigOf(a);
+	size_t count = big->length, size = 0;
+	uint64_t *rest = safeMalloc(count * sizeof(uint64_t));
+	memcpy(rest, big->limbs, count * sizeof(uint64_t));
+	char *text = safeMalloc(20 * count + 2);
+
+	while (count > 0)
+	{
+		uint64_t chunk = 0;
+		for (size_t i = count; i-- > 0;)
+		{
+			unsigned __int128 current = ((unsigned __int128)chunk << 64) | rest[i];
+			rest[i] = (uint64_t)(current / BIG_DECIMAL_BASE);
+			chunk = (uint64_t)(current % BIG_DECIMAL_BASE);
+		}
+		while (count > 0 && rest[count - 1] == 0)
+			count--;
+		for (int d = 0; d < BIG_DECIMAL_DIGITS && (count > 0 || chunk != 0); d++)
+		{
+			text[size++] = (char)('0' + chunk % 10);
+			chunk /= 10;
+		}
+	}
+	if (big->negative)
+		text[size++] = '-';
+
+	for (size_t i = 0; i < size / 2; i++)
+	{
+		char swap = text[i];
+		text[i] = text[size - 1 - i];
+		text[size - 1 - i] = swap;
+	}
+	text[size] = '\0';
+	free(rest);
+	*length = size;
+	return text;
+}
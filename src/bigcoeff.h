@@ -0,0 +1,126 @@
+/** @file
+ * @brief Interfejs wielkich liczb całkowitych we współczynnikach wielomianów.
+ *
+ * W trybie sprawdzanym współczynnik, który nie mieści się w typie
+ * poly_coeff_t, jest promowany do wielkiej liczby. Wielka liczba jest
+ * wielomianem stałym, którego pole `arr` wskazuje na blok z puli z jej
+ * wartością, a pole `size` jest równe 0, co odróżnia ją od niepustej
+ * tablicy jednomianów. Blok ma licznik referencji jak tablice jednomianów
+ * i nigdy nie jest modyfikowany, więc kopie wielkiej liczby go współdzielą.
+ * Wielka liczba nigdy nie mieści się w typie poly_coeff_t, dzięki czemu
+ * każda liczba ma jedną reprezentację.
+ *
+ * Funkcje przyjmują dowolne wielomiany stałe, a wynik sprowadzają
+ * do bieżącego trybu arytmetyki. Wynik dłuższy niż BIG_MAX_LIMBS słów
+ * nie jest zwracany: zamiast niego funkcje dają zero i podnoszą flagę
+ * przekroczenia limitu, sprawdzaną funkcją PolyTakeTooBig.
+ *
+ * @author Maurycy Wojda
+ * @date 2021
+ */
+
+#ifndef __BIG_COEFF_H__
+#define __BIG_COEFF_H__
+
+#include "poly.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Największa liczba 64-bitowych słów wielkiej liczby.
+ */
+#define BIG_MAX_LIMBS 1024
+
+/**
+ * To jest struktura bloku wielkiej liczby.
+ * Liczba jest zapisana jako znak i wartość bezwzględna.
+ */
+typedef struct BigCoeff
+{
+	size_t length; ///< liczba słów, najbardziej znaczące jest niezerowe
+	bool negative; ///< czy liczba jest ujemna?
+	uint64_t limbs[]; ///< słowa wartości bezwzględnej od najmniej znaczącego
+} BigCoeff;
+
+/**
+ * Daje blok wielkiej liczby.
+ * @param[in] p : wielka liczba
+ * @return blok z wartością liczby
+ */
+static inline const BigCoeff *BigOf(const Poly *p)
+{
+	assert(PolyIsBig(p));
+	return (const BigCoeff*)(const void*)p->arr;
+}
+
+/**
+ * Dodaje dokładnie wielomiany stałe.
+ * @param[in] a : wielomian stały @f$a@f$
+ * @param[in] b : wielomian stały @f$b@f$
+ * @return @f$a + b@f$
+ */
+Poly BigAdd(const Poly *a, const Poly *b);
+
+/**
+ * Mnoży dokładnie wielomiany stałe.
+ * @param[in] a : wielomian stały @f$a@f$
+ * @param[in] b : wielomian stały @f$b@f$
+ * @return @f$a \cdot b@f$
+ */
+Poly BigMul(const Poly *a, const Poly *b);
+
+/**
+ * Zwraca dokładnie przeciwny wielomian stały.
+ * @param[in] a : wielomian stały @f$a@f$
+ * @return @f$-a@f$
+ */
+Poly BigNeg(const Poly *a);
+
+/**
+ * Potęguje dokładnie współczynnik.
+ * @param[in] a : współczynnik
+ * @param[in] b : nieujemna potęga
+ * @return @f$a^b@f$
+ */
+Poly BigExp(poly_coeff_t a, poly_exp_t b);
+
+/**
+ * Sprawdza równość wielomianów stałych.
+ * @param[in] a : wielomian stały @f$a@f$
+ * @param[in] b : wielomian stały @f$b@f$
+ * @return @f$a = b@f$
+ */
+bool BigIsEq(const Poly *a, const Poly *b);
+
+/**
+ * Tworzy liczbę o podanym znaku i wartości bezwzględnej.
+ * @param[in] negative : czy liczba jest ujemna?
+ * @param[in] limbs : słowa wartości bezwzględnej od najmniej znaczącego
+ * @param[in] length : liczba słów
+ * @return wielomian stały równy liczbie w bieżącym trybie
+ */
+Poly BigFromLimbs(bool negative, const uint64_t limbs[], size_t length);
+
+/**
+ * Sprowadza wielką liczbę do bieżącego trybu arytmetyki.
+ * @param[in] a : wielka liczba
+ * @return wielomian stały równy @p a w bieżącym trybie
+ */
+Poly BigReduce(const Poly *a);
+
+/**
+ * Zwraca wielką liczbę zawiniętą modulo @f$2^{64}@f$.
+ * @param[in] a : wielka liczba
+ * @return @f$a \bmod 2^{64}@f$ jako poly_coeff_t
+ */
+poly_coeff_t BigWrap(const Poly *a);
+
+/**
+ * Zamienia wielką liczbę na zapis dziesiętny.
+ * @param[in] a : wielka liczba
+ * @param[out] length : długość zapisu
+ * @return zapis zaalokowany funkcją safeMalloc, do zwolnienia przez free
+ */
+char *BigToString(const Poly *a, size_t *length);
+
+#endif /* __BIG_COEFF_H__ */
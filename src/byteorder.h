@@ -0,0 +1,65 @@
+/** @file
+ * @brief Zapis i odczyt liczb w porządku little-endian.
+ *
+ * Formaty plików migawek stosu i skompilowanych skryptów zapisują
+ * wszystkie liczby w porządku little-endian, niezależnie od porządku
+ * bajtów maszyny.
+ *
+ * @author Maurycy Wojda
+ * @date 2021
+ */
+
+#ifndef __BYTE_ORDER_H__
+#define __BYTE_ORDER_H__
+
+#include <stdint.h>
+
+/**
+ * Zapisuje 32-bitową liczbę w porządku little-endian.
+ * @param[out] out : bufor na 4 bajty
+ * @param[in] value : liczba
+ */
+static inline void StoreLE32(unsigned char *out, uint32_t value)
+{
+	for (int i = 0; i < 4; i++)
+		out[i] = (unsigned char)(value >> (8 * i));
+}
+
+/**
+ * Zapisuje 64-bitową liczbę w porządku little-endian.
+ * @param[out] out : bufor na 8 bajtów
+ * @param[in] value : liczba
+ */
+static inline void StoreLE64(unsigned char *out, uint64_t value)
+{
+	for (int i = 0; i < 8; i++)
+		out[i] = (unsigned char)(value >> (8 * i));
+}
+
+/**
+ * Odczytuje 32-bitową liczbę zapisaną w porządku little-endian.
+ * @param[in] in : 4 bajty liczby
+ * @return : liczba
+ */
+static inline uint32_t LoadLE32(const unsigned char *in)
+{
+	uint32_t value = 0;
+	for (int i = 0; i < 4; i++)
+		value |= (uint32_t)in[i] << (8 * i);
+	return value;
+}
+
+/**
+ * Odczytuje 64-bitową liczbę zapisaną w porządku little-endian.
+ * @param[in] in : 8 bajtów liczby
+ * @return : liczba
+ */
+static inline uint64_t LoadLE64(const unsigned char *in)
+{
+	uint64_t value = 0;
+	for (int i = 0; i < 8; i++)
+		value |= (uint64_t)in[i] << (8 * i);
+	return value;
+}
+
+#endif /* __BYTE_ORDER_H__ */
@@ -1,23 +1,107 @@
 /** @file
  * @brief Implementacja głównej funkcji kalkulatora wielomianów.
- * 
+ *
  * @author Maurycy Wojda
  * @date 2021
  */
 
+#define _POSIX_C_SOURCE 200809L
+
+#include "horner.h"
 #include "polystack.h"
 #include "polyui.h"
+#include "safealloc.h"
+#include "taskpool.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Kod błędu, z którym program kończy się przy niepoprawnych argumentach.
+ */
+#define USAGE_PROBLEM_CODE 1
+
+/**
+ * Wczytuje liczbę wątków puli. Wartość 0 oznacza liczbę dostępnych procesorów.
+ * @param[in] text : napis z liczbą wątków
+ * @param[out] threads : wczytana liczba wątków
+ * @return : `true`, jeżeli napis jest poprawną liczbą wątków,
+ * `false` w przeciwnym przypadku.
+ */
+static bool parseThreads(const char *text, size_t *threads)
+{
+	char *end;
+	if (text == NULL || *text < '0' || *text > '9')
+		return false;
+	unsigned long value = strtoul(text, &end, 10);
+	if (*end != '\0' || value > 1024)
+		return false;
+
+	if (value == 0)
+	{
+		long processors = sysconf(_SC_NPROCESSORS_ONLN);
+		value = processors > 0 ? (unsigned long)processors : 1;
+	}
+	*threads = value;
+	return true;
+}
 
 /**
  * Funkcja główna kalkulatora wielomianów.
+ * Liczbę wątków używanych przez mnożenie wielomianów można podać opcją
+ * `-t` (`--threads`) lub zmienną środowiskową `POLY_THREADS`, przy czym
+ * opcja ma pierwszeństwo. Domyślnie kalkulator działa w jednym wątku.
+ * Opcja `-c` (`--compile`) każe najpierw wczytać i skompilować całe wejście,
+ * a dopiero potem je wykonać, a opcja `--cache` podaje dodatkowo plik,
+ * w którym skompilowany skrypt jest przechowywany między uruchomieniami.
+ * @param[in] argc : liczba argumentów
+ * @param[in] argv : argumenty
  */
-int main()
+int main(int argc, char *argv[])
 {
+	size_t threads = 1;
+	bool threadsGiven = false, compile = false;
+	const char *cachePath = NULL;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--compile") == 0)
+			compile = true;
+		else if (strcmp(argv[i], "--cache") == 0 && argv[i + 1] != NULL)
+		{
+			compile = true;
+			cachePath = argv[++i];
+		}
+		else if ((strcmp(argv[i], "-t") != 0 && strcmp(argv[i], "--threads") != 0) ||
+		         !parseThreads(argv[++i], &threads))
+		{
+			fprintf(stderr, "Usage: %s [-t THREADS] [-c] [--cache FILE]\n", argv[0]);
+			return USAGE_PROBLEM_CODE;
+		}
+		else
+			threadsGiven = true;
+	}
+
+	const char *env = getenv(TASK_POOL_ENV);
+	if (!threadsGiven && env != NULL && !parseThreads(env, &threads))
+	{
+		fprintf(stderr, "Invalid %s value: %s\n", TASK_POOL_ENV, env);
+		return USAGE_PROBLEM_CODE;
+	}
+
+	HornerInit();
+	TaskPoolInit(threads);
 	PolyStack stack = PSInit();
 	PolyUIInit();
 
-	while (!checkEOF())
-		handleLine(&stack);
+	if (compile)
+		PolyUIRunScript(&stack, cachePath);
+	else
+		while (!checkEOF())
+			handleLine(&stack);
 
 	PSDestroy(&stack);
-}
\ No newline at end of file
+	PolyUIDestroy();
+	TaskPoolDestroy();
+	poolRelease();
+}
@@ -0,0 +1,345 @@
+/** @file
+ * @brief Arytmetyka współczynników wielomianów.
+ *
+ * Współczynniki są liczone w jednym z trzech trybów. W trybie domyślnym
+ * działania zawijają się modulo @f$2^{64}@f$. W trybie sprawdzanym,
+ * włączanym funkcją PolySetChecked, działania na liczbach podnoszą flagę
+ * przepełnienia, gdy wynik nie mieści się w typie poly_coeff_t,
+ * a działania na wielomianach stałych (funkcje Leaf) promują taki wynik
+ * do wielkiej liczby, więc współczynniki wielomianów są dokładne.
+ * Szybka ścieżka tych funkcji działa na zwykłych współczynnikach
+ * i tylko sprawdza przepełnienie. W trybie modularnym, włączanym funkcją
+ * PolySetModulus, współczynniki są resztami z przedziału @f$[0, m)@f$
+ * dla nieparzystego modułu @f$m < 2^{62}@f$, który nie musi być pierwszy.
+ * Reszty są trzymane w zwykłej postaci, więc zero ma jedną reprezentację
+ * i sprawdzanie, czy współczynnik się wyzerował, działa we wszystkich
+ * trybach tak samo. Dwie dowolne reszty CoeffMul mnoży bezpośrednio.
+ * Pętle, które wiele razy mnożą przez te same potęgi, zamieniają je
+ * raz na czynniki (CoeffToFactor, CoeffExpFactor), czyli w trybie
+ * modularnym na postać Montgomery'ego. Iloczyn reszty przez czynnik
+ * (CoeffMulFactor) kosztuje wtedy jedną redukcję Montgomery'ego i jest
+ * znowu resztą w zwykłej postaci, a iloczyn dwóch czynników jest
+ * czynnikiem.
+ * Wszystkie działania na współczynnikach w bibliotece przechodzą przez
+ * funkcje z tego pliku.
+ *
+ * @author Maurycy Wojda
+ * @date 2021
+ */
+
+#ifndef __COEFF_H__
+#define __COEFF_H__
+
+#include "bigcoeff.h"
+#include "modarith.h"
+#include "poly.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * To jest struktura trybu arytmetyki współczynników.
+ */
+typedef struct CoeffMode
+{
+	uint64_t mod; ///< moduł lub 0 w trybie domyślnym i sprawdzanym
+	Montgomery mont; ///< stałe redukcji Montgomery'ego dla modułu
+	bool checked; ///< czy wykrywać przepełnienia, gdy moduł jest równy 0?
+	atomic_bool overflow; ///< czy od ostatniego sprawdzenia wystąpiło przepełnienie?
+	atomic_bool tooBig; ///< czy od ostatniego sprawdzenia wielka liczba przekroczyła limit?
+} CoeffMode;
+
+/**
+ * Bieżący tryb arytmetyki współczynników. Zmieniają go tylko
+ * PolySetModulus i PolySetChecked, gdy żadna operacja na wielomianach
+ * nie jest w toku. Flagi przepełnienia i przekroczenia limitu wielkich
+ * liczb mogą podnosić wątki puli.
+ */
+extern CoeffMode coeffMode;
+
+/**
+ * Sprawdza, czy współczynniki są liczone modulo @f$m@f$.
+ * @return czy działa tryb modularny?
+ */
+static inline bool CoeffIsModular(void)
+{
+	return coeffMode.mod != 0;
+}
+
+/**
+ * Sprawdza, czy współczynniki zawijają się modulo @f$2^{64}@f$
+ * bez wykrywania przepełnień.
+ * @return czy działa tryb domyślny?
+ */
+static inline bool CoeffIsWrapping(void)
+{
+	return coeffMode.mod == 0 && !coeffMode.checked;
+}
+
+/**
+ * Sprawdza, czy przepełnienia współczynników są wykrywane.
+ * @return czy działa tryb sprawdzany?
+ */
+static inline bool CoeffIsChecked(void)
+{
+	return coeffMode.mod == 0 && coeffMode.checked;
+}
+
+/**
+ * Podnosi flagę przepełnienia współczynnika.
+ */
+static inline void CoeffOverflow(void)
+{
+	atomic_store_explicit(&coeffMode.overflow, true, memory_order_relaxed);
+}
+
+/**
+ * Podnosi flagę przekroczenia limitu długości wielkiej liczby.
+ */
+static inline void CoeffTooBig(void)
+{
+	atomic_store_explicit(&coeffMode.tooBig, true, memory_order_relaxed);
+}
+
+/**
+ * Sprowadza dowolną liczbę do reprezentacji współczynnika w bieżącym trybie.
+ * @param[in] c : liczba
+ * @return współczynnik równy @p c w bieżącym trybie
+ */
+static inline poly_coeff_t CoeffReduce(poly_coeff_t c)
+{
+	if (!CoeffIsModular())
+		return c;
+	uint64_t abs = c < 0 ? -(uint64_t)c : (uint64_t)c, rest = abs % coeffMode.mod;
+	return (poly_coeff_t)(c < 0 && rest != 0 ? coeffMode.mod - rest : rest);
+}
+
+/**
+ * Dodaje współczynniki.
+ * @param[in] a : pierwszy współczynnik
+ * @param[in] b : drugi współczynnik
+ * @return @f$a + b@f$
+ */
+static inline poly_coeff_t CoeffAdd(poly_coeff_t a, poly_coeff_t b)
+{
+	if (CoeffIsWrapping())
+		return (poly_coeff_t)((uint64_t)a + (uint64_t)b);
+	if (!CoeffIsModular())
+	{
+		poly_coeff_t sum;
+		if (__builtin_add_overflow(a, b, &sum))
+			CoeffOverflow();
+		return sum;
+	}
+	return (poly_coeff_t)ModAdd((uint64_t)a, (uint64_t)b, coeffMode.mod);
+}
+
+/**
+ * Zwraca przeciwny współczynnik.
+ * @param[in] a : współczynnik
+ * @return @f$-a@f$
+ */
+static inline poly_coeff_t CoeffNeg(poly_coeff_t a)
+{
+	if (CoeffIsWrapping())
+		return (poly_coeff_t)(-(uint64_t)a);
+	if (!CoeffIsModular())
+	{
+		poly_coeff_t neg;
+		if (__builtin_sub_overflow((poly_coeff_t)0, a, &neg))
+			CoeffOverflow();
+		return neg;
+	}
+	return a == 0 ? 0 : (poly_coeff_t)(coeffMode.mod - (uint64_t)a);
+}
+
+/**
+ * Mnoży współczynniki.
+ * @param[in] a : pierwszy współczynnik
+ * @param[in] b : drugi współczynnik
+ * @return @f$a \cdot b@f$
+ */
+static inline poly_coeff_t CoeffMul(poly_coeff_t a, poly_coeff_t b)
+{
+	if (CoeffIsWrapping())
+		return (poly_coeff_t)((uint64_t)a * (uint64_t)b);
+	if (!CoeffIsModular())
+	{
+		poly_coeff_t product;
+		if (__builtin_mul_overflow(a, b, &product))
+			CoeffOverflow();
+		return product;
+	}
+	return (poly_coeff_t)((unsigned __int128)(uint64_t)a * (uint64_t)b % coeffMode.mod);
+}
+
+/**
+ * Potęguje współczynnik. W trybie sprawdzanym podstawa jest podnoszona
+ * do kwadratu tylko wtedy, gdy kwadrat będzie jeszcze potrzebny, więc
+ * przepełnienie jest zgłaszane tylko wtedy, gdy nie mieści się wynik.
+ * @param[in] a : współczynnik
+ * @param[in] b : nieujemna potęga
+ * @return @f$a^b@f$
+ */
+static inline poly_coeff_t CoeffExp(poly_coeff_t a, poly_exp_t b)
+{
+	assert(b >= 0);
+	if (CoeffIsWrapping())
+	{
+		uint64_t base = (uint64_t)a, result = 1;
+		for (; b; b /= 2)
+		{
+			if (b&1)
+				result *= base;
+			base *= base;
+		}
+		return (poly_coeff_t)result;
+	}
+	if (!CoeffIsModular())
+	{
+		poly_coeff_t base = a, result = 1;
+		bool overflow = false;
+		for (; b; b /= 2)
+		{
+			if (b&1)
+				overflow |= __builtin_mul_overflow(result, base, &result);
+			if (b > 1)
+				overflow |= __builtin_mul_overflow(base, base, &base);
+		}
+		if (overflow)
+			CoeffOverflow();
+		return result;
+	}
+	const Montgomery *m = &coeffMode.mont;
+	return (poly_coeff_t)MontFrom(m, MontPow(m, MontTo(m, (uint64_t)a), (uint64_t)b));
+}
+
+/**
+ * Zamienia współczynnik na czynnik do wielokrotnego mnożenia przez
+ * CoeffMulFactor. W trybie modularnym czynnik jest w postaci
+ * Montgomery'ego, a w pozostałych trybach jest równy współczynnikowi.
+ * @param[in] a : współczynnik
+ * @return czynnik równy @p a
+ */
+static inline poly_coeff_t CoeffToFactor(poly_coeff_t a)
+{
+	if (!CoeffIsModular())
+		return a;
+	return (poly_coeff_t)MontTo(&coeffMode.mont, (uint64_t)a);
+}
+
+/**
+ * Potęguje współczynnik, dając czynnik, tak jak CoeffToFactor(CoeffExp(a, b)).
+ * @param[in] a : współczynnik
+ * @param[in] b : nieujemna potęga
+ * @return czynnik równy @f$a^b@f$
+ */
+static inline poly_coeff_t CoeffExpFactor(poly_coeff_t a, poly_exp_t b)
+{
+	assert(b >= 0);
+	if (!CoeffIsModular())
+		return CoeffExp(a, b);
+	const Montgomery *m = &coeffMode.mont;
+	return (poly_coeff_t)MontPow(m, MontTo(m, (uint64_t)a), (uint64_t)b);
+}
+
+/**
+ * Mnoży współczynnik lub czynnik przez czynnik. Iloczyn współczynnika
+ * przez czynnik jest współczynnikiem, a iloczyn dwóch czynników jest
+ * czynnikiem.
+ * @param[in] a : współczynnik lub czynnik
+ * @param[in] factor : czynnik
+ * @return @f$a \cdot factor@f$
+ */
+static inline poly_coeff_t CoeffMulFactor(poly_coeff_t a, poly_coeff_t factor)
+{
+	if (!CoeffIsModular())
+		return CoeffMul(a, factor);
+	return (poly_coeff_t)MontMul(&coeffMode.mont, (uint64_t)a, (uint64_t)factor);
+}
+
+/**
+ * Dodaje wielomiany stałe.
+ * @param[in] a : wielomian stały @f$a@f$
+ * @param[in] b : wielomian stały @f$b@f$
+ * @return @f$a + b@f$
+ */
+static inline Poly LeafAdd(const Poly *a, const Poly *b)
+{
+	if (a->arr == NULL && b->arr == NULL)
+	{
+		poly_coeff_t sum;
+		if (!CoeffIsChecked())
+			return PolyFromCoeff(CoeffAdd(a->coeff, b->coeff));
+		if (!__builtin_add_overflow(a->coeff, b->coeff, &sum))
+			return PolyFromCoeff(sum);
+	}
+	return BigAdd(a, b);
+}
+
+/**
+ * Mnoży wielomiany stałe.
+ * @param[in] a : wielomian stały @f$a@f$
+ * @param[in] b : wielomian stały @f$b@f$
+ * @return @f$a \cdot b@f$
+ */
+static inline Poly LeafMul(const Poly *a, const Poly *b)
+{
+	if (a->arr == NULL && b->arr == NULL)
+	{
+		poly_coeff_t product;
+		if (!CoeffIsChecked())
+			return PolyFromCoeff(CoeffMul(a->coeff, b->coeff));
+		if (!__builtin_mul_overflow(a->coeff, b->coeff, &product))
+			return PolyFromCoeff(product);
+	}
+	return BigMul(a, b);
+}
+
+/**
+ * Zwraca przeciwny wielomian stały.
+ * @param[in] a : wielomian stały @f$a@f$
+ * @return @f$-a@f$
+ */
+static inline Poly LeafNeg(const Poly *a)
+{
+	if (a->arr == NULL)
+	{
+		poly_coeff_t neg;
+		if (!CoeffIsChecked())
+			return PolyFromCoeff(CoeffNeg(a->coeff));
+		if (!__builtin_sub_overflow((poly_coeff_t)0, a->coeff, &neg))
+			return PolyFromCoeff(neg);
+	}
+	return BigNeg(a);
+}
+
+/**
+ * Potęguje współczynnik, dając wielomian stały.
+ * @param[in] a : współczynnik
+ * @param[in] b : nieujemna potęga
+ * @return @f$a^b@f$
+ */
+static inline Poly LeafExp(poly_coeff_t a, poly_exp_t b)
+{
+	if (!CoeffIsChecked())
+		return PolyFromCoeff(CoeffExp(a, b));
+	return BigExp(a, b);
+}
+
+/**
+ * Daje wartość wielomianu stałego jako współczynnik dla działań, których
+ * wynikiem jest pojedyncza liczba. Wielka liczba jest zawijana modulo
+ * @f$2^{64}@f$ i podnosi flagę przepełnienia.
+ * @param[in] a : wielomian stały
+ * @return wartość @p a
+ */
+static inline poly_coeff_t LeafValue(const Poly *a)
+{
+	if (a->arr == NULL)
+		return a->coeff;
+	CoeffOverflow();
+	return BigWrap(a);
+}
+
+#endif /* __COEFF_H__ */
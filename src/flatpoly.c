@@ -0,0 +1,788 @@
+/** @file
+ * @brief Implementacja mnożenia wielomianów jednej zmiennej w postaci płaskiej.
+ *
+ * @author Maurycy Wojda
+ * @date 2021
+ */
+
+#include "flatpoly.h"
+#include "coeff.h"
+#include "modarith.h"
+#include "safealloc.h"
+#include "taskpool.h"
+#include <stdbool.h>
+#include <string.h>
+
+/**
+ * Minimalna liczba wyrazów każdego z czynników,
+ * przy której opłaca się mnożenie w postaci gęstej.
+ */
+#define DENSE_MIN_TERMS 32
+
+/**
+ * Mnożenie w postaci gęstej jest wybierane, gdy szacowany koszt metody
+ * kopcowej @f$nm\log\min(n,m)@f$ jest co najmniej tyle razy większy
+ * od długości gęstego wyniku @f$L@f$ pomnożonej przez @f$\log L@f$.
+ */
+#define DENSE_COST_RATIO 8
+
+/**
+ * Największa długość wyniku mnożenia w postaci gęstej.
+ */
+#define DENSE_MAX_LENGTH ((size_t)1 << 26)
+
+/**
+ * Długość, poniżej której wielomiany gęste są mnożone szkolnie.
+ */
+#define KARATSUBA_THRESHOLD 32
+
+/**
+ * Długość krótszego czynnika, od której wielomiany
+ * gęste są mnożone transformatą NTT.
+ */
+#define NTT_THRESHOLD 256
+
+/**
+ * Liczba bitów, jaką na pewno wnosi każda liczba pierwsza NTT
+ * do iloczynu modułów.
+ */
+#define NTT_PRIME_BITS 61
+
+/**
+ * Liczba liczb pierwszych używanych przez NTT.
+ */
+#define NTT_PRIMES 3
+
+/**
+ * Element kopca używanego przy mnożeniu wielomianów płaskich.
+ * Reprezentuje iloczyn wyrazu @f$a_i@f$ przez wyraz @f$b_j@f$.
+ */
+typedef struct FlatHeapEntry
+{
+	flat_exp_t exp; ///< wykładnik iloczynu @f$a_i b_j@f$
+	size_t i; ///< indeks wyrazu w pierwszym czynniku
+	size_t j; ///< indeks wyrazu w drugim czynniku
+} FlatHeapEntry;
+
+/**
+ * Wstawia element do kopca minimum uporządkowanego po wykładnikach.
+ * @param[in,out] heap : tablica kopca o wystarczającej pojemności
+ * @param[in,out] heapSize : rozmiar kopca
+ * @param[in] entry : wstawiany element
+ */
+static void FlatHeapPush(FlatHeapEntry *heap, size_t *heapSize, FlatHeapEntry entry)
+{
+	size_t pos = (*heapSize)++;
+	while (pos > 0 && heap[(pos - 1) / 2].exp > entry.exp)
+	{
+		heap[pos] = heap[(pos - 1) / 2];
+		pos = (pos - 1) / 2;
+	}
+	heap[pos] = entry;
+}
+
+/**
+ * Usuwa z kopca minimum element o najmniejszym wykładniku.
+ * @param[in,out] heap : tablica kopca
+ * @param[in,out] heapSize : niezerowy rozmiar kopca
+ * @return usunięty element
+ */
+static FlatHeapEntry FlatHeapPop(FlatHeapEntry *heap, size_t *heapSize)
+{
+	FlatHeapEntry top = heap[0], last = heap[--*heapSize];
+	size_t pos = 0, child;
+	while ((child = 2 * pos + 1) < *heapSize)
+	{
+		if (child + 1 < *heapSize && heap[child + 1].exp < heap[child].exp)
+			child++;
+		if (heap[child].exp >= last.exp)
+			break;
+		heap[pos] = heap[child];
+		pos = child;
+	}
+	heap[pos] = last;
+	return top;
+}
+
+/*
+Wyjaśnienie implementacji:
+Ta sama metoda kopcowa co w PolyMulHeap, ale współczynniki są
+	liczbami, więc sumowanie wyrazów o równych wykładnikach nie
+	wymaga żadnych alokacji.
+*/
+/**
+ * Mnoży dwa niepuste wielomiany płaskie metodą kopcową.
+ * @param[in] a : krótszy czynnik
+ * @param[in] b : dłuższy czynnik
+ * @return @f$a * b@f$
+ */
+static FlatPoly FlatMulHeap(const FlatPoly *a, const FlatPoly *b)
+{
+	size_t heapSize = 0, capacity = a->size + b->size;
+	FlatHeapEntry *heap = safeMalloc(a->size * sizeof(FlatHeapEntry));
+	FlatPoly result = {.size = 0, .terms = safeMalloc(capacity * sizeof(FlatTerm))};
+	poly_coeff_t sum = 0;
+	flat_exp_t sumExp = 0;
+
+	FlatHeapPush(heap, &heapSize,
+	             (FlatHeapEntry){.exp = a->terms[0].exp + b->terms[0].exp, .i = 0, .j = 0});
+
+	while (heapSize > 0)
+	{
+		FlatHeapEntry top = FlatHeapPop(heap, &heapSize);
+
+		if (top.exp != sumExp && sum != 0)
+		{
+			if (result.size == capacity)
+			{
+				capacity *= 2;
+				safeRealloc((void**)&result.terms, capacity * sizeof(FlatTerm));
+			}
+			result.terms[result.size++] = (FlatTerm){.exp = sumExp, .coeff = sum};
+			sum = 0;
+		}
+		sumExp = top.exp;
+		sum = CoeffAdd(sum, CoeffMul(a->terms[top.i].coeff, b->terms[top.j].coeff));
+
+		if (top.j + 1 < b->size)
+			FlatHeapPush(heap, &heapSize,
+			             (FlatHeapEntry){.exp = a->terms[top.i].exp + b->terms[top.j + 1].exp,
+			                             .i = top.i, .j = top.j + 1});
+		if (top.j == 0 && top.i + 1 < a->size)
+			FlatHeapPush(heap, &heapSize,
+			             (FlatHeapEntry){.exp = a->terms[top.i + 1].exp + b->terms[0].exp,
+			                             .i = top.i + 1, .j = 0});
+	}
+
+	if (sum != 0)
+	{
+		if (result.size == capacity)
+			safeRealloc((void**)&result.terms, ++capacity * sizeof(FlatTerm));
+		result.terms[result.size++] = (FlatTerm){.exp = sumExp, .coeff = sum};
+	}
+
+	free(heap);
+	return result;
+}
+
+FlatPoly FlatAdd(const FlatPoly *p, const FlatPoly *q)
+{
+	FlatPoly result = {.size = 0, .terms = safeMalloc((p->size + q->size) * sizeof(FlatTerm))};
+	size_t i = 0, j = 0;
+
+	while (i < p->size && j < q->size)
+	{
+		if (p->terms[i].exp < q->terms[j].exp)
+		{
+			result.terms[result.size++] = p->terms[i++];
+		}
+		else if (p->terms[i].exp > q->terms[j].exp)
+		{
+			result.terms[result.size++] = q->terms[j++];
+		}
+		else
+		{
+			poly_coeff_t sum = CoeffAdd(p->terms[i].coeff, q->terms[j].coeff);
+			if (sum != 0)
+				result.terms[result.size++] = (FlatTerm){.exp = p->terms[i].exp, .coeff = sum};
+			i++;
+			j++;
+		}
+	}
+	memcpy(result.terms + result.size, p->terms + i, (p->size - i) * sizeof(FlatTerm));
+	result.size += p->size - i;
+	memcpy(result.terms + result.size, q->terms + j, (q->size - j) * sizeof(FlatTerm));
+	result.size += q->size - j;
+	return result;
+}
+
+/**
+ * Scala dwa wielomiany płaskie, sumując wyrazy o równych wykładnikach,
+ * i zwalnia je.
+ * @param[in,out] p : wielomian płaski @f$p@f$
+ * @param[in,out] q : wielomian płaski @f$q@f$
+ * @return @f$p + q@f$
+ */
+static FlatPoly FlatAddOwn(FlatPoly *p, FlatPoly *q)
+{
+	FlatPoly result = FlatAdd(p, q);
+	FlatDestroy(p);
+	FlatDestroy(q);
+	return result;
+}
+
+/**
+ * To jest struktura zadania mnożącego fragment dłuższego czynnika
+ * przez krótszy lub scalającego dwa iloczyny częściowe.
+ */
+typedef struct FlatMulTask
+{
+	const FlatPoly *a; ///< krótszy czynnik
+	const FlatPoly *b; ///< dłuższy czynnik
+	size_t low; ///< początek fragmentu dłuższego czynnika
+	size_t high; ///< koniec fragmentu dłuższego czynnika
+	FlatPoly result; ///< iloczyn częściowy
+	struct FlatMulTask *other; ///< zadanie, którego wynik należy dołączyć
+} FlatMulTask;
+
+/**
+ * Mnoży fragment dłuższego czynnika przez krótszy czynnik.
+ * @param[in,out] arg : zadanie FlatMulTask
+ */
+static void FlatMulChunkTask(void *arg)
+{
+	FlatMulTask *task = arg;
+	FlatPoly chunk = {.size = task->high - task->low, .terms = task->b->terms + task->low};
+	task->result = chunk.size < task->a->size ? FlatMulHeap(&chunk, task->a) :
+	                                            FlatMulHeap(task->a, &chunk);
+}
+
+/**
+ * Dołącza do iloczynu częściowego zadania iloczyn częściowy innego zadania.
+ * @param[in,out] arg : zadanie FlatMulTask
+ */
+static void FlatMergeTask(void *arg)
+{
+	FlatMulTask *task = arg;
+	task->result = FlatAddOwn(&task->result, &task->other->result);
+}
+
+/*
+Wyjaśnienie implementacji:
+Dzielę dłuższy czynnik na fragmenty, bo iloczyny jego sąsiednich
+	fragmentów przez krótszy czynnik pokrywają się tylko częściowo,
+	więc ich scalanie jest tanie. Iloczyny fragmentów liczą zadania
+	puli wątków, a następnie scalam je parami w drzewo, w którym
+	scalenia na jednym poziomie również są zadaniami. Dodawanie
+	współczynników jest łączne w obu trybach arytmetyki, więc kolejność
+	sumowania nie zmienia wyniku i jest on identyczny z mnożeniem sekwencyjnym.
+*/
+/**
+ * Mnoży dwa niepuste wielomiany płaskie metodą kopcową,
+ * rozdzielając pracę między wątki puli, jeżeli to się opłaca.
+ * @param[in] a : krótszy czynnik
+ * @param[in] b : dłuższy czynnik
+ * @return @f$a * b@f$
+ */
+static FlatPoly FlatMulHeapParallel(const FlatPoly *a, const FlatPoly *b)
+{
+	size_t chunks = TaskChunkCount(b->size, (uint64_t)a->size * b->size);
+	if (chunks == 1)
+		return FlatMulHeap(a, b);
+
+	FlatMulTask *tasks = safeMalloc(chunks * sizeof(FlatMulTask));
+	TaskGroup group = TaskGroupInit();
+	for (size_t i = 0; i < chunks; i++)
+	{
+		tasks[i] = (FlatMulTask){.a = a, .b = b, .low = b->size * i / chunks,
+		                         .high = b->size * (i + 1) / chunks};
+		TaskSpawn(&group, FlatMulChunkTask, &tasks[i]);
+	}
+	TaskWait(&group);
+
+	for (size_t step = 1; step < chunks; step *= 2)
+	{
+		for (size_t i = 0; i + step < chunks; i += 2 * step)
+		{
+			tasks[i].other = &tasks[i + step];
+			TaskSpawn(&group, FlatMergeTask, &tasks[i]);
+		}
+		TaskWait(&group);
+	}
+
+	FlatPoly result = tasks[0].result;
+	free(tasks);
+	return result;
+}
+
+/*
+Wyjaśnienie implementacji mnożenia gęstego:
+Współczynniki są trzymane jako liczby bez znaku, dzięki czemu dodawanie
+	i mnożenie zawijają się modulo @f$2^{64}@f$ dokładnie tak, jak
+	w pozostałych ścieżkach mnożenia, a metoda Karatsuby, która odejmuje
+	iloczyny częściowe, daje wynik identyczny z mnożeniem szkolnym.
+Dla długich czynników używam NTT modulo kilku liczb pierwszych postaci
+	@f$c \cdot 2^k + 1@f$. Liczb pierwszych jest tyle, żeby ich iloczyn
+	@f$P@f$ przekraczał dwukrotność największego możliwego współczynnika
+	wyniku, więc z reszt (wzorem Garnera) da się odtworzyć dokładną
+	wartość ze znakiem, a z niej wartość modulo @f$2^{64}@f$.
+Wzór Garnera daje dokładną wartość współczynnika, więc w trybie
+	sprawdzanym właśnie tam wykrywam przepełnienia. Metoda Karatsuby
+	ich nie wykrywa, więc w tym trybie również używam NTT.
+W trybie modularnym współczynniki są nieujemnymi resztami, których
+	iloczyny odejmowane w metodzie Karatsuby nie zawijają się zgodnie
+	z modułem, więc wszystkie iloczyny gęste liczę transformatą NTT,
+	a cyfry wzoru Garnera składam od razu modulo moduł współczynników.
+*/
+
+/**
+ * Mnoży szkolnie dwa wielomiany gęste.
+ * @param[in] a : współczynniki pierwszego czynnika
+ * @param[in] n : długość pierwszego czynnika
+ * @param[in] b : współczynniki drugiego czynnika
+ * @param[in] m : długość drugiego czynnika
+ * @param[out] c : tablica długości @f$n + m - 1@f$ na wynik
+ */
+static void DenseMulSchool(const uint64_t *a, size_t n,
+                           const uint64_t *b, size_t m, uint64_t *c)
+{
+	memset(c, 0, (n + m - 1) * sizeof(uint64_t));
+	for (size_t i = 0; i < n; i++)
+		for (size_t j = 0; j < m; j++)
+			c[i + j] += a[i] * b[j];
+}
+
+/**
+ * Mnoży dwa wielomiany gęste metodą Karatsuby.
+ * Dłuższy czynnik jest dzielony na kawałki długości krótszego.
+ * @param[in] a : współczynniki pierwszego czynnika
+ * @param[in] n : długość pierwszego czynnika
+ * @param[in] b : współczynniki drugiego czynnika
+ * @param[in] m : długość drugiego czynnika
+ * @param[out] c : tablica długości @f$n + m - 1@f$ na wynik
+ */
+static void DenseMulKaratsuba(const uint64_t *a, size_t n,
+                              const uint64_t *b, size_t m, uint64_t *c)
+{
+	if (n > m)
+		return DenseMulKaratsuba(b, m, a, n, c);
+	if (n < KARATSUBA_THRESHOLD)
+		return DenseMulSchool(a, n, b, m, c);
+
+	if (n < m)
+	{
+		uint64_t *part = safeMalloc((2 * n - 1) * sizeof(uint64_t));
+		memset(c, 0, (n + m - 1) * sizeof(uint64_t));
+		for (size_t offset = 0; offset < m; offset += n)
+		{
+			size_t len = m - offset < n ? m - offset : n;
+			DenseMulKaratsuba(a, n, b + offset, len, part);
+			for (size_t i = 0; i < n + len - 1; i++)
+				c[offset + i] += part[i];
+		}
+		free(part);
+		return;
+	}
+
+	// a = a0 + a1 x^h, b = b0 + b1 x^h, gdzie a1 i b1 mają długość n - h >= h.
+	size_t h = n / 2, high = n - h;
+	uint64_t *sumA = safeMalloc((4 * high - 1) * sizeof(uint64_t));
+	uint64_t *sumB = sumA + high;
+	uint64_t *mid = sumB + high;
+
+	for (size_t i = 0; i < high; i++)
+	{
+		sumA[i] = a[h + i] + (i < h ? a[i] : 0);
+		sumB[i] = b[h + i] + (i < h ? b[i] : 0);
+	}
+
+	DenseMulKaratsuba(a, h, b, h, c);
+	c[2 * h - 1] = 0;
+	DenseMulKaratsuba(a + h, high, b + h, high, c + 2 * h);
+	DenseMulKaratsuba(sumA, high, sumB, high, mid);
+
+	for (size_t i = 0; i < 2 * h - 1; i++)
+		mid[i] -= c[i];
+	for (size_t i = 0; i < 2 * high - 1; i++)
+		mid[i] -= c[2 * h + i];
+	for (size_t i = 0; i < 2 * high - 1; i++)
+		c[h + i] += mid[i];
+
+	free(sumA);
+}
+
+/**
+ * Liczby pierwsze postaci @f$c \cdot 2^k + 1@f$ mniejsze niż @f$2^{62}@f$
+ * wraz z ich pierwiastkami pierwotnymi.
+ */
+static const uint64_t nttPrimes[NTT_PRIMES][2] =
+{
+	{4611615649683210241ULL, 11}, // 65535 * 2^46 + 1
+	{4601552919265804289ULL, 3},  // 4087 * 2^50 + 1
+	{4179340454199820289ULL, 3}   // 29 * 2^57 + 1
+};
+
+/**
+ * Wykonuje w miejscu transformatę NTT długości będącej potęgą dwójki.
+ * Dane są w zwykłej postaci, a pierwiastki w postaci Montgomery'ego.
+ * @param[in,out] a : tablica współczynników
+ * @param[in] n : długość tablicy, potęga dwójki
+ * @param[in] m : stałe redukcji dla liczby pierwszej
+ * @param[in] root : pierwiastek pierwotny stopnia @p n w postaci Montgomery'ego
+ */
+static void NttTransform(uint64_t *a, size_t n, const Montgomery *m, uint64_t root)
+{
+	for (size_t i = 1, j = 0; i < n; i++)
+	{
+		size_t bit = n >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j)
+		{
+			uint64_t tmp = a[i];
+			a[i] = a[j];
+			a[j] = tmp;
+		}
+	}
+
+	// Potęgi pierwiastka stopnia len to co (n / len)-ta potęga pierwiastka stopnia n.
+	uint64_t *powers = safeMalloc((n / 2 + 1) * sizeof(uint64_t));
+	powers[0] = MontTo(m, 1);
+	for (size_t k = 1; k < n / 2; k++)
+		powers[k] = MontMul(m, powers[k - 1], root);
+
+	for (size_t len = 2; len <= n; len *= 2)
+	{
+		size_t stride = n / len;
+		for (size_t i = 0; i < n; i += len)
+			for (size_t k = 0; k < len / 2; k++)
+			{
+				uint64_t u = a[i + k];
+				uint64_t v = MontMul(m, a[i + k + len / 2], powers[k * stride]);
+				a[i + k] = ModAdd(u, v, m->mod);
+				a[i + k + len / 2] = ModSub(u, v, m->mod);
+			}
+	}
+	free(powers);
+}
+
+/**
+ * Zamienia współczynnik ze znakiem na resztę modulo liczba pierwsza.
+ * @param[in] a : współczynnik zapisany jako liczba bez znaku
+ * @param[in] mod : liczba pierwsza
+ * @return @f$a \bmod p@f$
+ */
+static uint64_t NttResidue(uint64_t a, uint64_t mod)
+{
+	if ((int64_t)a >= 0)
+		return a % mod;
+	uint64_t residue = (-a) % mod;
+	return residue == 0 ? 0 : mod - residue;
+}
+
+/**
+ * Mnoży wielomiany gęste modulo jedna liczba pierwsza.
+ * @param[in] a : współczynniki pierwszego czynnika
+ * @param[in] n : długość pierwszego czynnika
+ * @param[in] b : współczynniki drugiego czynnika lub NULL przy podnoszeniu do kwadratu
+ * @param[in] m : długość drugiego czynnika
+ * @param[in] len : długość transformaty, potęga dwójki nie mniejsza niż @f$n + m - 1@f$
+ * @param[in] prime : indeks liczby pierwszej
+ * @param[out] c : tablica długości @p len na reszty współczynników wyniku
+ */
+static void NttMulModPrime(const uint64_t *a, size_t n, const uint64_t *b, size_t m,
+                           size_t len, size_t prime, uint64_t *c)
+{
+	Montgomery mont = MontInit(nttPrimes[prime][0]);
+	uint64_t mod = mont.mod;
+	uint64_t root = MontPow(&mont, MontTo(&mont, nttPrimes[prime][1]), (mod - 1) / len);
+	uint64_t *other = NULL;
+
+	memset(c, 0, len * sizeof(uint64_t));
+	for (size_t i = 0; i < n; i++)
+		c[i] = NttResidue(a[i], mod);
+	NttTransform(c, len, &mont, root);
+
+	if (b != NULL)
+	{
+		other = safeMalloc(len * sizeof(uint64_t));
+		memset(other, 0, len * sizeof(uint64_t));
+		for (size_t i = 0; i < m; i++)
+			other[i] = NttResidue(b[i], mod);
+		NttTransform(other, len, &mont, root);
+	}
+
+	// Iloczyn punktowy daje @f$ABR^{-1}@f$, a stała scale to @f$len^{-1}R@f$
+	// w postaci Montgomery'ego, więc po przemnożeniu przez nią wychodzi @f$AB/len@f$.
+	uint64_t lenInv = MontPow(&mont, MontTo(&mont, len), mod - 2);
+	uint64_t scale = MontTo(&mont, lenInv);
+	for (size_t i = 0; i < len; i++)
+		c[i] = MontMul(&mont, MontMul(&mont, c[i], other != NULL ? other[i] : c[i]), scale);
+	free(other);
+
+	NttTransform(c, len, &mont, MontPow(&mont, root, len - 1));
+}
+
+/**
+ * To jest struktura zadania mnożącego wielomiany gęste modulo jedna
+ * liczba pierwsza. Pola odpowiadają argumentom funkcji NttMulModPrime.
+ */
+typedef struct NttTask
+{
+	const uint64_t *a; ///< współczynniki pierwszego czynnika
+	size_t n; ///< długość pierwszego czynnika
+	const uint64_t *b; ///< współczynniki drugiego czynnika lub NULL
+	size_t m; ///< długość drugiego czynnika
+	size_t len; ///< długość transformaty
+	size_t prime; ///< indeks liczby pierwszej
+	uint64_t *c; ///< tablica na reszty współczynników wyniku
+} NttTask;
+
+/**
+ * Wykonuje zadanie mnożenia modulo jedna liczba pierwsza.
+ * @param[in,out] arg : zadanie NttTask
+ */
+static void NttMulTask(void *arg)
+{
+	NttTask *task = arg;
+	NttMulModPrime(task->a, task->n, task->b, task->m, task->len, task->prime, task->c);
+}
+
+/**
+ * Zwraca liczbę bitów wartości bezwzględnej największego współczynnika.
+ * @param[in] a : współczynniki zapisane jako liczby bez znaku
+ * @param[in] n : liczba współczynników
+ * @return liczba bitów
+ */
+static unsigned DenseMaxBits(const uint64_t *a, size_t n)
+{
+	uint64_t max = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		int64_t value = (int64_t)a[i];
+		uint64_t abs = value < 0 ? -(uint64_t)value : (uint64_t)value;
+		if (abs > max)
+			max = abs;
+	}
+	return max == 0 ? 0 : 64 - __builtin_clzll(max);
+}
+
+/**
+ * Sprawdza, czy liczba odtworzona wzorem Garnera mieści się w typie
+ * poly_coeff_t. Dla liczby ujemnej @f$v@f$ cyfry @f$p_i - 1 - x_i@f$
+ * są cyframi liczby @f$-v - 1@f$, więc w obu przypadkach wystarczy
+ * ograniczyć liczbę nieujemną zapisaną dwiema najmłodszymi cyframi.
+ * @param[in] x1 : cyfra o podstawie 1
+ * @param[in] x2 : cyfra o podstawie @f$p_1@f$
+ * @param[in] x3 : cyfra o podstawie @f$p_1 p_2@f$
+ * @param[in] primes : liczba użytych liczb pierwszych
+ * @param[in] negative : czy liczba jest ujemna?
+ * @return czy liczba się mieści?
+ */
+static bool GarnerFitsCoeff(uint64_t x1, uint64_t x2, uint64_t x3,
+                            size_t primes, bool negative)
+{
+	uint64_t digits[NTT_PRIMES] = {x1, x2, x3};
+	for (size_t prime = 0; prime < NTT_PRIMES; prime++)
+		if (negative && prime < primes)
+			digits[prime] = nttPrimes[prime][0] - 1 - digits[prime];
+		else if (prime >= primes)
+			digits[prime] = 0;
+
+	// Cyfra o podstawie p1 p2 > 2^64 musi być zerem.
+	if (digits[2] != 0)
+		return false;
+	unsigned __int128 magnitude = digits[0] + (unsigned __int128)digits[1] * nttPrimes[0][0];
+	return magnitude <= (unsigned __int128)INT64_MAX;
+}
+
+/**
+ * Mnoży dwa wielomiany gęste transformatą NTT modulo kilka liczb
+ * pierwszych i odtwarza współczynniki wzorem Garnera.
+ * @param[in] a : współczynniki pierwszego czynnika
+ * @param[in] n : długość pierwszego czynnika
+ * @param[in] b : współczynniki drugiego czynnika lub NULL przy podnoszeniu do kwadratu
+ * @param[in] m : długość drugiego czynnika
+ * @param[out] c : tablica długości @f$n + m - 1@f$ na wynik
+ */
+static void DenseMulNtt(const uint64_t *a, size_t n,
+                        const uint64_t *b, size_t m, uint64_t *c)
+{
+	size_t len = 1, resultLen = n + m - 1;
+	while (len < resultLen)
+		len *= 2;
+
+	// Współczynnik wyniku ma wartość bezwzględną mniejszą niż 2^bound,
+	// a iloczyn użytych liczb pierwszych musi przekraczać 2^(bound + 1).
+	unsigned bound = DenseMaxBits(a, n) + (b != NULL ? DenseMaxBits(b, m) : DenseMaxBits(a, n));
+	for (size_t shorter = n < m ? n : m; shorter > 1; shorter = (shorter + 1) / 2)
+		bound++;
+	size_t primes = (bound + 1) / NTT_PRIME_BITS + 1;
+	if (primes > NTT_PRIMES)
+		primes = NTT_PRIMES;
+
+	// Reszty modulo kolejne liczby pierwsze są niezależne, więc liczą je zadania puli.
+	uint64_t *residues = safeMalloc(primes * len * sizeof(uint64_t));
+	NttTask tasks[NTT_PRIMES];
+	TaskGroup group = TaskGroupInit();
+	for (size_t prime = 0; prime < primes; prime++)
+	{
+		tasks[prime] = (NttTask){.a = a, .n = n, .b = b, .m = m, .len = len,
+		                         .prime = prime, .c = residues + prime * len};
+		TaskSpawn(&group, NttMulTask, &tasks[prime]);
+	}
+	TaskWait(&group);
+
+	uint64_t p1 = nttPrimes[0][0], p2 = nttPrimes[1][0], p3 = nttPrimes[2][0];
+	// Stałe w postaci Montgomery'ego: mnożenie przez nie daje wynik w zwykłej postaci.
+	Montgomery mont2 = MontInit(p2), mont3 = MontInit(p3);
+	uint64_t inv1 = MontPow(&mont2, MontTo(&mont2, p1), p2 - 2);
+	uint64_t p1mod3 = MontTo(&mont3, p1);
+	uint64_t inv12 = MontPow(&mont3, MontMul(&mont3, p1mod3, MontTo(&mont3, p2)), p3 - 2);
+	poly_coeff_t p1Factor = 0, p12Factor = 0;
+	if (CoeffIsModular())
+	{
+		poly_coeff_t p1Coeff = CoeffReduce((poly_coeff_t)p1);
+		p1Factor = CoeffToFactor(p1Coeff);
+		p12Factor = CoeffToFactor(CoeffMul(p1Coeff, CoeffReduce((poly_coeff_t)p2)));
+	}
+
+	for (size_t i = 0; i < resultLen; i++)
+	{
+		// Cyfry x1, x2, x3 zapisu liczby w systemie o podstawach p1, p2, p3.
+		uint64_t x1 = residues[i], x2 = 0, x3 = 0;
+		bool negative;
+		if (primes >= 2)
+			x2 = MontMul(&mont2, ModSub(residues[len + i], x1 % p2, p2), inv1);
+		if (primes >= 3)
+		{
+			uint64_t t = ModSub(residues[2 * len + i], x1 % p3, p3);
+			t = ModSub(t, MontMul(&mont3, x2 % p3, p1mod3), p3);
+			x3 = MontMul(&mont3, t, inv12);
+		}
+
+		if (CoeffIsModular())
+		{
+			c[i] = (uint64_t)CoeffAdd(CoeffReduce((poly_coeff_t)x1),
+			                          CoeffAdd(CoeffMulFactor(CoeffReduce((poly_coeff_t)x2), p1Factor),
+			                                   CoeffMulFactor(CoeffReduce((poly_coeff_t)x3), p12Factor)));
+			continue;
+		}
+
+		// Porównanie z (P - 1) / 2, którego cyfry to (p_i - 1) / 2.
+		if (primes == 1)
+			negative = x1 > (p1 - 1) / 2;
+		else if (primes == 2)
+			negative = x2 != (p2 - 1) / 2 ? x2 > (p2 - 1) / 2 : x1 > (p1 - 1) / 2;
+		else
+			negative = x3 != (p3 - 1) / 2 ? x3 > (p3 - 1) / 2 :
+			           x2 != (p2 - 1) / 2 ? x2 > (p2 - 1) / 2 : x1 > (p1 - 1) / 2;
+
+		if (CoeffIsChecked() && !GarnerFitsCoeff(x1, x2, x3, primes, negative))
+			CoeffOverflow();
+
+		uint64_t value = x1 + x2 * p1 + x3 * p1 * p2;
+		if (negative)
+			value -= primes == 1 ? p1 : primes == 2 ? p1 * p2 : p1 * p2 * p3;
+		c[i] = value;
+	}
+
+	free(residues);
+}
+
+/**
+ * Zwraca sufit logarytmu dwójkowego liczby.
+ * @param[in] n : dodatnia liczba
+ * @return @f$\lceil\log_2 n\rceil@f$
+ */
+static unsigned CeilLog2(uint64_t n)
+{
+	return n <= 1 ? 0 : 64 - __builtin_clzll(n - 1);
+}
+
+/*
+Wyjaśnienie implementacji:
+Gęstość czynników sama w sobie nie wystarcza: po podstawieniu Kroneckera
+	wielomian gęsty w każdej zmiennej z osobna ma w postaci płaskiej
+	dziury, bo zakres każdej zmiennej jest dobrany do stopnia iloczynu.
+	Dlatego porównuję szacowane koszty obu metod, a za rozpiętość
+	wykładników przyjmuję długość tablic potrzebnych w postaci gęstej.
+*/
+/**
+ * Sprawdza, czy dwa wielomiany płaskie są na tyle gęste,
+ * że opłaca się je mnożyć w postaci gęstej.
+ * @param[in] p : niepusty wielomian płaski
+ * @param[in] q : niepusty wielomian płaski
+ * @return czy mnożyć w postaci gęstej?
+ */
+static bool FlatPreferDense(const FlatPoly *p, const FlatPoly *q)
+{
+	if (p->size < DENSE_MIN_TERMS || q->size < DENSE_MIN_TERMS)
+		return false;
+
+	flat_exp_t spanP = p->terms[p->size - 1].exp - p->terms[0].exp;
+	flat_exp_t spanQ = q->terms[q->size - 1].exp - q->terms[0].exp;
+	if (spanP >= DENSE_MAX_LENGTH || spanQ >= DENSE_MAX_LENGTH - spanP)
+		return false;
+
+	uint64_t length = spanP + spanQ + 1;
+	size_t shorter = p->size < q->size ? p->size : q->size;
+	unsigned __int128 heapCost = (unsigned __int128)p->size * q->size * CeilLog2(shorter);
+	unsigned __int128 denseCost = (unsigned __int128)length * CeilLog2(length) * DENSE_COST_RATIO;
+	return heapCost >= denseCost;
+}
+
+/**
+ * Rozpisuje wielomian płaski na tablicę wszystkich współczynników
+ * od najmniejszego do największego wykładnika.
+ * @param[in] p : niepusty wielomian płaski
+ * @param[out] length : długość tablicy
+ * @return tablica współczynników zaalokowana funkcją safeMalloc
+ */
+static uint64_t *FlatToDense(const FlatPoly *p, size_t *length)
+{
+	*length = p->terms[p->size - 1].exp - p->terms[0].exp + 1;
+	uint64_t *dense = safeMalloc(*length * sizeof(uint64_t));
+	memset(dense, 0, *length * sizeof(uint64_t));
+	for (size_t i = 0; i < p->size; i++)
+		dense[p->terms[i].exp - p->terms[0].exp] = (uint64_t)p->terms[i].coeff;
+	return dense;
+}
+
+/**
+ * Mnoży dwa gęste wielomiany płaskie metodą Karatsuby lub transformatą NTT.
+ * @param[in] p : wielomian płaski @f$p@f$
+ * @param[in] q : wielomian płaski @f$q@f$, może być tym samym obiektem co @p p
+ * @return @f$p * q@f$
+ */
+static FlatPoly FlatMulDense(const FlatPoly *p, const FlatPoly *q)
+{
+	size_t n, m;
+	uint64_t *a = FlatToDense(p, &n), *b = a;
+	if (p != q)
+		b = FlatToDense(q, &m);
+	else
+		m = n;
+
+	uint64_t *c = safeMalloc((n + m - 1) * sizeof(uint64_t));
+	if ((n < m ? n : m) >= NTT_THRESHOLD || !CoeffIsWrapping())
+		DenseMulNtt(a, n, p == q ? NULL : b, m, c);
+	else
+		DenseMulKaratsuba(a, n, b, m, c);
+
+	FlatPoly result = {.size = 0, .terms = NULL};
+	for (size_t i = 0; i < n + m - 1; i++)
+		result.size += c[i] != 0;
+	result.terms = safeMalloc(result.size * sizeof(FlatTerm));
+	flat_exp_t low = p->terms[0].exp + q->terms[0].exp;
+	for (size_t i = 0, k = 0; i < n + m - 1; i++)
+		if (c[i] != 0)
+			result.terms[k++] = (FlatTerm){.exp = low + i, .coeff = (poly_coeff_t)c[i]};
+
+	free(a);
+	if (b != a)
+		free(b);
+	free(c);
+	return result;
+}
+
+FlatPoly FlatMul(const FlatPoly *p, const FlatPoly *q)
+{
+	if (p->size == 0 || q->size == 0)
+		return (FlatPoly){.size = 0, .terms = NULL};
+
+	if (FlatPreferDense(p, q))
+		return FlatMulDense(p, q);
+	else if (p->size <= q->size)
+		return FlatMulHeapParallel(p, q);
+	else
+		return FlatMulHeapParallel(q, p);
+}
+
+void FlatDestroy(FlatPoly *p)
+{
+	free(p->terms);
+	p->terms = NULL;
+	p->size = 0;
+}
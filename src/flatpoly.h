@@ -0,0 +1,73 @@
+/** @file
+ * @brief Interfejs mnożenia wielomianów jednej zmiennej w postaci płaskiej.
+ *
+ * Wielomian płaski to tablica wyrazów ze współczynnikami stałymi
+ * posortowana ściśle rosnąco po wykładnikach. Do takiej postaci
+ * sprowadzane są wielomiany wielu zmiennych za pomocą podstawienia
+ * Kroneckera, dzięki czemu mnożenie nie musi schodzić rekurencyjnie
+ * przez kolejne poziomy wielomianu.
+ *
+ * @author Maurycy Wojda
+ * @date 2021
+ */
+
+#ifndef __FLAT_POLY_H__
+#define __FLAT_POLY_H__
+
+#include "poly.h"
+#include <stdint.h>
+
+/** To jest typ reprezentujący wykładniki wielomianów płaskich. */
+typedef uint64_t flat_exp_t;
+
+/**
+ * To jest struktura przechowująca wyraz wielomianu płaskiego.
+ */
+typedef struct FlatTerm
+{
+	flat_exp_t exp; ///< wykładnik
+	poly_coeff_t coeff; ///< niezerowy współczynnik
+} FlatTerm;
+
+/**
+ * To jest struktura przechowująca wielomian płaski.
+ * Wyrazy są posortowane ściśle rosnąco po wykładnikach
+ * i mają niezerowe współczynniki.
+ */
+typedef struct FlatPoly
+{
+	size_t size; ///< liczba wyrazów
+	FlatTerm *terms; ///< tablica wyrazów zaalokowana funkcją safeMalloc
+} FlatPoly;
+
+/**
+ * Mnoży dwa wielomiany płaskie.
+ * Rzadkie czynniki są mnożone metodą kopcową, a gęste metodą Karatsuby
+ * lub, dla długich czynników, transformatą NTT.
+ * Przy działającej puli wątków duże iloczyny są liczone równolegle.
+ * Współczynniki są liczone w tym samym trybie arytmetyki co w PolyMul,
+ * więc wynik jest identyczny z mnożeniem rekurencyjnym i nie zależy
+ * od liczby wątków.
+ * Wywołujący musi zagwarantować, że wykładniki wyniku mieszczą się
+ * w typie flat_exp_t.
+ * @param[in] p : wielomian płaski @f$p@f$
+ * @param[in] q : wielomian płaski @f$q@f$, może być tym samym obiektem co @p p
+ * @return @f$p * q@f$
+ */
+FlatPoly FlatMul(const FlatPoly *p, const FlatPoly *q);
+
+/**
+ * Dodaje dwa wielomiany płaskie, scalając ich wyrazy.
+ * @param[in] p : wielomian płaski @f$p@f$
+ * @param[in] q : wielomian płaski @f$q@f$
+ * @return @f$p + q@f$
+ */
+FlatPoly FlatAdd(const FlatPoly *p, const FlatPoly *q);
+
+/**
+ * Usuwa wielomian płaski z pamięci.
+ * @param[in] p : wielomian płaski
+ */
+void FlatDestroy(FlatPoly *p);
+
+#endif /* __FLAT_POLY_H__ */
@@ -0,0 +1,382 @@
+/** @file
+ * @brief Implementacja wektorowego schematu Hornera dla wielu punktów naraz.
+ *
+ * @author Maurycy Wojda
+ * @date 2021
+ */
+
+#include "horner.h"
+#include "coeff.h"
+#include "safealloc.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <immintrin.h>
+	/** Czy kompilujemy kernel AVX2? */
+	#define HORNER_AVX2 1
+#elif defined(__ARM_NEON)
+	#include <arm_neon.h>
+	/** Czy kompilujemy kernel NEON? */
+	#define HORNER_NEON 1
+#endif
+
+/**
+ * Typ kernela wektorowego, który liczy potęgi @f$out_j = x_j^e@f$.
+ * Zwraca liczbę przetworzonych punktów od początku tablicy.
+ */
+typedef size_t (*HornerPowKernel)(size_t n, const poly_coeff_t xs[], poly_exp_t e,
+                                  poly_coeff_t out[]);
+
+/**
+ * Typ kernela wektorowego, który wykonuje krok schematu Hornera
+ * @f$v_j \gets v_j p_j + c@f$ dla gotowych potęg @f$p_j@f$.
+ * Zwraca liczbę przetworzonych punktów od początku tablicy.
+ */
+typedef size_t (*HornerStepKernel)(size_t n, const poly_coeff_t powers[], poly_coeff_t c,
+                                   poly_coeff_t values[]);
+
+/**
+ * Kernel wektorowy potęgowania lub NULL, jeżeli procesor go nie ma.
+ */
+static HornerPowKernel hornerPow = NULL;
+
+/**
+ * Kernel wektorowy kroku schematu Hornera lub NULL, jeżeli procesor go nie ma.
+ */
+static HornerStepKernel hornerStep = NULL;
+
+/**
+ * Liczy potęgi @f$out_j = x_j^e@f$ dla punktów o indeksach od @p from
+ * do @p n. W trybie modularnym potęgi są czynnikami.
+ * @param[in] from : indeks pierwszego punktu
+ * @param[in] n : liczba punktów
+ * @param[in] xs : tablica punktów
+ * @param[in] e : nieujemny wykładnik
+ * @param[out] out : tablica potęg
+ */
+static void ScalarPow(size_t from, size_t n, const poly_coeff_t xs[], poly_exp_t e,
+                      poly_coeff_t out[])
+{
+	for (size_t j = from; j < n; j++)
+		out[j] = CoeffExpFactor(xs[j], e);
+}
+
+/**
+ * Wykonuje krok schematu Hornera @f$v_j \gets v_j p_j + c@f$
+ * dla punktów o indeksach od @p from do @p n.
+ * @param[in] from : indeks pierwszego punktu
+ * @param[in] n : liczba punktów
+ * @param[in] powers : tablica potęg punktów
+ * @param[in] c : wyraz wolny kroku
+ * @param[in,out] values : tablica wartości
+ */
+static void ScalarStep(size_t from, size_t n, const poly_coeff_t powers[],
+                       poly_coeff_t c, poly_coeff_t values[])
+{
+	for (size_t j = from; j < n; j++)
+		values[j] = CoeffAdd(CoeffMulFactor(values[j], powers[j]), c);
+}
+
+#ifdef HORNER_AVX2
+
+/**
+ * Mnoży parami 64-bitowe pola wektorów modulo @f$2^{64}@f$. AVX2 mnoży
+ * tylko 32-bitowe połówki, więc iloczyn składam z trzech iloczynów
+ * częściowych, pomijając iloczyn górnych połówek, który wypada poza 64 bity.
+ * @param[in] a : pierwszy wektor
+ * @param[in] b : drugi wektor
+ * @return wektor iloczynów
+ */
+__attribute__((target("avx2")))
+static inline __m256i Mul64Avx2(__m256i a, __m256i b)
+{
+	__m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+	                                 _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+	return _mm256_add_epi64(_mm256_mul_epu32(a, b), _mm256_slli_epi64(cross, 32));
+}
+
+/**
+ * Liczy potęgi czwórek punktów. Parametry są takie jak w ScalarPow.
+ * @param[in] n : liczba punktów
+ * @param[in] xs : tablica punktów
+ * @param[in] e : nieujemny wykładnik
+ * @param[out] out : tablica potęg
+ * @return liczba przetworzonych punktów, wielokrotność czterech
+ */
+__attribute__((target("avx2")))
+static size_t PowAvx2(size_t n, const poly_coeff_t xs[], poly_exp_t e, poly_coeff_t out[])
+{
+	size_t j;
+	for (j = 0; j + 4 <= n; j += 4)
+	{
+		__m256i x = _mm256_loadu_si256((const __m256i*)(xs + j));
+		__m256i power = _mm256_set1_epi64x(1);
+		for (poly_exp_t b = e; b; b /= 2)
+		{
+			if (b&1)
+				power = Mul64Avx2(power, x);
+			x = Mul64Avx2(x, x);
+		}
+		_mm256_storeu_si256((__m256i*)(out + j), power);
+	}
+	return j;
+}
+
+/**
+ * Wykonuje krok schematu Hornera dla czwórek punktów.
+ * Parametry są takie jak w ScalarStep.
+ * @param[in] n : liczba punktów
+ * @param[in] powers : tablica potęg punktów
+ * @param[in] c : wyraz wolny kroku
+ * @param[in,out] values : tablica wartości
+ * @return liczba przetworzonych punktów, wielokrotność czterech
+ */
+__attribute__((target("avx2")))
+static size_t StepAvx2(size_t n, const poly_coeff_t powers[], poly_coeff_t c,
+                       poly_coeff_t values[])
+{
+	__m256i constant = _mm256_set1_epi64x(c);
+	size_t j;
+	for (j = 0; j + 4 <= n; j += 4)
+	{
+		__m256i power = _mm256_loadu_si256((const __m256i*)(powers + j));
+		__m256i value = _mm256_loadu_si256((const __m256i*)(values + j));
+		value = _mm256_add_epi64(Mul64Avx2(value, power), constant);
+		_mm256_storeu_si256((__m256i*)(values + j), value);
+	}
+	return j;
+}
+
+#endif /* HORNER_AVX2 */
+
+#ifdef HORNER_NEON
+
+/**
+ * Mnoży parami 64-bitowe pola wektorów modulo @f$2^{64}@f$ za pomocą
+ * iloczynów 32-bitowych połówek, tak jak Mul64Avx2.
+ * @param[in] a : pierwszy wektor
+ * @param[in] b : drugi wektor
+ * @return wektor iloczynów
+ */
+static inline uint64x2_t Mul64Neon(uint64x2_t a, uint64x2_t b)
+{
+	uint32x2_t aLo = vmovn_u64(a), bLo = vmovn_u64(b);
+	uint64x2_t cross = vmull_u32(aLo, vshrn_n_u64(b, 32));
+	cross = vmlal_u32(cross, vshrn_n_u64(a, 32), bLo);
+	return vmlal_u32(vshlq_n_u64(cross, 32), aLo, bLo);
+}
+
+/**
+ * Liczy potęgi par punktów. Parametry są takie jak w ScalarPow.
+ * @param[in] n : liczba punktów
+ * @param[in] xs : tablica punktów
+ * @param[in] e : nieujemny wykładnik
+ * @param[out] out : tablica potęg
+ * @return liczba przetworzonych punktów, wielokrotność dwójki
+ */
+static size_t PowNeon(size_t n, const poly_coeff_t xs[], poly_exp_t e, poly_coeff_t out[])
+{
+	size_t j;
+	for (j = 0; j + 2 <= n; j += 2)
+	{
+		uint64x2_t x = vreinterpretq_u64_s64(vld1q_s64((const int64_t*)(xs + j)));
+		uint64x2_t power = vdupq_n_u64(1);
+		for (poly_exp_t b = e; b; b /= 2)
+		{
+			if (b&1)
+				power = Mul64Neon(power, x);
+			x = Mul64Neon(x, x);
+		}
+		vst1q_s64((int64_t*)(out + j), vreinterpretq_s64_u64(power));
+	}
+	return j;
+}
+
+/**
+ * Wykonuje krok schematu Hornera dla par punktów.
+ * Parametry są takie jak w ScalarStep.
+ * @param[in] n : liczba punktów
+ * @param[in] powers : tablica potęg punktów
+ * @param[in] c : wyraz wolny kroku
+ * @param[in,out] values : tablica wartości
+ * @return liczba przetworzonych punktów, wielokrotność dwójki
+ */
+static size_t StepNeon(size_t n, const poly_coeff_t powers[], poly_coeff_t c,
+                       poly_coeff_t values[])
+{
+	uint64x2_t constant = vdupq_n_u64((uint64_t)c);
+	size_t j;
+	for (j = 0; j + 2 <= n; j += 2)
+	{
+		uint64x2_t power = vreinterpretq_u64_s64(vld1q_s64((const int64_t*)(powers + j)));
+		uint64x2_t value = vreinterpretq_u64_s64(vld1q_s64((const int64_t*)(values + j)));
+		value = vaddq_u64(Mul64Neon(value, power), constant);
+		vst1q_s64((int64_t*)(values + j), vreinterpretq_s64_u64(value));
+	}
+	return j;
+}
+
+#endif /* HORNER_NEON */
+
+/*
+Wyjaśnienie implementacji:
+Obecność AVX2 jest sprawdzana w czasie działania, bo program nie jest
+	kompilowany z flagą -mavx2, ale tylko raz, przy starcie programu.
+	NEON jest obowiązkowy na 64-bitowym ARM, więc tam wystarcza
+	sprawdzenie w czasie kompilacji.
+*/
+void HornerInit(void)
+{
+#if defined(HORNER_AVX2)
+	if (__builtin_cpu_supports("avx2"))
+	{
+		hornerPow = PowAvx2;
+		hornerStep = StepAvx2;
+	}
+#elif defined(HORNER_NEON)
+	hornerPow = PowNeon;
+	hornerStep = StepNeon;
+#endif
+}
+
+/*
+Wyjaśnienie implementacji:
+Wektorowe kernele przetwarzają pełne grupy punktów, a resztę liczy wersja
+	skalarna. Kernele wektorowe liczą modulo @f$2^{64}@f$ i nie wykrywają
+	przepełnień, więc w trybie sprawdzanym i modularnym wszystkie punkty
+	liczy wersja skalarna.
+*/
+/**
+ * Liczy potęgi @f$out_j = x_j^e@f$ dla wszystkich punktów.
+ * @param[in] n : liczba punktów
+ * @param[in] xs : tablica punktów
+ * @param[in] e : nieujemny wykładnik
+ * @param[out] out : tablica potęg
+ */
+static void PowRow(size_t n, const poly_coeff_t xs[], poly_exp_t e, poly_coeff_t out[])
+{
+	size_t done = 0;
+	if (hornerPow != NULL && CoeffIsWrapping())
+		done = hornerPow(n, xs, e, out);
+	ScalarPow(done, n, xs, e, out);
+}
+
+/**
+ * Wykonuje krok schematu Hornera @f$v_j \gets v_j p_j + c@f$
+ * dla wszystkich punktów.
+ * @param[in] n : liczba punktów
+ * @param[in] powers : tablica potęg punktów
+ * @param[in] c : wyraz wolny kroku
+ * @param[in,out] values : tablica wartości
+ */
+static void StepRow(size_t n, const poly_coeff_t powers[], poly_coeff_t c,
+                    poly_coeff_t values[])
+{
+	size_t done = 0;
+	if (hornerStep != NULL && CoeffIsWrapping())
+		done = hornerStep(n, powers, c, values);
+	ScalarStep(done, n, powers, c, values);
+}
+
+/**
+ * Porównuje wykładniki.
+ * @param[in] a : wskaźnik na pierwszy wykładnik
+ * @param[in] b : wskaźnik na drugi wykładnik
+ * @return liczba ujemna, zero lub dodatnia, gdy pierwszy jest mniejszy,
+ * równy lub większy
+ */
+static int ExpCompare(const void *a, const void *b)
+{
+	poly_exp_t x = *(const poly_exp_t*)a, y = *(const poly_exp_t*)b;
+	return (x > y) - (x < y);
+}
+
+/*
+Wyjaśnienie implementacji:
+Zbieram różnice kolejnych wykładników i najmniejszy wykładnik, sortuję je
+	i usuwam powtórzenia. Przy gęstych wielomianach różnic jest niewiele,
+	więc tablica ma kilka wierszy, a każdy krok schematu tylko z niej czyta.
+	Gdy tablica przekroczyłaby HORNER_TABLE_LIMIT potęg, potęgi są liczone
+	w każdym kroku do wiersza roboczego.
+*/
+HornerTable HornerTableInit(const Mono monos[], size_t count, size_t n,
+                            const poly_coeff_t xs[])
+{
+	assert(count > 0);
+	HornerTable table = {.n = n, .xs = xs, .gapCount = 0, .powers = NULL};
+	table.gaps = safeMalloc(count * sizeof(poly_exp_t));
+	if (monos[0].exp != 0)
+		table.gaps[table.gapCount++] = monos[0].exp;
+	for (size_t i = 1; i < count; i++)
+		table.gaps[table.gapCount++] = monos[i].exp - monos[i - 1].exp;
+	qsort(table.gaps, table.gapCount, sizeof(poly_exp_t), ExpCompare);
+
+	size_t unique = 0;
+	for (size_t i = 0; i < table.gapCount; i++)
+		if (unique == 0 || table.gaps[unique - 1] != table.gaps[i])
+			table.gaps[unique++] = table.gaps[i];
+	table.gapCount = unique;
+
+	table.row = safeMalloc((n > 0 ? n : 1) * sizeof(poly_coeff_t));
+	if (n > 0 && unique > 0 && unique <= HORNER_TABLE_LIMIT / n)
+	{
+		table.powers = safeMalloc(unique * n * sizeof(poly_coeff_t));
+		for (size_t i = 0; i < unique; i++)
+			PowRow(n, xs, table.gaps[i], table.powers + i * n);
+	}
+	return table;
+}
+
+void HornerTableDestroy(HornerTable *table)
+{
+	free(table->gaps);
+	free(table->powers);
+	free(table->row);
+}
+
+/**
+ * Daje potęgi wszystkich punktów do wykładnika z tablicy potęg.
+ * @param[in,out] table : tablica potęg
+ * @param[in] e : wykładnik, dla którego utworzono tablicę potęg
+ * @return wiersz potęg punktów
+ */
+static const poly_coeff_t *HornerPowers(HornerTable *table, poly_exp_t e)
+{
+	if (table->powers == NULL)
+	{
+		PowRow(table->n, table->xs, e, table->row);
+		return table->row;
+	}
+	const poly_exp_t *found = bsearch(&e, table->gaps, table->gapCount,
+	                                  sizeof(poly_exp_t), ExpCompare);
+	assert(found != NULL);
+	return table->powers + (size_t)(found - table->gaps) * table->n;
+}
+
+/*
+Wyjaśnienie implementacji:
+Przechodzę tablicę jednomianów raz, od największego wykładnika, i w każdym
+	kroku przetwarzam wszystkie punkty, mnożąc je przez potęgi różnicy
+	kolejnych wykładników z tablicy potęg. Na koniec mnożę wynik przez
+	potęgę najmniejszego wykładnika.
+*/
+void HornerMany(HornerTable *table, const Mono monos[], size_t count,
+                poly_coeff_t values[])
+{
+	assert(count > 0);
+	size_t n = table->n;
+	for (size_t j = 0; j < n; j++)
+		values[j] = monos[count - 1].p.coeff;
+	for (size_t i = count - 1; i > 0; i--)
+		StepRow(n, HornerPowers(table, monos[i].exp - monos[i - 1].exp),
+		        monos[i - 1].p.coeff, values);
+	if (monos[0].exp != 0)
+		StepRow(n, HornerPowers(table, monos[0].exp), 0, values);
+}
+
+void HornerPowMany(HornerTable *table, poly_exp_t e, poly_coeff_t values[])
+{
+	if (e != 0)
+		StepRow(table->n, HornerPowers(table, e), 0, values);
+}
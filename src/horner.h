@@ -0,0 +1,95 @@
+/** @file
+ * @brief Interfejs wektorowego schematu Hornera dla wielu punktów naraz.
+ *
+ * Kernele liczą wartości jednego wielomianu o współczynnikach stałych
+ * w wielu punktach, przechodząc tablicę jednomianów raz, a kolejne punkty
+ * trzymając w kolejnych polach rejestru wektorowego. Potęgi punktów do
+ * różnic kolejnych wykładników są liczone raz na wywołanie, w tablicy
+ * potęg HornerTable, a nie osobno w każdym kroku. Kernele wektorowe
+ * liczą modulo @f$2^{64}@f$ bez wykrywania przepełnień, a w trybie
+ * sprawdzanym i modularnym wszystkie punkty liczy wersja skalarna,
+ * więc wyniki są identyczne jak przy liczeniu w każdym punkcie osobno.
+ *
+ * @author Maurycy Wojda
+ * @date 2021
+ */
+
+#ifndef __HORNER_H__
+#define __HORNER_H__
+
+#include "poly.h"
+
+/**
+ * Największa liczba potęg w tablicy potęg. Gdy różnych różnic wykładników
+ * jest tyle, że tablica byłaby większa, potęgi są liczone w każdym kroku.
+ */
+#define HORNER_TABLE_LIMIT ((size_t)1 << 20)
+
+/**
+ * To jest struktura tablicy potęg punktów do różnic kolejnych wykładników
+ * tablicy jednomianów. W trybie modularnym potęgi są czynnikami
+ * w rozumieniu CoeffToFactor.
+ */
+typedef struct HornerTable
+{
+	size_t n; ///< liczba punktów
+	const poly_coeff_t *xs; ///< tablica punktów
+	size_t gapCount; ///< liczba różnych różnic wykładników
+	poly_exp_t *gaps; ///< różne różnice wykładników posortowane rosnąco
+	poly_coeff_t *powers; ///< potęgi punktów, wiersz na różnicę, lub NULL
+	poly_coeff_t *row; ///< wiersz roboczy na potęgi liczone w kroku
+} HornerTable;
+
+/**
+ * Wybiera kernele wektorowe dostępne na procesorze. Należy ją wywołać raz,
+ * przed pierwszym użyciem pozostałych funkcji i przed uruchomieniem puli
+ * wątków. Bez niej wszystkie punkty liczy wersja skalarna.
+ */
+void HornerInit(void);
+
+/**
+ * Tworzy tablicę potęg punktów do wszystkich różnic kolejnych wykładników
+ * tablicy jednomianów oraz do najmniejszego wykładnika. Tablica jest
+ * ważna, dopóki nie zmieni się tryb arytmetyki współczynników.
+ * @param[in] monos : tablica jednomianów posortowana ściśle rosnąco
+ * po wykładnikach
+ * @param[in] count : liczba jednomianów, co najmniej 1
+ * @param[in] n : liczba punktów
+ * @param[in] xs : tablica punktów, która musi istnieć razem z tablicą potęg
+ * @return tablica potęg
+ */
+HornerTable HornerTableInit(const Mono monos[], size_t count, size_t n,
+                            const poly_coeff_t xs[]);
+
+/**
+ * Zwalnia pamięć tablicy potęg.
+ * @param[in] table : tablica potęg
+ */
+void HornerTableDestroy(HornerTable *table);
+
+/**
+ * Wylicza wartości wielomianu, którego wszystkie jednomiany mają
+ * współczynniki stałe, w punktach tablicy potęg. Na procesorach x86 z AVX2
+ * punkty są przetwarzane czwórkami, na procesorach ARM z NEON parami,
+ * a pozostałe punkty i pozostałe architektury korzystają z wersji skalarnej.
+ * @param[in,out] table : tablica potęg utworzona dla tablicy jednomianów
+ * @param[in] monos : tablica jednomianów posortowana ściśle rosnąco
+ * po wykładnikach, których współczynniki są stałymi
+ * @param[in] count : liczba jednomianów, co najmniej 1
+ * @param[out] values : tablica na wartości wielomianu we wszystkich punktach
+ */
+void HornerMany(HornerTable *table, const Mono monos[], size_t count,
+                poly_coeff_t values[]);
+
+/**
+ * Mnoży każdą wartość przez potęgę odpowiadającego jej punktu, czyli
+ * wykonuje @f$v_j \gets v_j x_j^e@f$. Korzysta z tych samych kerneli
+ * co HornerMany.
+ * @param[in,out] table : tablica potęg
+ * @param[in] e : różnica kolejnych wykładników lub najmniejszy wykładnik
+ * tablicy jednomianów, dla której utworzono tablicę potęg
+ * @param[in,out] values : tablica wartości we wszystkich punktach
+ */
+void HornerPowMany(HornerTable *table, poly_exp_t e, poly_coeff_t values[]);
+
+#endif /* __HORNER_H__ */
@@ -0,0 +1,142 @@
+/** @file
+ * @brief Arytmetyka modularna z redukcją Montgomery'ego.
+ *
+ * Funkcje operują na liczbach modulo nieparzysty moduł mniejszy niż
+ * @f$2^{62}@f$. Redukcja Montgomery'ego zastępuje dzielenie przez moduł
+ * dwoma mnożeniami. Liczba @f$a@f$ w postaci Montgomery'ego to
+ * @f$aR \bmod m@f$, gdzie @f$R = 2^{64}@f$. Iloczyn liczby w zwykłej
+ * postaci przez liczbę w postaci Montgomery'ego wyliczony przez MontMul
+ * jest w zwykłej postaci, co pozwala mnożyć dane przez stałe bez
+ * przeliczania danych.
+ *
+ * @author Maurycy Wojda
+ * @date 2021
+ */
+
+#ifndef __MOD_ARITH_H__
+#define __MOD_ARITH_H__
+
+#include <stdint.h>
+
+/**
+ * To jest struktura przechowująca stałe potrzebne do redukcji
+ * Montgomery'ego dla ustalonego modułu.
+ */
+typedef struct Montgomery
+{
+	uint64_t mod; ///< nieparzysty moduł @f$m < 2^{62}@f$
+	uint64_t inv; ///< @f$-m^{-1} \bmod 2^{64}@f$
+	uint64_t r2; ///< @f$R^2 \bmod m@f$
+} Montgomery;
+
+/**
+ * Przygotowuje stałe redukcji Montgomery'ego dla modułu.
+ * @param[in] mod : nieparzysty moduł mniejszy niż @f$2^{62}@f$
+ * @return stałe redukcji
+ */
+static inline Montgomery MontInit(uint64_t mod)
+{
+	uint64_t inv = mod; // Metoda Newtona: każdy krok podwaja liczbę poprawnych bitów.
+	for (int i = 0; i < 5; i++)
+		inv *= 2 - mod * inv;
+	uint64_t r = (uint64_t)(-mod) % mod;
+	return (Montgomery){
+		.mod = mod,
+		.inv = -inv,
+		.r2 = (uint64_t)((unsigned __int128)r * r % mod)
+	};
+}
+
+/**
+ * Wykonuje redukcję Montgomery'ego.
+ * @param[in] m : stałe redukcji
+ * @param[in] t : liczba mniejsza niż @f$m^2@f$
+ * @return @f$tR^{-1} \bmod m@f$
+ */
+static inline uint64_t MontReduce(const Montgomery *m, unsigned __int128 t)
+{
+	uint64_t q = (uint64_t)t * m->inv;
+	uint64_t result = (uint64_t)((t + (unsigned __int128)q * m->mod) >> 64);
+	return result >= m->mod ? result - m->mod : result;
+}
+
+/**
+ * Mnoży dwie liczby i redukuje wynik.
+ * @param[in] m : stałe redukcji
+ * @param[in] a : pierwszy czynnik mniejszy niż moduł
+ * @param[in] b : drugi czynnik mniejszy niż moduł
+ * @return @f$abR^{-1} \bmod m@f$
+ */
+static inline uint64_t MontMul(const Montgomery *m, uint64_t a, uint64_t b)
+{
+	return MontReduce(m, (unsigned __int128)a * b);
+}
+
+/**
+ * Zamienia liczbę na postać Montgomery'ego.
+ * @param[in] m : stałe redukcji
+ * @param[in] a : liczba
+ * @return @f$aR \bmod m@f$
+ */
+static inline uint64_t MontTo(const Montgomery *m, uint64_t a)
+{
+	return MontMul(m, a % m->mod, m->r2);
+}
+
+/**
+ * Zamienia liczbę z postaci Montgomery'ego na zwykłą.
+ * @param[in] m : stałe redukcji
+ * @param[in] a : liczba w postaci Montgomery'ego
+ * @return @f$aR^{-1} \bmod m@f$
+ */
+static inline uint64_t MontFrom(const Montgomery *m, uint64_t a)
+{
+	return MontReduce(m, a);
+}
+
+/**
+ * Potęguje liczbę w postaci Montgomery'ego.
+ * @param[in] m : stałe redukcji
+ * @param[in] a : podstawa w postaci Montgomery'ego
+ * @param[in] e : wykładnik
+ * @return @f$a^e@f$ w postaci Montgomery'ego
+ */
+static inline uint64_t MontPow(const Montgomery *m, uint64_t a, uint64_t e)
+{
+	uint64_t result = MontTo(m, 1);
+	while (e)
+	{
+		if (e & 1)
+			result = MontMul(m, result, a);
+		a = MontMul(m, a, a);
+		e /= 2;
+	}
+	return result;
+}
+
+/**
+ * Dodaje dwie liczby modulo @p mod.
+ * @param[in] a : pierwszy składnik mniejszy niż moduł
+ * @param[in] b : drugi składnik mniejszy niż moduł
+ * @param[in] mod : moduł
+ * @return @f$a + b \bmod m@f$
+ */
+static inline uint64_t ModAdd(uint64_t a, uint64_t b, uint64_t mod)
+{
+	uint64_t result = a + b;
+	return result >= mod ? result - mod : result;
+}
+
+/**
+ * Odejmuje dwie liczby modulo @p mod.
+ * @param[in] a : odjemna mniejsza niż moduł
+ * @param[in] b : odjemnik mniejszy niż moduł
+ * @param[in] mod : moduł
+ * @return @f$a - b \bmod m@f$
+ */
+static inline uint64_t ModSub(uint64_t a, uint64_t b, uint64_t mod)
+{
+	return a >= b ? a - b : a + mod - b;
+}
+
+#endif /* __MOD_ARITH_H__ */
@@ -5,10 +5,20 @@
  * @date 2021
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "poly.h"
+#include "coeff.h"
+#include "flatpoly.h"
+#include "horner.h"
 #include "safealloc.h"
+#include "taskpool.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #ifdef DOXYGEN
 	#define UNUSED
@@ -39,47 +49,25 @@ static poly_exp_t ExpMin(poly_exp_t a, poly_exp_t b)
 	return a < b ? a : b;
 }
 
-/**
- * Potęguje współczynnik wielomianowy.
- * @param[in] a : współczynnik
- * @param[in] b : potęga
- * @return @f$a^b@f$
- */
-static poly_coeff_t CoeffExp(poly_coeff_t a, poly_exp_t b)
-{
-	assert(b >= 0);
-	poly_coeff_t result = 1;
-	while (b)
-	{
-		if (b&1)
-			result *= a;
-		a *= a;
-		b /= 2;
-	}
-	return result;
-}
-
-/**
- * Porównuje jednomiany na podstawie wykładników.
- * @param[in] MonoA : wskaźnik na pierwszy jednomian
- * @param[in] MonoB : wskaźnik na drugi jednomian
- * @return znormalizowana różnica wykładników jednomianów @f$\in\{-1,0,1\}@f$
- */
-static inline int MonoExpCompare(const void *MonoA, const void *MonoB)
-{
-	assert(MonoA != NULL && MonoB != NULL);
-	int diff = (((Mono*)MonoA)->exp - ((Mono*)MonoB)->exp);
-	return diff < 0 ? -1 : (diff > 0 ? 1 : 0);
-}
+CoeffMode coeffMode = {.mod = 0};
 
+/*
+Wyjaśnienie implementacji:
+Tablice jednomianów i bloki wielkich liczb są współdzielone przez kopie
+	wielomianów, więc tablica (wraz z jej jednomianami) jest niszczona
+	dopiero wtedy, gdy zniknie ostatnia referencja do niej. Wielka liczba
+	ma rozmiar 0, więc pętla po jej jednomianach jest pusta.
+*/
 void PolyDestroy(Poly *p)
 {
 	if (p != NULL)
 	{
-		if (!PolyIsCoeff(p))
+		if (p->arr != NULL && poolRefDec(p->arr) == 0)
+		{
 			for (size_t i = 0; i < p->size; i++)
 				MonoDestroy(&p->arr[i]);
-		free(p->arr);
+			poolFree(p->arr);
+		}
 		p->arr = NULL;
 	}
 }
@@ -112,19 +100,81 @@ static bool PolyIsSorted(const Poly *p)
 }
 
 Poly PolyClone(const Poly *p)
+{
+	assert(p != NULL);
+	if (p->arr != NULL)
+		poolRefInc(p->arr);
+	return *p;
+}
+
+void PolySetModulus(poly_coeff_t mod)
+{
+	assert(mod == 0 || (mod > 1 && mod % 2 == 1 && mod < POLY_MODULUS_LIMIT));
+	coeffMode.mod = (uint64_t)mod;
+	if (mod != 0)
+		coeffMode.mont = MontInit((uint64_t)mod);
+}
+
+poly_coeff_t PolyGetModulus(void)
+{
+	return (poly_coeff_t)coeffMode.mod;
+}
+
+void PolySetChecked(bool checked)
+{
+	coeffMode.checked = checked;
+}
+
+bool PolyIsChecked(void)
+{
+	return coeffMode.checked;
+}
+
+bool PolyTakeOverflow(void)
+{
+	return atomic_exchange_explicit(&coeffMode.overflow, false, memory_order_relaxed);
+}
+
+bool PolyTakeTooBig(void)
+{
+	return atomic_exchange_explicit(&coeffMode.tooBig, false, memory_order_relaxed);
+}
+
+bool PolyHasBig(const Poly *p)
 {
 	assert(p != NULL);
 	if (PolyIsCoeff(p))
-		return (Poly){.coeff = p->coeff, .arr = NULL};
+		return PolyIsBig(p);
+	for (size_t i = 0; i < p->size; i++)
+		if (PolyHasBig(&p->arr[i].p))
+			return true;
+	return false;
+}
 
-	Poly result;
-	result.size = p->size;
-	result.arr = safeMalloc(result.size * sizeof(Mono));
-	for (size_t i = 0; i < result.size; i++)
-		result.arr[i] = MonoClone(&p->arr[i]);
+/**
+ * Zapewnia, że tablica jednomianów wielomianu nie jest współdzielona.
+ * Jeżeli tablica ma więcej niż jednego właściciela, to podmienia ją
+ * na płytką kopię, której jednomiany współdzielą współczynniki
+ * z oryginałem. Funkcję trzeba wywołać przed modyfikacją wielomianu
+ * w miejscu, a współczynniki, które mają być modyfikowane, muszą
+ * zostać potraktowane nią rekurencyjnie.
+ * @param[in,out] p : wielomian
+ */
+static void PolyMakeUnique(Poly *p)
+{
+	assert(p != NULL);
+	if (PolyIsCoeff(p) || poolRefCount(p->arr) == 1)
+		return;
 
-	assert(PolyIsSorted(&result));
-	return result;
+	Mono *copy = poolMalloc(p->size * sizeof(Mono));
+	for (size_t i = 0; i < p->size; i++)
+		copy[i] = MonoClone(&p->arr[i]);
+
+	// Inny właściciel mógł w międzyczasie porzucić oryginał, więc
+	// zwalniam go przez PolyDestroy, gdy była to ostatnia referencja.
+	Poly original = *p;
+	p->arr = copy;
+	PolyDestroy(&original);
 }
 
 /**
@@ -142,7 +192,7 @@ static Poly PolyAddCoeff(const Poly *p, const Poly *q)
 
 	if (PolyIsCoeff(p) && PolyIsCoeff(q)) // Oba są współczynnikami
 	{
-		result = PolyFromCoeff(p->coeff + q->coeff);
+		result = LeafAdd(p, q);
 	}
 	else if (PolyIsCoeff(p) && !PolyIsCoeff(q)) // Pierwszy jest współczynnikiem -> zamiana
 	{
@@ -160,14 +210,14 @@ static Poly PolyAddCoeff(const Poly *p, const Poly *q)
 			if (PolyIsZero(&atExpZero)) // Dodanie stałej do współczynnika daje 0
 			{
 				result.size = p->size - 1;
-				result.arr = safeMalloc(result.size * sizeof(Mono));
+				result.arr = poolMalloc(result.size * sizeof(Mono));
 				for (size_t i = 1; i < p->size; i++)
 					result.arr[i-1] = MonoClone(&p->arr[i]);
 			}
 			else // Dodanie stałej do współczynnika daje niezerową stałą
 			{
 				result.size = p->size;
-				result.arr = safeMalloc(result.size * sizeof(Mono));
+				result.arr = poolMalloc(result.size * sizeof(Mono));
 				for (size_t i = 1; i < p->size; i++)
 					result.arr[i] = MonoClone(&p->arr[i]);
 				result.arr[0].p = atExpZero;
@@ -177,10 +227,11 @@ static Poly PolyAddCoeff(const Poly *p, const Poly *q)
 		else // Wielomian nie zawiera stałej -> rozszerz tablicę o stałą
 		{
 			result.size = p->size + 1;
-			result.arr = safeMalloc(result.size * sizeof(Mono));
+			result.arr = poolMalloc(result.size * sizeof(Mono));
 			for (size_t i = 0; i < p->size; i++)
 				result.arr[i + 1] = MonoClone(&p->arr[i]);
-			result.arr[0] = MonoFromPoly(q, 0);
+			Poly constant = PolyClone(q);
+			result.arr[0] = MonoFromPoly(&constant, 0);
 		}
 	}
 
@@ -201,7 +252,7 @@ static Poly PolyAddNonCoeffs(const Poly *p, const Poly *q)
 	Poly result;
 
 	result.size = p->size + q->size;
-	result.arr = safeMalloc(result.size * sizeof(Mono));
+	result.arr = poolMalloc(result.size * sizeof(Mono));
 	size_t pi = 0, qi = 0, resi = 0;
 
 	// Pętla wypełniająca tablicę result.arr sumami jednomianów z odpowiednimi wykładnikami.
@@ -237,7 +288,7 @@ static Poly PolyAddNonCoeffs(const Poly *p, const Poly *q)
 	if (result.size != resi)
 	{
 		result.size = resi;
-		safeRealloc((void**)&result.arr, result.size * sizeof(Mono));
+		poolRealloc((void**)&result.arr, result.size * sizeof(Mono));
 	}
 
 	assert(PolyIsSorted(&result));
@@ -276,74 +327,43 @@ Poly PolyAdd(const Poly *p, const Poly *q)
 	{
 		Mono *toFree = result.arr;
 		result = result.arr[0].p;
-		free(toFree);
+		poolFree(toFree);
 	}
 
 	assert(PolyIsSorted(&result));
 	return result;
 }
 
-/*
-Wyjaśnienie implementacji:
-Jeżeli tablica jest pusta, to result oczywiście zerowy.
-W przeciwnym przypadku sortuję tablicę po wykładnikach.
-W zmiennej PolySum akumuluje sumę wielomianów przy
-	jednakowych wykładnikach. Gdy wykrywam zmianę wykładnika
-	na inny, to zapisuję uzyskaną sumę wielomianów w kolejnym
-	polu tablicy, które wiem, że już nie będzie używane, ale
-	tylko, jeżeli uzyskany wielomian nie jest zerowy.
-Gdy skończą się jednomiany zmniejszam, o ile można, rozmiar
-	tablicy, z której później tworzę wielomian, lecz najpierw,
-	trzeba dopilnować kilku szczegółów:
-Po pierwsze, jeżeli uzyskana tablica jest pusta, to znaczy,
-	że wszystkie jednomiany się wyzerowały.
-Po drugie, jeżeli jedynym wykładnikiem w resultowej tablicy
-	jest wykładnik zerowy, to wielomian jest tożsamościowo
-	równy odpowiedniemu współczynnikowi. Należy wtedy tak
-	go przedstawiać w pamięci.
-Jeżeli żaden z powyższych warunków nie zachodzi, to result
-	jest tworzony wprost z uzyskanej tablicy.
-*/
-Poly PolyOwnMonos(size_t count, Mono *monos)
+/**
+ * Tworzy wielomian z tablicy jednomianów posortowanej ściśle rosnąco
+ * po wykładnikach. Pomija jednomiany o zerowych współczynnikach,
+ * zmniejsza tablicę do potrzebnego rozmiaru, a jeżeli jedynym
+ * wykładnikiem jest zero przy współczynniku stałym, to zwraca ten
+ * współczynnik. Przejmuje na własność tablicę @p monos zaalokowaną
+ * funkcją poolMalloc.
+ * @param[in] count : liczba jednomianów
+ * @param[in] monos : tablica jednomianów
+ * @return wielomian złożony z niezerowych jednomianów tablicy
+ */
+static Poly PolyFromSortedMonos(size_t count, Mono *monos)
 {
-	if (count == 0 || monos == NULL)
-		return PolyZero();
-
-	qsort(monos, count, sizeof(Mono), MonoExpCompare);
 	size_t newMonoIndex = 0;
-	Poly polySum = monos[0].p, newPoly;
-
-	for (size_t i = 1; i < count; i++)
-	{
-		if (monos[i - 1].exp == monos[i].exp)
-		{
-			newPoly = PolyAdd(&polySum, &monos[i].p);
-			PolyDestroy(&polySum);
-			MonoDestroy(&monos[i]);
-			polySum = newPoly;
-		}
-		else
-		{
-			if (!PolyIsZero(&polySum))
-				monos[newMonoIndex++] = MonoFromPoly(&polySum, monos[i - 1].exp);
-			polySum = monos[i].p;
-		}
-	}
-	if (!PolyIsZero(&polySum))
-		monos[newMonoIndex++] = MonoFromPoly(&polySum, monos[count - 1].exp);
+	for (size_t i = 0; i < count; i++)
+		if (!PolyIsZero(&monos[i].p))
+			monos[newMonoIndex++] = monos[i];
 
-	safeRealloc((void**)&monos, newMonoIndex * sizeof(Mono));
+	poolRealloc((void**)&monos, newMonoIndex * sizeof(Mono));
 
 	Poly result;
 	if (newMonoIndex == 0)
 	{
 		result = PolyZero();
-		free(monos);
+		poolFree(monos);
 	}
 	else if (newMonoIndex == 1 && monos[0].exp == 0 && PolyIsCoeff(&monos[0].p))
 	{
 		result = monos[0].p;
-		free(monos);
+		poolFree(monos);
 	}
 	else
 	{
@@ -354,168 +374,1316 @@ Poly PolyOwnMonos(size_t count, Mono *monos)
 	return result;
 }
 
-Poly PolyAddMonos(size_t count, const Mono monosIn[])
+/*
+Wyjaśnienie implementacji:
+Sprowadzam współczynniki stałe w miejscu, a jednomiany, których
+	współczynniki wyzerowały się po redukcji, usuwa PolyFromSortedMonos,
+	więc wynik spełnia ten sam standard co wyniki pozostałych operacji.
+*/
+Poly PolyReduce(Poly *p)
 {
-	if (count == 0 || monosIn == NULL)
-		return PolyZero();
+	assert(p != NULL);
+	Poly result;
+	if (PolyIsCoeff(p))
+	{
+		result = PolyIsBig(p) ? BigReduce(p) : PolyFromCoeff(CoeffReduce(p->coeff));
+		PolyDestroy(p);
+	}
+	else
+	{
+		PolyMakeUnique(p);
+		for (size_t i = 0; i < p->size; i++)
+			p->arr[i].p = PolyReduce(&p->arr[i].p);
+		result = PolyFromSortedMonos(p->size, p->arr);
+	}
 
-	Mono *monos = safeMalloc(count * sizeof(Mono));
-	memcpy(monos, monosIn, count * sizeof(Mono));
-	return PolyOwnMonos(count, monos);
+	*p = PolyZero();
+	assert(PolyIsSorted(&result));
+	return result;
 }
 
-Poly PolyCloneMonos(size_t count, const Mono monosIn[])
+/**
+ * Zapewnia, że w tablicy akumulatora zmieści się jeszcze @p extra jednomianów.
+ * @param[in,out] acc : akumulator
+ * @param[in] extra : liczba dopisywanych jednomianów
+ */
+static void AccReserve(PolyAcc *acc, size_t extra)
 {
-	if (count == 0 || monosIn == NULL)
-		return PolyZero();
+	if (acc->size + extra <= acc->capacity)
+		return;
 
-	Mono *monos = safeMalloc(count * sizeof(Mono));
-	for (size_t i = 0; i < count; i++)
-		monos[i] = MonoClone(&monosIn[i]);
-	return PolyOwnMonos(count, monos);
+	acc->capacity *= 2;
+	if (acc->capacity < acc->size + extra)
+		acc->capacity = acc->size + extra;
+	poolRealloc((void**)&acc->arr, acc->capacity * sizeof(Mono));
+}
+
+/**
+ * Daje długość ciągu akumulatora o podanym indeksie.
+ * @param[in] acc : akumulator
+ * @param[in] run : indeks ciągu
+ * @return liczba jednomianów w ciągu
+ */
+static inline size_t AccRunLength(const PolyAcc *acc, size_t run)
+{
+	return (run + 1 < acc->runCount ? acc->runs[run + 1] : acc->size) - acc->runs[run];
 }
 
 /*
 Wyjaśnienie implementacji:
-Jeżeli p i q są współczynnikami, to result jest oczywisty.
-Jeżeli tylko p jest współczynnikiem, to zamiana miejscami.
-Jeżeli tylko q jest współczynnikiem, to tworzę nową tablicę
-	jednomianów, przemnażając każdy przez q, potem zwracam result.
-Jeżeli zarówno p jak i q są wielomianami, to tworzę nową
-	tablicę jednomianów, przemnażając każdy jednomian z p z każdym
-	jednomianem z q, dodając wykładniki, potem zwracam result.
+Scalam dwa ostatnie ciągi do tymczasowej tablicy, dodając w miejscu
+	współczynniki jednomianów o równych wykładnikach i pomijając
+	wyzerowane sumy, po czym przepisuję wynik z powrotem na miejsce
+	przedostatniego ciągu.
 */
-Poly PolyMul(const Poly *p, const Poly *q)
+/**
+ * Scala dwa ostatnie ciągi akumulatora w jeden posortowany ciąg.
+ * @param[in,out] acc : akumulator
+ */
+static void AccMergeTop(PolyAcc *acc)
 {
-	assert(p != NULL && q != NULL);
-	Poly result;
+	assert(acc->runCount >= 2);
+	size_t a = acc->runs[acc->runCount - 2], b = acc->runs[acc->runCount - 1];
+	size_t c = acc->size, i = a, j = b, k = 0;
+	Mono *arr = acc->arr, *merged = poolMalloc((c - a) * sizeof(Mono));
 
-	if (PolyIsCoeff(p) && PolyIsCoeff(q))
+	while (i < b && j < c)
 	{
-		result = PolyFromCoeff(p->coeff * q->coeff);
+		if (arr[i].exp < arr[j].exp)
+		{
+			merged[k++] = arr[i++];
+		}
+		else if (arr[i].exp > arr[j].exp)
+		{
+			merged[k++] = arr[j++];
+		}
+		else
+		{
+			Poly sum = PolyAddOwn(&arr[i].p, &arr[j].p);
+			if (!PolyIsZero(&sum))
+				merged[k++] = (Mono){.p = sum, .exp = arr[i].exp};
+			i++;
+			j++;
+		}
 	}
-	else if (PolyIsCoeff(p) && !PolyIsCoeff(q))
+	memcpy(merged + k, arr + i, (b - i) * sizeof(Mono));
+	k += b - i;
+	memcpy(merged + k, arr + j, (c - j) * sizeof(Mono));
+	k += c - j;
+
+	memcpy(arr + a, merged, k * sizeof(Mono));
+	poolFree(merged);
+	acc->size = a + k;
+	acc->runCount--;
+}
+
+/*
+Wyjaśnienie implementacji:
+Jeżeli nowe jednomiany przedłużają posortowany ostatni ciąg, to
+	nie tworzę nowego ciągu. W przeciwnym przypadku tworzę nowy ciąg
+	i scalam ostatnie ciągi, dopóki przedostatni nie jest ponad
+	dwukrotnie dłuższy od ostatniego. Dzięki temu długości ciągów
+	maleją wykładniczo, ciągów jest co najwyżej logarytmicznie wiele,
+	a każdy jednomian bierze udział w logarytmicznej liczbie scaleń.
+*/
+/**
+ * Rejestruje jednomiany dopisane do akumulatora od pozycji @p start
+ * jako posortowany ciąg i przywraca niezmiennik długości ciągów.
+ * @param[in,out] acc : akumulator
+ * @param[in] start : początek dopisanych jednomianów
+ */
+static void AccCloseRun(PolyAcc *acc, size_t start)
+{
+	if (start == acc->size)
+		return;
+
+	if (acc->runCount == 0 || (start != acc->runs[acc->runCount - 1] &&
+	                           acc->arr[start - 1].exp >= acc->arr[start].exp))
 	{
-		result = PolyMul(q, p);
+		assert(acc->runCount < ACC_MAX_RUNS);
+		acc->runs[acc->runCount++] = start;
 	}
-	else if (PolyIsCoeff(q))
-	{
-		Mono *monos = safeMalloc((p->size) * sizeof(Mono));
 
-		for(size_t i = 0; i < p->size; i++)
-		{
-			monos[i].p = PolyMul(&p->arr[i].p, q);
-			monos[i].exp = p->arr[i].exp;
-		}
+	while (acc->runCount >= 2 &&
+	       AccRunLength(acc, acc->runCount - 2) <= 2 * AccRunLength(acc, acc->runCount - 1))
+		AccMergeTop(acc);
+}
+
+/*
+Wyjaśnienie implementacji:
+Współczynniki sumuję osobno, bez dotykania tablicy. Jeżeli akumulator
+	jest pusty, a tablica p nie jest współdzielona, to przejmuję ją
+	w całości jako tablicę akumulatora. W przeciwnym przypadku dopisuję
+	jednomiany p na koniec tablicy, przejmując je lub kopiując za pomocą
+	MonoClone, gdy tablica p jest współdzielona.
+*/
+void AccAdd(PolyAcc *acc, Poly *p)
+{
+	assert(acc != NULL && p != NULL);
+	if (PolyIsCoeff(p))
+	{
+		Poly sum = LeafAdd(&acc->coeff, p);
+		PolyDestroy(&acc->coeff);
+		PolyDestroy(p);
+		acc->coeff = sum;
+		*p = PolyZero();
+		return;
+	}
 
-		result = PolyOwnMonos(p->size, monos);
+	size_t start = acc->size;
+	if (acc->arr == NULL && poolRefCount(p->arr) == 1)
+	{
+		acc->arr = p->arr;
+		acc->size = acc->capacity = p->size;
 	}
 	else
 	{
-		Mono *monos = safeMalloc((p->size * q->size) * sizeof(Mono));
-
-		for (size_t i = 0; i < p->size; i++)
-			for (size_t j = 0; j < q->size; j++)
-			{
-				monos[i * q->size + j].p = PolyMul(&p->arr[i].p, &q->arr[j].p);
-				monos[i * q->size + j].exp = p->arr[i].exp + q->arr[j].exp;
-			}
-
-		result = PolyOwnMonos(p->size * q->size, monos);
+		AccReserve(acc, p->size);
+		if (poolRefCount(p->arr) == 1)
+		{
+			memcpy(acc->arr + acc->size, p->arr, p->size * sizeof(Mono));
+			poolFree(p->arr);
+		}
+		else
+		{
+			for (size_t i = 0; i < p->size; i++)
+				acc->arr[acc->size + i] = MonoClone(&p->arr[i]);
+			PolyDestroy(p);
+		}
+		acc->size += p->size;
 	}
 
-	assert(PolyIsSorted(&result));
-	return result;
+	*p = PolyZero();
+	AccCloseRun(acc, start);
 }
 
-void PolyMulByCoeffInPlace(Poly *p, poly_coeff_t c)
+void AccAddScaled(PolyAcc *acc, Poly *p, poly_coeff_t c)
 {
-	if (PolyIsCoeff(p))
-		p->coeff *= c;
-	else
-		for (size_t i = 0; i < p->size; i++)
-			PolyMulByCoeffInPlace(&p->arr[i].p, c);
-	assert(PolyIsSorted(p));
+	PolyMulByCoeffInPlace(p, c);
+	AccAdd(acc, p);
 }
 
-Poly PolyExp(const Poly *p, poly_exp_t e)
+/*
+Wyjaśnienie implementacji:
+Scalam wszystkie pozostałe ciągi w jeden, z którego PolyFromSortedMonos
+	usuwa zerowe jednomiany i sprowadza wynik do współczynnika, jeśli
+	trzeba. Na końcu dodaję zsumowane współczynniki.
+*/
+Poly AccFinish(PolyAcc *acc)
 {
-	Poly multiplier = PolyClone(p);
-	Poly result = PolyFromCoeff(1);
-	Poly temp;
+	assert(acc != NULL);
+	while (acc->runCount >= 2)
+		AccMergeTop(acc);
 
-	while(e)
+	Poly result, constant = acc->coeff;
+	if (acc->size == 0)
 	{
-		if (e&1)
-		{
-			temp = PolyMul(&result, &multiplier);
-			PolyDestroy(&result);
-			result = temp;
-		}
-		temp = PolyMul(&multiplier, &multiplier);
-		PolyDestroy(&multiplier);
-		multiplier = temp;
-		e /= 2;
+		poolFree(acc->arr);
+		result = constant;
+	}
+	else
+	{
+		result = PolyFromSortedMonos(acc->size, acc->arr);
+		result = PolyAddOwn(&result, &constant);
 	}
 
-	PolyDestroy(&multiplier);
+	*acc = AccInit();
 	assert(PolyIsSorted(&result));
 	return result;
 }
 
 /*
 Wyjaśnienie implementacji:
-Jeżeli p jest współczynnikiem, to result jest oczywisty.
-W przeciwnym wypadku tworzę płytką kopię tablicy jednomianów
-	i każdy z nich zastępuję jego nowo stworzoną przeciwnością.
-	Stanowi to oczywiście tablicę jednomianów w wielomianie
-	przeciwnym, więc zwracam result.
+Jeżeli tablica jest pusta, to result oczywiście zerowy.
+W przeciwnym przypadku tablica staje się tablicą akumulatora,
+	a jej rosnące fragmenty kolejno stają się jego ciągami. Ciągi
+	są dosuwane do końca dotychczasowej zawartości akumulatora,
+	która po scaleniach może być krótsza od przetworzonej części
+	tablicy. Posortowana tablica jest więc przetwarzana w czasie
+	liniowym, a dowolna w czasie @f$O(n \log n)@f$.
 */
-Poly PolyNeg(const Poly *p)
+/**
+ * Sumuje listę jednomianów i tworzy z nich wielomian.
+ * Działa jak PolyOwnMonos, ale zakłada, że pamięć wskazywana przez @p monos
+ * została zaalokowana funkcją poolMalloc. Z tej funkcji korzystają
+ * operacje biblioteki, dzięki czemu tablice jednomianów nie są kopiowane.
+ * @param[in] count : liczba jednomianów
+ * @param[in] monos : tablica jednomianów
+ * @return wielomian będący sumą jednomianów
+ */
+static Poly PolyOwnPoolMonos(size_t count, Mono *monos)
 {
-	assert(p != NULL);
-	if (PolyIsCoeff(p))
-		return PolyFromCoeff(-p->coeff);
-
-	Poly result;
-	result.size = p->size;
-	result.arr = (Mono*)safeMalloc(p->size * sizeof(Mono));
-	memcpy(result.arr, p->arr, p->size * sizeof(Mono));
+	if (count == 0 || monos == NULL)
+	{
+		poolFree(monos);
+		return PolyZero();
+	}
 
-	for (size_t i = 0; i < result.size; i++)
-		result.arr[i].p = PolyNeg(&result.arr[i].p);
+	PolyAcc acc = AccInit();
+	acc.arr = monos;
+	acc.capacity = count;
+	for (size_t i = 0, end; i < count; i = end)
+	{
+		for (end = i + 1; end < count && monos[end - 1].exp < monos[end].exp; end++);
+		size_t start = acc.size;
+		memmove(monos + start, monos + i, (end - i) * sizeof(Mono));
+		acc.size += end - i;
+		AccCloseRun(&acc, start);
+	}
 
-	assert(PolyIsSorted(&result));
-	return result;
+	return AccFinish(&acc);
 }
 
-void PolyNegInPlace(Poly *p)
+Poly PolyOwnMonos(size_t count, Mono *monos)
 {
-	assert(p != NULL);
-	if (PolyIsCoeff(p))
-		return (void)(p->coeff = -p->coeff);
+	if (count == 0 || monos == NULL)
+	{
+		free(monos);
+		return PolyZero();
+	}
 
-	for (size_t i = 0; i < p->size; i++)
-		PolyNegInPlace(&p->arr[i].p);
+	Mono *pooled = poolMalloc(count * sizeof(Mono));
+	memcpy(pooled, monos, count * sizeof(Mono));
+	free(monos);
+	return PolyOwnPoolMonos(count, pooled);
+}
 
-	assert(PolyIsSorted(p));
+Poly PolyAddMonos(size_t count, const Mono monosIn[])
+{
+	if (count == 0 || monosIn == NULL)
+		return PolyZero();
+
+	Mono *monos = poolMalloc(count * sizeof(Mono));
+	memcpy(monos, monosIn, count * sizeof(Mono));
+	return PolyOwnPoolMonos(count, monos);
 }
 
-Poly PolySub(const Poly *p, const Poly *q)
+Poly PolyCloneMonos(size_t count, const Mono monosIn[])
 {
-	Poly qNeg = PolyNeg(q);
-	Poly result = PolyAdd(p, &qNeg);
-	PolyDestroy(&qNeg);
+	if (count == 0 || monosIn == NULL)
+		return PolyZero();
 
-	assert(PolyIsSorted(&result));
-	return result;
+	Mono *monos = poolMalloc(count * sizeof(Mono));
+	for (size_t i = 0; i < count; i++)
+		monos[i] = MonoClone(&monosIn[i]);
+	return PolyOwnPoolMonos(count, monos);
 }
 
-poly_exp_t PolyDegBy(const Poly *p, size_t var_idx)
+/**
+ * Element kopca używanego przy mnożeniu wielomianów.
+ * Reprezentuje iloczyn jednomianu @f$a_i@f$ przez jednomian @f$b_j@f$,
+ * a przy dodawaniu wielu wielomianów @f$j@f$-ty jednomian @f$i@f$-tego
+ * składnika.
+ */
+typedef struct MulHeapEntry
 {
-	assert(p != NULL);
-	if (PolyIsZero(p))
-		return -1;
+	poly_exp_t exp; ///< wykładnik iloczynu @f$a_i b_j@f$
+	size_t i; ///< indeks jednomianu w pierwszym czynniku
+	size_t j; ///< indeks jednomianu w drugim czynniku
+} MulHeapEntry;
+
+/**
+ * Wstawia element do kopca minimum uporządkowanego po wykładnikach.
+ * @param[in,out] heap : tablica kopca o wystarczającej pojemności
+ * @param[in,out] heapSize : rozmiar kopca
+ * @param[in] entry : wstawiany element
+ */
+static void MulHeapPush(MulHeapEntry *heap, size_t *heapSize, MulHeapEntry entry)
+{
+	size_t pos = (*heapSize)++;
+	while (pos > 0 && heap[(pos - 1) / 2].exp > entry.exp)
+	{
+		heap[pos] = heap[(pos - 1) / 2];
+		pos = (pos - 1) / 2;
+	}
+	heap[pos] = entry;
+}
+
+/**
+ * Usuwa z kopca minimum element o najmniejszym wykładniku.
+ * @param[in,out] heap : tablica kopca
+ * @param[in,out] heapSize : niezerowy rozmiar kopca
+ * @return usunięty element
+ */
+static MulHeapEntry MulHeapPop(MulHeapEntry *heap, size_t *heapSize)
+{
+	MulHeapEntry top = heap[0], last = heap[--*heapSize];
+	size_t pos = 0, child;
+	while ((child = 2 * pos + 1) < *heapSize)
+	{
+		if (child + 1 < *heapSize && heap[child + 1].exp < heap[child].exp)
+			child++;
+		if (heap[child].exp >= last.exp)
+			break;
+		heap[pos] = heap[child];
+		pos = child;
+	}
+	heap[pos] = last;
+	return top;
+}
+
+/*
+Wyjaśnienie implementacji:
+Mnożenie metodą Johnsona z kopcem Monagana-Pearce'a. Iloczyny
+	@f$a_i b_j@f$ są wyciągane z kopca w kolejności rosnących
+	wykładników, więc wynik powstaje od razu posortowany, a jednomiany
+	o równych wykładnikach są sumowane zaraz po wyjęciu z kopca.
+W kopcu jest co najwyżej jeden iloczyn na każdy jednomian krótszego
+	czynnika a: po wyjęciu @f$a_i b_j@f$ wstawiam @f$a_i b_{j+1}@f$,
+	a gdy @f$j = 0@f$, to również @f$a_{i+1} b_0@f$, którego wykładnik
+	nie może być mniejszy od wykładnika @f$a_i b_0@f$.
+Współczynniki są mnożone rekurencyjnie przez PolyMul, dzięki czemu
+	ta sama metoda działa na każdym poziomie wielomianu.
+Pamięć pomocnicza to kopiec rozmiaru krótszego czynnika oraz wynik.
+*/
+/**
+ * Mnoży dwa wielomiany, z których żaden nie jest współczynnikiem.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p * q@f$
+ */
+static Poly PolyMulHeap(const Poly *p, const Poly *q)
+{
+	assert(!PolyIsCoeff(p) && !PolyIsCoeff(q));
+	const Poly *a = p->size <= q->size ? p : q;
+	const Poly *b = p->size <= q->size ? q : p;
+
+	size_t heapSize = 0, count = 0, capacity = a->size + b->size;
+	MulHeapEntry *heap = safeMalloc(a->size * sizeof(MulHeapEntry));
+	Mono *monos = poolMalloc(capacity * sizeof(Mono));
+	PolyAcc sumAcc = AccInit();
+	Poly polySum, polyProd;
+	poly_exp_t sumExp = a->arr[0].exp + b->arr[0].exp;
+
+	MulHeapPush(heap, &heapSize,
+	            (MulHeapEntry){.exp = sumExp, .i = 0, .j = 0});
+
+	while (heapSize > 0)
+	{
+		MulHeapEntry top = MulHeapPop(heap, &heapSize);
+
+		if (top.exp != sumExp)
+		{
+			polySum = AccFinish(&sumAcc);
+			if (!PolyIsZero(&polySum))
+			{
+				if (count == capacity)
+				{
+					capacity *= 2;
+					poolRealloc((void**)&monos, capacity * sizeof(Mono));
+				}
+				monos[count++] = MonoFromPoly(&polySum, sumExp);
+			}
+		}
+		sumExp = top.exp;
+
+		polyProd = PolyMul(&a->arr[top.i].p, &b->arr[top.j].p);
+		AccAdd(&sumAcc, &polyProd);
+
+		if (top.j + 1 < b->size)
+			MulHeapPush(heap, &heapSize,
+			            (MulHeapEntry){.exp = a->arr[top.i].exp + b->arr[top.j + 1].exp,
+			                           .i = top.i, .j = top.j + 1});
+		if (top.j == 0 && top.i + 1 < a->size)
+			MulHeapPush(heap, &heapSize,
+			            (MulHeapEntry){.exp = a->arr[top.i + 1].exp + b->arr[0].exp,
+			                           .i = top.i + 1, .j = 0});
+	}
+
+	polySum = AccFinish(&sumAcc);
+	if (!PolyIsZero(&polySum))
+	{
+		if (count == capacity)
+			poolRealloc((void**)&monos, ++capacity * sizeof(Mono));
+		monos[count++] = MonoFromPoly(&polySum, sumExp);
+	}
+
+	free(heap);
+	return PolyFromSortedMonos(count, monos);
+}
+
+/**
+ * Dodaje stałą do wielomianu, który nie jest współczynnikiem,
+ * przejmując oba na własność.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] c : wielomian stały @f$c@f$
+ * @return @f$p + c@f$
+ */
+static Poly PolyAddCoeffOwn(Poly *p, Poly *c)
+{
+	assert(!PolyIsCoeff(p) && PolyIsCoeff(c));
+	if (PolyIsZero(c))
+		return *p;
+
+	PolyMakeUnique(p);
+	if (p->arr[0].exp == 0)
+	{
+		p->arr[0].p = PolyAddOwn(&p->arr[0].p, c);
+		return PolyFromSortedMonos(p->size, p->arr);
+	}
+
+	poolRealloc((void**)&p->arr, (p->size + 1) * sizeof(Mono));
+	memmove(p->arr + 1, p->arr, p->size * sizeof(Mono));
+	p->arr[0] = (Mono){.p = *c, .exp = 0};
+	return PolyFromSortedMonos(p->size + 1, p->arr);
+}
+
+/*
+Wyjaśnienie implementacji:
+Tablica jednomianów p nie jest współdzielona, więc powiększam ją do
+	sumy rozmiarów (co często nie wymaga przenoszenia bloku z puli)
+	i scalam od końca: największe jednomiany trafiają na koniec tablicy,
+	a pozycja zapisu nigdy nie wyprzedza nieprzetworzonych jednomianów p.
+Ciągi jednomianów występujących tylko w jednym składniku przenoszę
+	w całości za pomocą memmove lub memcpy. Jednomiany q przejmuję,
+	jeżeli tablica q nie jest współdzielona, a w przeciwnym przypadku
+	kopiuję je za pomocą MonoClone, co tylko zwiększa liczniki referencji.
+Scalenia jednomianów o równych wykładnikach zostawiają lukę między
+	pozostałymi na początku jednomianami p a resztą wyniku, którą
+	na końcu usuwam, a wyzerowane sumy usuwa PolyFromSortedMonos.
+*/
+/**
+ * Dodaje dwa wielomiany, które nie są współczynnikami, przejmując je
+ * na własność. Tablica jednomianów @p p nie może być współdzielona.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p + q@f$
+ */
+static Poly PolyAddNonCoeffsOwn(Poly *p, Poly *q)
+{
+	assert(poolRefCount(p->arr) == 1);
+	size_t i = p->size, j = q->size, k = p->size + q->size, run;
+	bool stealQ = poolRefCount(q->arr) == 1;
+	Mono *arr = p->arr, *qArr = q->arr;
+	poolRealloc((void**)&arr, k * sizeof(Mono));
+
+	while (j > 0)
+	{
+		if (i > 0 && arr[i - 1].exp > qArr[j - 1].exp)
+		{
+			for (run = i - 1; run > 0 && arr[run - 1].exp > qArr[j - 1].exp; run--);
+			memmove(arr + k - (i - run), arr + run, (i - run) * sizeof(Mono));
+			k -= i - run;
+			i = run;
+		}
+		else if (i > 0 && arr[i - 1].exp == qArr[j - 1].exp)
+		{
+			Poly other = stealQ ? qArr[j - 1].p : PolyClone(&qArr[j - 1].p);
+			i--;
+			j--;
+			k--;
+			arr[k] = (Mono){.p = PolyAddOwn(&arr[i].p, &other), .exp = qArr[j].exp};
+		}
+		else
+		{
+			for (run = j - 1; run > 0 && (i == 0 || qArr[run - 1].exp > arr[i - 1].exp); run--);
+			if (stealQ)
+				memcpy(arr + k - (j - run), qArr + run, (j - run) * sizeof(Mono));
+			else
+				for (size_t m = run; m < j; m++)
+					arr[k - (j - m)] = MonoClone(&qArr[m]);
+			k -= j - run;
+			j = run;
+		}
+	}
+
+	size_t count = i + p->size + q->size - k;
+	memmove(arr + i, arr + k, (p->size + q->size - k) * sizeof(Mono));
+
+	if (stealQ)
+		poolFree(qArr);
+	else
+		PolyDestroy(q);
+
+	return PolyFromSortedMonos(count, arr);
+}
+
+/*
+Wyjaśnienie implementacji:
+Jeżeli któryś ze składników jest współczynnikiem, to dodaję go do
+	drugiego w miejscu. Jeżeli oba są wielomianami, to scalam je
+	w tablicy tego, którego tablica nie jest współdzielona. Gdy obie
+	są współdzielone, to nie da się niczego przejąć i wykonuję zwykłe
+	dodawanie, po którym tylko zwalniam referencje do składników.
+*/
+Poly PolyAddOwn(Poly *p, Poly *q)
+{
+	assert(p != NULL && q != NULL);
+	Poly result;
+
+	if (PolyIsCoeff(p) && PolyIsCoeff(q))
+	{
+		result = LeafAdd(p, q);
+		PolyDestroy(p);
+		PolyDestroy(q);
+	}
+	else if (PolyIsCoeff(p))
+	{
+		result = PolyAddCoeffOwn(q, p);
+	}
+	else if (PolyIsCoeff(q))
+	{
+		result = PolyAddCoeffOwn(p, q);
+	}
+	else if (poolRefCount(p->arr) == 1)
+	{
+		result = PolyAddNonCoeffsOwn(p, q);
+	}
+	else if (poolRefCount(q->arr) == 1)
+	{
+		result = PolyAddNonCoeffsOwn(q, p);
+	}
+	else
+	{
+		result = PolyAdd(p, q);
+		PolyDestroy(p);
+		PolyDestroy(q);
+	}
+
+	*p = PolyZero();
+	*q = PolyZero();
+	assert(PolyIsSorted(&result));
+	return result;
+}
+
+/*
+Wyjaśnienie implementacji:
+Scalam naraz tablice jednomianów wszystkich składników, które nie są
+	współczynnikami. W kopcu jest po jednym jednomianie z każdej tablicy,
+	więc jednomiany wychodzą z niego w kolejności rosnących wykładników.
+	Jednomiany o równych wykładnikach zbieram w grupę: współczynnik
+	pojedynczego jednomianu klonuję, a współczynniki większej grupy
+	sumuję rekurencyjnie tą samą metodą. Każdy jednomian przechodzi przez
+	kopiec raz, więc suma @f$n@f$ wielomianów o łącznie @f$N@f$
+	jednomianach kosztuje @f$O(N \log n)@f$ zamiast @f$O(nN)@f$ przy
+	dodawaniu kolejno do rosnącej sumy.
+Składniki będące współczynnikami sumuję osobno i dodaję na końcu.
+*/
+Poly PolyAddMany(size_t n, const Poly ps[])
+{
+	assert(n == 0 || ps != NULL);
+	Poly constant = PolyZero(), sum;
+	size_t total = 0, heapSize = 0;
+	MulHeapEntry *heap = safeMalloc(n * sizeof(MulHeapEntry));
+
+	for (size_t i = 0; i < n; i++)
+	{
+		if (PolyIsCoeff(&ps[i]))
+		{
+			sum = LeafAdd(&constant, &ps[i]);
+			PolyDestroy(&constant);
+			constant = sum;
+		}
+		else
+		{
+			total += ps[i].size;
+			MulHeapPush(heap, &heapSize, (MulHeapEntry){.exp = ps[i].arr[0].exp, .i = i, .j = 0});
+		}
+	}
+
+	Mono *monos = poolMalloc(total * sizeof(Mono));
+	Poly *group = safeMalloc(heapSize * sizeof(Poly));
+	size_t count = 0;
+	while (heapSize > 0)
+	{
+		poly_exp_t exp = heap[0].exp;
+		size_t groupSize = 0;
+		while (heapSize > 0 && heap[0].exp == exp)
+		{
+			MulHeapEntry top = MulHeapPop(heap, &heapSize);
+			group[groupSize++] = ps[top.i].arr[top.j].p;
+			if (++top.j < ps[top.i].size)
+			{
+				top.exp = ps[top.i].arr[top.j].exp;
+				MulHeapPush(heap, &heapSize, top);
+			}
+		}
+
+		sum = groupSize == 1 ? PolyClone(&group[0]) : PolyAddMany(groupSize, group);
+		monos[count++] = (Mono){.p = sum, .exp = exp};
+	}
+	free(group);
+	free(heap);
+
+	Poly result = PolyFromSortedMonos(count, monos);
+	return PolyAddOwn(&result, &constant);
+}
+
+/**
+ * Górna granica wykładników wielomianów płaskich powstających
+ * w podstawieniu Kroneckera. Wykładniki muszą mieścić się w 63 bitach.
+ */
+#define KRONECKER_EXP_LIMIT ((flat_exp_t)1 << 63)
+
+/**
+ * Zwraca liczbę zmiennych wielomianu, czyli głębokość zagnieżdżenia
+ * tablic jednomianów (0 dla współczynnika).
+ * @param[in] p : wielomian
+ * @return liczba zmiennych wielomianu
+ */
+static size_t PolyVarCount(const Poly *p)
+{
+	if (PolyIsCoeff(p))
+		return 0;
+	size_t result = 0, vars;
+	for (size_t i = 0; i < p->size; i++)
+		if ((vars = PolyVarCount(&p->arr[i].p)) > result)
+			result = vars;
+	return result + 1;
+}
+
+/**
+ * Wyznacza w jednym przejściu stopnie niezerowego wielomianu względem
+ * wszystkich jego zmiennych, czyli wartości PolyDegBy(p, i).
+ * Tablica @p degs musi być wcześniej wyzerowana.
+ * @param[in] p : wielomian
+ * @param[in,out] degs : tablica stopni o długości PolyVarCount(p)
+ */
+static void PolyDegBounds(const Poly *p, poly_exp_t degs[])
+{
+	if (PolyIsCoeff(p))
+		return;
+	for (size_t i = 0; i < p->size; i++)
+	{
+		degs[0] = ExpMax(degs[0], p->arr[i].exp);
+		PolyDegBounds(&p->arr[i].p, degs + 1);
+	}
+}
+
+/**
+ * Zwraca liczbę współczynników stałych w drzewie wielomianu.
+ * @param[in] p : wielomian
+ * @return liczba liści drzewa wielomianu
+ */
+static size_t PolyLeafCount(const Poly *p)
+{
+	if (PolyIsCoeff(p))
+		return 1;
+	size_t result = 0;
+	for (size_t i = 0; i < p->size; i++)
+		result += PolyLeafCount(&p->arr[i].p);
+	return result;
+}
+
+/**
+ * Wyznacza największą wartość bezwzględną współczynnika stałego wielomianu.
+ * @param[in] p : wielomian
+ * @return największa wartość bezwzględna współczynnika lub UINT64_MAX,
+ * jeżeli któryś współczynnik jest wielką liczbą
+ */
+static uint64_t PolyMaxAbs(const Poly *p)
+{
+	if (PolyIsBig(p))
+		return UINT64_MAX;
+	if (PolyIsCoeff(p))
+		return p->coeff < 0 ? -(uint64_t)p->coeff : (uint64_t)p->coeff;
+	uint64_t result = 0, value;
+	for (size_t i = 0; i < p->size && result != UINT64_MAX; i++)
+		if ((value = PolyMaxAbs(&p->arr[i].p)) > result)
+			result = value;
+	return result;
+}
+
+/*
+Wyjaśnienie implementacji:
+Przy ustalonym wykładniku płaskim iloczynu każdy wyraz jednego czynnika
+	tworzy go z co najwyżej jednym wyrazem drugiego, więc każdy
+	współczynnik iloczynu, a także każda jego suma częściowa, jest sumą
+	co najwyżej tylu iloczynów współczynników, ile liści ma mniejsze
+	z drzew czynników.
+*/
+/**
+ * Sprawdza w trybie sprawdzanym, czy żaden współczynnik wyniku
+ * @f$p * q + r@f$ ani wyniku pośredniego w postaci płaskiej nie wyjdzie
+ * poza typ poly_coeff_t, więc można go liczyć podstawieniem Kroneckera.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] r : wielomian @f$r@f$ lub NULL, jeśli nie ma składnika
+ * @return czy współczynniki na pewno się zmieszczą?
+ */
+static bool PolyMulFitsFlat(const Poly *p, const Poly *q, const Poly *r)
+{
+	uint64_t maxP = PolyMaxAbs(p), maxQ = PolyMaxAbs(q), maxR = r != NULL ? PolyMaxAbs(r) : 0;
+	if (maxP == UINT64_MAX || maxQ == UINT64_MAX || maxR == UINT64_MAX)
+		return false;
+
+	size_t leavesP = PolyLeafCount(p), leavesQ = PolyLeafCount(q);
+	unsigned __int128 bound;
+	if (__builtin_mul_overflow((unsigned __int128)maxP * maxQ,
+	                           (unsigned __int128)(leavesP < leavesQ ? leavesP : leavesQ), &bound))
+		return false;
+	return bound <= LONG_MAX && maxR <= (uint64_t)LONG_MAX - (uint64_t)bound;
+}
+
+/**
+ * Dopisuje wyrazy wielomianu do wielomianu płaskiego, zamieniając
+ * wykładniki kolejnych zmiennych na jeden wykładnik płaski.
+ * Przechodzenie w porządku preorder daje rosnące wykładniki płaskie.
+ * @param[in] p : wielomian
+ * @param[in] weights : wagi wykładników kolejnych zmiennych
+ * @param[in] exp : wykładnik płaski wyznaczony przez zmienne nadrzędne
+ * @param[in,out] flat : wielomian płaski z wystarczającą pojemnością
+ */
+static void PolyFlatten(const Poly *p, const flat_exp_t weights[],
+                        flat_exp_t exp, FlatPoly *flat)
+{
+	if (PolyIsCoeff(p))
+	{
+		assert(!PolyIsBig(p));
+		if (p->coeff != 0)
+			flat->terms[flat->size++] = (FlatTerm){.exp = exp, .coeff = p->coeff};
+		return;
+	}
+	for (size_t i = 0; i < p->size; i++)
+		PolyFlatten(&p->arr[i].p, weights + 1,
+		            exp + (flat_exp_t)p->arr[i].exp * weights[0], flat);
+}
+
+/**
+ * Odtwarza wielomian z niepustego fragmentu wielomianu płaskiego.
+ * Wyrazy są grupowane po wykładniku bieżącej zmiennej, a współczynnik
+ * każdej grupy jest odtwarzany rekurencyjnie z kolejnych zmiennych.
+ * @param[in] terms : wyrazy wielomianu płaskiego
+ * @param[in] count : niezerowa liczba wyrazów
+ * @param[in] weights : wagi wykładników kolejnych zmiennych
+ * @param[in] bases : zakresy wykładników kolejnych zmiennych
+ * @param[in] vars : liczba pozostałych zmiennych
+ * @return wielomian
+ */
+static Poly PolyUnflatten(const FlatTerm terms[], size_t count,
+                          const flat_exp_t weights[], const flat_exp_t bases[],
+                          size_t vars)
+{
+	assert(count > 0);
+	if (vars == 0)
+	{
+		assert(count == 1);
+		return PolyFromCoeff(terms[0].coeff);
+	}
+
+	size_t groups = 0, capacity = count < bases[0] ? count : bases[0];
+	Mono *monos = poolMalloc(capacity * sizeof(Mono));
+
+	for (size_t begin = 0, end; begin < count; begin = end)
+	{
+		flat_exp_t exp = terms[begin].exp / weights[0] % bases[0];
+		for (end = begin + 1; end < count; end++)
+			if (terms[end].exp / weights[0] % bases[0] != exp)
+				break;
+		monos[groups].p = PolyUnflatten(terms + begin, end - begin,
+		                                weights + 1, bases + 1, vars - 1);
+		monos[groups++].exp = (poly_exp_t)exp;
+	}
+
+	return PolyFromSortedMonos(groups, monos);
+}
+
+/*
+Wyjaśnienie implementacji:
+Podstawienie Kroneckera: jeśli stopień iloczynu względem zmiennej
+	@f$x_i@f$ jest ograniczony przez @f$D_i@f$, to jednomian
+	@f$x_0^{e_0} \cdots x_{k-1}^{e_{k-1}}@f$ zamieniam na @f$y^e@f$, gdzie
+	@f$e = \sum e_i w_i@f$, @f$w_{k-1} = 1@f$, @f$w_i = w_{i+1} (D_{i+1} + 1)@f$.
+	Przy takich wagach iloczyn wielomianów płaskich odpowiada iloczynowi
+	wielomianów wielu zmiennych, a @f$x_0@f$ jest najbardziej znaczącą
+	cyfrą, więc rosnące wykładniki płaskie dają od razu kolejność
+	potrzebną do odtworzenia zagnieżdżonych tablic.
+Ograniczenia @f$D_i@f$ to sumy stopni czynników względem @f$x_i@f$,
+	a jeśli do iloczynu dodawany jest składnik, to większe z tej sumy
+	i stopnia składnika. Podstawienie jest możliwe, gdy iloczyn wszystkich
+	@f$D_i + 1@f$ mieści się w 63 bitach.
+Składnik dodaję do iloczynu jeszcze w postaci płaskiej, więc iloczyn
+	nigdy nie jest odtwarzany jako osobny wielomian.
+W trybie sprawdzanym postać płaska ma tylko współczynniki 64-bitowe,
+	więc korzystam z niej jedynie wtedy, gdy PolyMulFitsFlat gwarantuje,
+	że nic się nie przepełni. W przeciwnym przypadku wynik liczy metoda
+	kopcowa, która promuje duże współczynniki do wielkich liczb.
+*/
+/**
+ * Mnoży dwa wielomiany, z których żaden nie jest współczynnikiem,
+ * sprowadzając je podstawieniem Kroneckera do wielomianów płaskich,
+ * i dodaje do iloczynu opcjonalny składnik.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] r : wielomian @f$r@f$ lub NULL, jeśli nie ma składnika
+ * @param[out] result : @f$p * q + r@f$, jeśli podstawienie było możliwe
+ * @return czy podstawienie było możliwe?
+ */
+static bool PolyMulKronecker(const Poly *p, const Poly *q, const Poly *r, Poly *result)
+{
+	if (CoeffIsChecked() && !PolyMulFitsFlat(p, q, r))
+		return false;
+
+	size_t varsP = PolyVarCount(p), varsQ = PolyVarCount(q);
+	size_t varsR = r != NULL ? PolyVarCount(r) : 0;
+	size_t vars = varsP > varsQ ? varsP : varsQ;
+	vars = vars > varsR ? vars : varsR;
+	poly_exp_t *degs = safeMalloc(3 * vars * sizeof(poly_exp_t));
+	flat_exp_t *weights = safeMalloc(2 * vars * sizeof(flat_exp_t));
+	flat_exp_t *bases = weights + vars;
+	memset(degs, 0, 3 * vars * sizeof(poly_exp_t));
+
+	PolyDegBounds(p, degs);
+	PolyDegBounds(q, degs + vars);
+	if (r != NULL)
+		PolyDegBounds(r, degs + 2 * vars);
+
+	bool fits = true;
+	flat_exp_t range = 1;
+	for (size_t i = vars; i-- > 0 && fits;)
+	{
+		weights[i] = range;
+		bases[i] = (flat_exp_t)degs[i] + (flat_exp_t)degs[vars + i] + 1;
+		if (bases[i] <= (flat_exp_t)degs[2 * vars + i])
+			bases[i] = (flat_exp_t)degs[2 * vars + i] + 1;
+		fits = bases[i] <= (flat_exp_t)POLY_EXP_T_MAX + 1 &&
+		       !__builtin_mul_overflow(range, bases[i], &range) &&
+		       range <= KRONECKER_EXP_LIMIT;
+	}
+	free(degs);
+
+	if (fits)
+	{
+		// Przy podnoszeniu do kwadratu spłaszczam wielomian tylko raz,
+		// dzięki czemu FlatMul może skorzystać z tego, że czynniki są równe.
+		FlatPoly flatP = {.size = 0, .terms = safeMalloc(PolyLeafCount(p) * sizeof(FlatTerm))};
+		FlatPoly flatQ = flatP;
+		PolyFlatten(p, weights, 0, &flatP);
+		if (p != q)
+		{
+			flatQ.terms = safeMalloc(PolyLeafCount(q) * sizeof(FlatTerm));
+			PolyFlatten(q, weights, 0, &flatQ);
+		}
+
+		FlatPoly flatResult = FlatMul(&flatP, p != q ? &flatQ : &flatP);
+		if (r != NULL)
+		{
+			FlatPoly flatR = {.size = 0, .terms = safeMalloc(PolyLeafCount(r) * sizeof(FlatTerm))};
+			PolyFlatten(r, weights, 0, &flatR);
+			FlatPoly sum = FlatAdd(&flatResult, &flatR);
+			FlatDestroy(&flatR);
+			FlatDestroy(&flatResult);
+			flatResult = sum;
+		}
+		*result = flatResult.size == 0 ? PolyZero() :
+		          PolyUnflatten(flatResult.terms, flatResult.size, weights, bases, vars);
+
+		FlatDestroy(&flatP);
+		if (p != q)
+			FlatDestroy(&flatQ);
+		FlatDestroy(&flatResult);
+	}
+
+	free(weights);
+	return fits;
+}
+
+/**
+ * To jest struktura zadania łączącego dwa wielomiany w miejscu pierwszego.
+ */
+typedef struct PolyPairTask
+{
+	Poly *p; ///< pierwszy argument, w którego miejsce trafia wynik
+	Poly *q; ///< drugi argument, po wykonaniu zadania zerowy
+} PolyPairTask;
+
+/**
+ * Dodaje drugi argument zadania do pierwszego, przejmując oba.
+ * @param[in,out] arg : zadanie PolyPairTask
+ */
+static void PolyAddPairRun(void *arg)
+{
+	PolyPairTask *task = arg;
+	Poly sum = PolyAddOwn(task->p, task->q);
+	*task->p = sum;
+}
+
+/**
+ * Mnoży pierwszy argument zadania przez drugi, przejmując oba.
+ * @param[in,out] arg : zadanie PolyPairTask
+ */
+static void PolyMulPairRun(void *arg)
+{
+	PolyPairTask *task = arg;
+	Poly product = PolyMulOwn(task->p, task->q);
+	*task->p = product;
+}
+
+/*
+Wyjaśnienie implementacji:
+Łączę argumenty parami w zrównoważone drzewo: na każdym poziomie wyniki
+	sąsiednich par są niezależne, więc liczą je zadania puli wątków.
+	Dodawanie i mnożenie współczynników są łączne i przemienne
+	we wszystkich trybach arytmetyki, więc kolejność działań nie zmienia
+	wyniku.
+*/
+/**
+ * Łączy wielomiany działaniem zadań PolyPairTask, przejmując je
+ * na własność i rozdzielając działania między wątki puli.
+ * @param[in,out] terms : niepusta tablica argumentów, po wywołaniu zerowych
+ * @param[in] count : liczba argumentów
+ * @param[in] run : funkcja zadania, PolyAddPairRun lub PolyMulPairRun
+ * @return wynik działania na wszystkich argumentach
+ */
+static Poly PolyPairTree(Poly terms[], size_t count, TaskFunction run)
+{
+	PolyPairTask *tasks = safeMalloc(count / 2 * sizeof(PolyPairTask));
+	TaskGroup group = TaskGroupInit();
+	for (size_t step = 1; step < count; step *= 2)
+	{
+		for (size_t i = 0; i + step < count; i += 2 * step)
+		{
+			tasks[i / (2 * step)] = (PolyPairTask){.p = &terms[i], .q = &terms[i + step]};
+			TaskSpawn(&group, run, &tasks[i / (2 * step)]);
+		}
+		TaskWait(&group);
+	}
+	free(tasks);
+
+	Poly result = terms[0];
+	terms[0] = PolyZero();
+	return result;
+}
+
+/**
+ * To jest struktura zadania mnożącego fragment tablicy jednomianów
+ * dłuższego czynnika przez krótszy czynnik.
+ */
+typedef struct PolyMulTask
+{
+	const Poly *a; ///< krótszy czynnik
+	const Poly *b; ///< dłuższy czynnik
+	size_t low; ///< początek fragmentu tablicy dłuższego czynnika
+	size_t high; ///< koniec fragmentu tablicy dłuższego czynnika
+	Poly *result; ///< miejsce na iloczyn częściowy
+} PolyMulTask;
+
+/**
+ * Mnoży fragment tablicy jednomianów dłuższego czynnika przez krótszy
+ * czynnik. Fragment jest widokiem na tablicę czynnika, więc nie wolno
+ * go kopiować ani niszczyć, a jedynie czytać.
+ * @param[in,out] arg : zadanie PolyMulTask
+ */
+static void PolyMulChunkTask(void *arg)
+{
+	PolyMulTask *task = arg;
+	Poly chunk = {.size = task->high - task->low, .arr = task->b->arr + task->low};
+	*task->result = PolyMulHeap(task->a, &chunk);
+}
+
+/*
+Wyjaśnienie implementacji:
+Koszt mnożenia szacuję iloczynem liczby współczynników stałych
+	w drzewach czynników. Jeżeli opłaca się podział, to tablicę
+	jednomianów dłuższego czynnika dzielę na fragmenty, których
+	iloczyny przez krótszy czynnik liczą zadania puli wątków,
+	a potem sumuję iloczyny częściowe w PolyPairTree. Iloczyny
+	współczynników wewnątrz fragmentów przechodzą przez PolyMul,
+	więc duże iloczyny współczynników same stają się zadaniami,
+	które bezczynne wątki mogą podkraść.
+*/
+/**
+ * Mnoży metodą kopcową dwa wielomiany, z których żaden nie jest
+ * współczynnikiem, rozdzielając pracę między wątki puli, jeżeli to się opłaca.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p * q@f$
+ */
+static Poly PolyMulHeapParallel(const Poly *p, const Poly *q)
+{
+	const Poly *a = p->size <= q->size ? p : q;
+	const Poly *b = p->size <= q->size ? q : p;
+	size_t chunks = 1;
+	if (TaskPoolThreads() > 1)
+		chunks = TaskChunkCount(b->size, (uint64_t)PolyLeafCount(a) * PolyLeafCount(b));
+	if (chunks == 1)
+		return PolyMulHeap(a, b);
+
+	PolyMulTask *tasks = safeMalloc(chunks * sizeof(PolyMulTask));
+	Poly *products = safeMalloc(chunks * sizeof(Poly));
+	TaskGroup group = TaskGroupInit();
+	for (size_t i = 0; i < chunks; i++)
+	{
+		tasks[i] = (PolyMulTask){.a = a, .b = b, .low = b->size * i / chunks,
+		                         .high = b->size * (i + 1) / chunks, .result = &products[i]};
+		TaskSpawn(&group, PolyMulChunkTask, &tasks[i]);
+	}
+	TaskWait(&group);
+
+	Poly result = PolyPairTree(products, chunks, PolyAddPairRun);
+	free(tasks);
+	free(products);
+	return result;
+}
+
+/*
+Wyjaśnienie implementacji:
+Jeżeli p i q są współczynnikami, to result jest oczywisty.
+Jeżeli tylko p jest współczynnikiem, to zamiana miejscami.
+Jeżeli tylko q jest współczynnikiem, to tworzę nową tablicę
+	jednomianów, przemnażając każdy przez q. Kolejność wykładników
+	się nie zmienia, więc wystarczy pominąć wyzerowane jednomiany.
+Jeżeli zarówno p jak i q są wielomianami, to mnożę je w postaci
+	płaskiej (PolyMulKronecker), a gdy stopnie są na to za duże,
+	to rekurencyjnie kopcem w PolyMulHeapParallel. Obie ścieżki
+	rozdzielają duże iloczyny między wątki puli.
+*/
+Poly PolyMul(const Poly *p, const Poly *q)
+{
+	assert(p != NULL && q != NULL);
+	Poly result;
+
+	if (PolyIsCoeff(p) && PolyIsCoeff(q))
+	{
+		result = LeafMul(p, q);
+	}
+	else if (PolyIsCoeff(p) && !PolyIsCoeff(q))
+	{
+		result = PolyMul(q, p);
+	}
+	else if (PolyIsZero(q))
+	{
+		result = PolyZero();
+	}
+	else if (PolyIsCoeff(q))
+	{
+		Mono *monos = poolMalloc((p->size) * sizeof(Mono));
+
+		for(size_t i = 0; i < p->size; i++)
+		{
+			monos[i].p = PolyMul(&p->arr[i].p, q);
+			monos[i].exp = p->arr[i].exp;
+		}
+
+		result = PolyFromSortedMonos(p->size, monos);
+	}
+	else if (!PolyMulKronecker(p, q, NULL, &result))
+	{
+		result = PolyMulHeapParallel(p, q);
+	}
+
+	assert(PolyIsSorted(&result));
+	return result;
+}
+
+/*
+Wyjaśnienie implementacji:
+Przy przepełnieniu iloczyn niezerowego współczynnika przez niezerową
+	stałą może wyjść zerowy, a przy stałej równej zeru zerują się
+	wszystkie współczynniki, więc po przemnożeniu współczynników
+	usuwam wyzerowane jednomiany, żeby wynik był poprawnym wielomianem.
+Wielkie liczby nie są modyfikowane, więc współczynnik stały zastępuję
+	iloczynem, zwalniając referencję do poprzedniego.
+*/
+/**
+ * Mnoży wielomian w miejscu przez wielomian stały.
+ * @param[in,out] p : wielomian @f$p@f$
+ * @param[in] c : wielomian stały @f$c@f$
+ */
+static void PolyMulByConstInPlace(Poly *p, const Poly *c)
+{
+	if (PolyIsCoeff(p))
+	{
+		Poly product = LeafMul(p, c);
+		PolyDestroy(p);
+		return (void)(*p = product);
+	}
+	if (PolyIsZero(c))
+	{
+		PolyDestroy(p);
+		return (void)(*p = PolyZero());
+	}
+
+	PolyMakeUnique(p);
+	for (size_t i = 0; i < p->size; i++)
+		PolyMulByConstInPlace(&p->arr[i].p, c);
+	*p = PolyFromSortedMonos(p->size, p->arr);
+	assert(PolyIsSorted(p));
+}
+
+void PolyMulByCoeffInPlace(Poly *p, poly_coeff_t c)
+{
+	Poly constant = PolyFromCoeff(c);
+	PolyMulByConstInPlace(p, &constant);
+}
+
+/*
+Wyjaśnienie implementacji:
+Jeżeli któryś z czynników jest współczynnikiem, to mnożę przez niego
+	drugi czynnik w miejscu. W przeciwnym przypadku tablice czynników
+	i tak nie mogą stać się częścią wyniku, więc wykonuję zwykłe mnożenie.
+*/
+Poly PolyMulOwn(Poly *p, Poly *q)
+{
+	assert(p != NULL && q != NULL);
+	Poly result;
+
+	if (PolyIsCoeff(q))
+	{
+		PolyMulByConstInPlace(p, q);
+		PolyDestroy(q);
+		result = *p;
+	}
+	else if (PolyIsCoeff(p))
+	{
+		PolyMulByConstInPlace(q, p);
+		PolyDestroy(p);
+		result = *q;
+	}
+	else
+	{
+		result = PolyMul(p, q);
+		PolyDestroy(p);
+		PolyDestroy(q);
+	}
+
+	*p = PolyZero();
+	*q = PolyZero();
+	assert(PolyIsSorted(&result));
+	return result;
+}
+
+/*
+Wyjaśnienie implementacji:
+Jeżeli któryś czynnik jest współczynnikiem albo składnik jest zerowy,
+	to iloczyn nie przechodzi przez postać płaską, więc liczę go zwykle
+	i dodaję do niego składnik.
+	W przeciwnym przypadku składnik trafia do PolyMulKronecker i jest
+	dodawany do iloczynu w postaci płaskiej. Gdy podstawienie Kroneckera
+	nie jest możliwe, iloczyn liczę metodą kopcową i dodaję do niego
+	składnik.
+*/
+Poly PolyMulAdd(const Poly *p, const Poly *q, Poly *r)
+{
+	assert(p != NULL && q != NULL && r != NULL);
+	Poly result;
+
+	if (PolyIsCoeff(p) || PolyIsCoeff(q) || PolyIsZero(r) ||
+	    !PolyMulKronecker(p, q, r, &result))
+	{
+		result = PolyMul(p, q);
+		return PolyAddOwn(&result, r);
+	}
+
+	PolyDestroy(r);
+	*r = PolyZero();
+	assert(PolyIsSorted(&result));
+	return result;
+}
+
+/*
+Wyjaśnienie implementacji:
+Mnożenie kolejnych czynników przez rosnący iloczyn sprawia, że każde
+	następne mnożenie ma coraz większy argument. Dlatego mnożę czynniki
+	w zrównoważonym drzewie PolyPairTree: czynniki o podobnych rozmiarach
+	są mnożone ze sobą, a mnożenia w tych samych poddrzewach liczą
+	zadania puli wątków.
+*/
+Poly PolyMulMany(size_t n, const Poly ps[])
+{
+	assert(n == 0 || ps != NULL);
+	if (n == 0)
+		return PolyFromCoeff(1);
+
+	Poly *terms = safeMalloc(n * sizeof(Poly));
+	for (size_t i = 0; i < n; i++)
+		terms[i] = PolyClone(&ps[i]);
+	Poly result = PolyPairTree(terms, n, PolyMulPairRun);
+	free(terms);
+
+	assert(PolyIsSorted(&result));
+	return result;
+}
+
+Poly PolyExp(const Poly *p, poly_exp_t e)
+{
+	Poly multiplier = PolyClone(p);
+	Poly result = PolyFromCoeff(1);
+	Poly temp;
+
+	while(e)
+	{
+		if (e&1)
+		{
+			temp = PolyMul(&result, &multiplier);
+			PolyDestroy(&result);
+			result = temp;
+		}
+		temp = PolyMul(&multiplier, &multiplier);
+		PolyDestroy(&multiplier);
+		multiplier = temp;
+		e /= 2;
+	}
+
+	PolyDestroy(&multiplier);
+	assert(PolyIsSorted(&result));
+	return result;
+}
+
+/*
+Wyjaśnienie implementacji:
+Jeżeli p jest współczynnikiem, to result jest oczywisty.
+W przeciwnym wypadku tworzę płytką kopię tablicy jednomianów
+	i każdy z nich zastępuję jego nowo stworzoną przeciwnością.
+	Stanowi to oczywiście tablicę jednomianów w wielomianie
+	przeciwnym, więc zwracam result.
+*/
+Poly PolyNeg(const Poly *p)
+{
+	assert(p != NULL);
+	if (PolyIsCoeff(p))
+		return LeafNeg(p);
+
+	Poly result;
+	result.size = p->size;
+	result.arr = (Mono*)poolMalloc(p->size * sizeof(Mono));
+	memcpy(result.arr, p->arr, p->size * sizeof(Mono));
+
+	for (size_t i = 0; i < result.size; i++)
+		result.arr[i].p = PolyNeg(&result.arr[i].p);
+
+	assert(PolyIsSorted(&result));
+	return result;
+}
+
+void PolyNegInPlace(Poly *p)
+{
+	assert(p != NULL);
+	if (PolyIsCoeff(p))
+	{
+		Poly neg = LeafNeg(p);
+		PolyDestroy(p);
+		return (void)(*p = neg);
+	}
+
+	PolyMakeUnique(p);
+	for (size_t i = 0; i < p->size; i++)
+		PolyNegInPlace(&p->arr[i].p);
+
+	assert(PolyIsSorted(p));
+}
+
+Poly PolySub(const Poly *p, const Poly *q)
+{
+	Poly qNeg = PolyNeg(q);
+	Poly result = PolyAdd(p, &qNeg);
+	PolyDestroy(&qNeg);
+
+	assert(PolyIsSorted(&result));
+	return result;
+}
+
+Poly PolySubOwn(Poly *p, Poly *q)
+{
+	PolyNegInPlace(q);
+	return PolyAddOwn(p, q);
+}
+
+poly_exp_t PolyDegBy(const Poly *p, size_t var_idx)
+{
+	assert(p != NULL);
+	if (PolyIsZero(p))
+		return -1;
 	poly_exp_t result = 0;
 	if (!PolyIsCoeff(p))
 		for (size_t i = 0; i < p->size; i++)
@@ -525,151 +1693,1019 @@ poly_exp_t PolyDegBy(const Poly *p, size_t var_idx)
 	return result;
 }
 
-poly_exp_t PolyDeg(const Poly *p)
+poly_exp_t PolyDeg(const Poly *p)
+{
+	assert(p != NULL);
+	if (PolyIsZero(p))
+		return -1;
+	poly_exp_t result = 0;
+	if (!PolyIsCoeff(p))
+		for (size_t i = 0; i < p->size; i++)
+			result = ExpMax(result, PolyDeg(&p->arr[i].p) + p->arr[i].exp);
+	return result;
+}
+
+/*
+Wyjaśnienie implementacji:
+Ze względu na to, że każdy wielomian tworzony przez moje
+	funkcje spełnia standard, który zakłada:
+1. Posortowaną malejąco po wykłądnikach tablicę `arr`
+2. Utożsamienie wielomianów, w których wykładnik przy
+	jedynym jednomianie jest zerowy z wielomianem współczynnikowym
+To dwa wielomiany są równe wtedy i tylko wtedy, gdy albo są
+	równymi sobie współczynnikami, albo mają tablice jednomianów
+	tej samej długości i każdy jednomian z p jest równy odpowiedniemu
+	jednomianowi z q ze względu na wykładnik i współczynnik wielomianowy.
+*/
+bool PolyIsEq(const Poly *p, const Poly *q)
+{
+	assert(p != NULL && q != NULL);
+	assert(PolyIsSorted(p));
+	assert(PolyIsSorted(q));
+
+	if (PolyIsCoeff(p) && PolyIsCoeff(q))
+		return p->arr == NULL && q->arr == NULL ? p->coeff == q->coeff : BigIsEq(p, q);
+	if ((PolyIsCoeff(p) ^ PolyIsCoeff(q)) || p->size != q->size)
+		return false;
+	if (p->arr == q->arr)
+		return true;
+	bool result = true;
+	for (size_t i = 0; i < p->size && result; i++)
+	{
+		result &= p->arr[i].exp == q->arr[i].exp;
+		result &= PolyIsEq(&p->arr[i].p, &q->arr[i].p);
+	}
+	return result;
+}
+
+/**
+ * Wylicza wartość wielomianu, którego wszystkie jednomiany mają
+ * współczynniki stałe, schematem Hornera po rzadkiej tablicy wykładników.
+ * @param[in] p : wielomian @f$p@f$, który nie jest współczynnikiem
+ * @param[in] x : wartość argumentu @f$x@f$
+ * @return @f$p(x)@f$
+ */
+static poly_coeff_t CoeffHorner(const Poly *p, poly_coeff_t x)
+{
+	poly_coeff_t result = p->arr[p->size - 1].p.coeff;
+	for (size_t i = p->size - 1; i > 0; i--)
+		result = CoeffAdd(CoeffMulFactor(result, CoeffExpFactor(x, p->arr[i].exp - p->arr[i - 1].exp)),
+		                  p->arr[i - 1].p.coeff);
+	return CoeffMulFactor(result, CoeffExpFactor(x, p->arr[0].exp));
+}
+
+/*
+Wyjaśnienie implementacji:
+Dla x równego zeru liczy się tylko jednomian o zerowym wykładniku,
+	który jest pierwszy w tablicy. Gdy wszystkie współczynniki są stałe,
+	wynik jest liczbą, którą liczę schematem Hornera, podnosząc x tylko
+	do różnic kolejnych wykładników. W trybie sprawdzanym ta liczba
+	mogłaby się przepełnić, więc wtedy korzystam z drogi ogólnej.
+W przeciwnym przypadku wymnażanie wielomianowej sumy częściowej przez
+	kolejne potęgi kosztowałoby tyle, ile cała suma, więc przechodzę
+	wykładniki rosnąco, utrzymując bieżącą potęgę x mnożoną przez
+	potęgi różnic, i dodaję do akumulatora współczynniki przeskalowane
+	w miejscu. Potęga jest wielomianem stałym, więc w trybie sprawdzanym
+	staje się w razie potrzeby wielką liczbą. Gdy potęga wyzeruje się
+	przez przepełnienie, to pozostałe składniki są zerowe i kończę pętlę.
+Współczynniki wielomianu, którego tablica jest przejmowana, są
+	przekazywane do akumulatora bez kopiowania.
+*/
+/**
+ * Wylicza wartość wielomianu, który nie jest współczynnikiem, w punkcie @p x.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] x : wartość argumentu @f$x@f$
+ * @param[in] own : czy przejąć współczynniki z nie współdzielonej tablicy @p p
+ * @return @f$p(x, x_0, x_1, \ldots)@f$
+ */
+static Poly PolyHorner(const Poly *p, poly_coeff_t x, bool own)
+{
+	assert(!PolyIsCoeff(p));
+	assert(!own || poolRefCount(p->arr) == 1);
+
+	if (x == 0)
+	{
+		if (p->arr[0].exp != 0)
+			return PolyZero();
+		if (!own)
+			return PolyClone(&p->arr[0].p);
+		Poly result = p->arr[0].p;
+		p->arr[0].p = PolyZero();
+		return result;
+	}
+
+	bool allCoeffs = !CoeffIsChecked();
+	for (size_t i = 0; i < p->size && allCoeffs; i++)
+		allCoeffs = PolyIsCoeff(&p->arr[i].p);
+	if (allCoeffs)
+		return PolyFromCoeff(CoeffHorner(p, x));
+
+	PolyAcc acc = AccInit();
+	Poly power = LeafExp(x, p->arr[0].exp), step, next;
+	for (size_t i = 0; i < p->size && !PolyIsZero(&power); i++)
+	{
+		if (i > 0)
+		{
+			step = LeafExp(x, p->arr[i].exp - p->arr[i - 1].exp);
+			next = LeafMul(&power, &step);
+			PolyDestroy(&power);
+			PolyDestroy(&step);
+			power = next;
+		}
+		Poly coeffPoly = own ? p->arr[i].p : PolyClone(&p->arr[i].p);
+		if (own)
+			p->arr[i].p = PolyZero();
+		PolyMulByConstInPlace(&coeffPoly, &power);
+		AccAdd(&acc, &coeffPoly);
+	}
+
+	PolyDestroy(&power);
+	return AccFinish(&acc);
+}
+
+Poly PolyAt(const Poly *p, poly_coeff_t x)
+{
+	assert(p != NULL);
+	if (PolyIsCoeff(p))
+		return PolyClone(p);
+
+	return PolyHorner(p, x, false);
+}
+
+/*
+Wyjaśnienie implementacji:
+Działa jak PolyAt, ale przejmuje współczynniki z tablicy p. Pominięte
+	współczynniki, na przykład przy wyzerowanej potędze, zostają
+	w tablicy i niszczę je razem z nią.
+*/
+Poly PolyAtInPlace(Poly *p, poly_coeff_t x)
+{
+	assert(p != NULL);
+	if (PolyIsCoeff(p))
+		return *p;
+
+	PolyMakeUnique(p);
+	Poly result = PolyHorner(p, x, true);
+	PolyDestroy(p);
+
+	return result;
+}
+
+/**
+ * Liczba poziomów wielomianu, których potęgi są zapamiętywane w PolyEval.
+ */
+#define EVAL_CACHE_LEVELS 16
+
+/**
+ * Liczba zapamiętanych potęg na poziom, potęga dwójki.
+ */
+#define EVAL_CACHE_SLOTS 8
+
+/**
+ * To jest struktura zapamiętanej potęgi wartości zmiennej.
+ */
+typedef struct EvalCacheSlot
+{
+	poly_exp_t exp; ///< wykładnik potęgi lub 0 dla pustego miejsca
+	poly_coeff_t power; ///< potęga jako czynnik w rozumieniu CoeffToFactor
+} EvalCacheSlot;
+
+/**
+ * Daje potęgę wartości zmiennej, korzystając z pamięci potęg poziomu.
+ * @param[in,out] slots : pamięć potęg poziomu lub NULL, jeżeli poziom
+ * jej nie ma
+ * @param[in] x : wartość zmiennej poziomu
+ * @param[in] exp : dodatni wykładnik
+ * @return @f$x^{exp}@f$ jako czynnik
+ */
+static inline poly_coeff_t EvalPower(EvalCacheSlot slots[], poly_coeff_t x, poly_exp_t exp)
+{
+	if (slots == NULL)
+		return CoeffExpFactor(x, exp);
+	EvalCacheSlot *slot = &slots[(size_t)exp & (EVAL_CACHE_SLOTS - 1)];
+	if (slot->exp != exp)
+	{
+		slot->exp = exp;
+		slot->power = CoeffExpFactor(x, exp);
+	}
+	return slot->power;
+}
+
+/**
+ * Wylicza wartość liczbową wielomianu, którego zmienna główna jest
+ * zmienną poziomu @p level.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] k : liczba wartości zmiennych od zmiennej poziomu
+ * @param[in] x : tablica wartości zmiennych od zmiennej poziomu
+ * @param[in] level : numer poziomu
+ * @param[in,out] cache : pamięć potęg pierwszych EVAL_CACHE_LEVELS poziomów
+ * @return @f$p(x[0], \cdots, x[k-1], 0, \ldots)@f$
+ */
+static poly_coeff_t PolyEvalLevel(const Poly *p, size_t k, const poly_coeff_t x[], size_t level,
+                                  EvalCacheSlot cache[][EVAL_CACHE_SLOTS])
+{
+	if (PolyIsCoeff(p))
+		return LeafValue(p);
+	if (k == 0 || x[0] == 0)
+		return p->arr[0].exp == 0 ?
+		       PolyEvalLevel(&p->arr[0].p, k == 0 ? 0 : k - 1, x + 1, level + 1, cache) : 0;
+
+	EvalCacheSlot *slots = level < EVAL_CACHE_LEVELS ? cache[level] : NULL;
+	poly_exp_t lastGap = 0;
+	poly_coeff_t lastPower = 0;
+	poly_coeff_t result = PolyEvalLevel(&p->arr[p->size - 1].p, k - 1, x + 1, level + 1, cache);
+	for (size_t i = p->size - 1; i > 0; i--)
+	{
+		poly_exp_t gap = p->arr[i].exp - p->arr[i - 1].exp;
+		if (gap != lastGap)
+		{
+			lastGap = gap;
+			lastPower = EvalPower(slots, x[0], gap);
+		}
+		const Poly *coeff = &p->arr[i - 1].p;
+		result = CoeffAdd(CoeffMulFactor(result, lastPower), PolyIsCoeff(coeff) ? LeafValue(coeff) :
+		                  PolyEvalLevel(coeff, k - 1, x + 1, level + 1, cache));
+	}
+	return p->arr[0].exp == 0 ? result : CoeffMulFactor(result, EvalPower(slots, x[0], p->arr[0].exp));
+}
+
+/*
+Wyjaśnienie implementacji:
+Przechodzę drzewo wielomianu raz, licząc na każdym poziomie schemat
+	Hornera od największego wykładnika, a wartości współczynników
+	rekurencyjnie z kolejnymi zmiennymi. Wszystkie wielomiany jednego
+	poziomu drzewa mają tę samą zmienną, więc dzielą pamięć potęg jej
+	wartości: małą tablicę adresowaną wykładnikiem, trzymaną na stosie
+	tego wywołania, bez alokacji. Potęgowanie odbywa się więc tylko przy
+	pierwszym użyciu danej różnicy wykładników na poziomie. Pamięć mają
+	tylko poziomy, którym podano wartości zmiennych, i co najwyżej
+	EVAL_CACHE_LEVELS pierwszych, a głębsze potęgują przy każdym użyciu.
+	Przy gęstych wielomianach kolejne różnice są zwykle równe, więc ramka
+	trzyma jeszcze w zmiennych lokalnych ostatnio użytą różnicę i jej
+	potęgę, a do pamięci poziomu sięga tylko przy zmianie różnicy.
+Gdy zabraknie wartości zmiennych lub wartość jest zerowa, to liczy się
+	tylko jednomian o zerowym wykładniku, który jest pierwszy w tablicy.
+Wynikiem jest pojedyncza liczba, więc w trybie sprawdzanym wielkie liczby
+	i przepełnienia są zawijane i podnoszą flagę przepełnienia.
+*/
+poly_coeff_t PolyEval(const Poly *p, size_t k, const poly_coeff_t x[])
+{
+	assert(p != NULL);
+	EvalCacheSlot cache[EVAL_CACHE_LEVELS][EVAL_CACHE_SLOTS];
+	size_t levels = k < EVAL_CACHE_LEVELS ? k : EVAL_CACHE_LEVELS;
+	for (size_t i = 0; i < levels; i++)
+		for (size_t j = 0; j < EVAL_CACHE_SLOTS; j++)
+			cache[i][j].exp = 0;
+	return PolyEvalLevel(p, k, x, 0, cache);
+}
+
+/*
+Wyjaśnienie implementacji:
+Schemat jest taki sam jak w PolyEval, ale wartości pośrednie są
+	wielomianami stałymi liczonymi funkcjami Leaf, więc w trybie
+	sprawdzanym nie przepełniają się, tylko stają się wielkimi liczbami.
+	Potęgi mogą być wielkimi liczbami, więc zamiast pamięci potęg poziomu
+	każda ramka trzyma tylko ostatnio użytą różnicę wykładników i jej
+	potęgę.
+*/
+/**
+ * Wylicza dokładną wartość wielomianu w punkcie.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] k : liczba wartości zmiennych
+ * @param[in] x : tablica wartości zmiennych
+ * @return @f$p(x[0], \cdots, x[k-1], 0, \ldots)@f$
+ */
+static Poly PolyEvalLeaf(const Poly *p, size_t k, const poly_coeff_t x[])
+{
+	if (PolyIsCoeff(p))
+		return PolyClone(p);
+	if (k == 0 || x[0] == 0)
+		return p->arr[0].exp == 0 ? PolyEvalLeaf(&p->arr[0].p, k == 0 ? 0 : k - 1, x + 1) : PolyZero();
+
+	poly_exp_t cachedGap = 1;
+	Poly cachedPower = PolyFromCoeff(x[0]);
+	Poly result = PolyEvalLeaf(&p->arr[p->size - 1].p, k - 1, x + 1);
+	for (size_t i = p->size - 1; i > 0; i--)
+	{
+		poly_exp_t gap = p->arr[i].exp - p->arr[i - 1].exp;
+		if (gap != cachedGap)
+		{
+			cachedGap = gap;
+			PolyDestroy(&cachedPower);
+			cachedPower = LeafExp(x[0], gap);
+		}
+		Poly product = LeafMul(&result, &cachedPower);
+		Poly coeff = PolyEvalLeaf(&p->arr[i - 1].p, k - 1, x + 1);
+		PolyDestroy(&result);
+		result = LeafAdd(&product, &coeff);
+		PolyDestroy(&product);
+		PolyDestroy(&coeff);
+	}
+	PolyDestroy(&cachedPower);
+
+	if (p->arr[0].exp == 0)
+		return result;
+	Poly power = LeafExp(x[0], p->arr[0].exp);
+	Poly value = LeafMul(&result, &power);
+	PolyDestroy(&result);
+	PolyDestroy(&power);
+	return value;
+}
+
+Poly PolyEvalExact(const Poly *p, size_t k, const poly_coeff_t x[])
+{
+	assert(p != NULL);
+	if (!CoeffIsChecked())
+		return PolyFromCoeff(PolyEval(p, k, x));
+	return PolyEvalLeaf(p, k, x);
+}
+
+/*
+Wyjaśnienie implementacji:
+Potęgi punktów do różnic kolejnych wykładników liczę raz, w tablicy
+	potęg wspólnej dla wszystkich kroków. Gdy wszystkie współczynniki są
+	stałe, wartości we wszystkich punktach liczy HornerMany do płaskiej
+	tablicy liczb. W przeciwnym przypadku przechodzę tablicę jednomianów
+	raz, trzymając w płaskiej tablicy bieżące potęgi wszystkich punktów,
+	przesuwane przez HornerPowMany o różnice kolejnych wykładników, i dodaję przeskalowane współczynniki
+	do osobnych akumulatorów punktów. Współczynniki są tylko klonowane,
+	więc kosztuje to tyle, co zwiększenie liczników referencji.
+Płaskie tablice liczb nie pomieszczą wielkich liczb, więc w trybie
+	sprawdzanym liczę każdy punkt osobno przez PolyHorner.
+*/
+void PolyAtMany(const Poly *p, size_t n, const poly_coeff_t xs[], Poly out[])
+{
+	assert(p != NULL);
+	if (PolyIsCoeff(p))
+	{
+		for (size_t j = 0; j < n; j++)
+			out[j] = PolyClone(p);
+		return;
+	}
+	if (CoeffIsChecked())
+	{
+		for (size_t j = 0; j < n; j++)
+			out[j] = PolyHorner(p, xs[j], false);
+		return;
+	}
+
+	bool allCoeffs = true;
+	for (size_t i = 0; i < p->size && allCoeffs; i++)
+		allCoeffs = PolyIsCoeff(&p->arr[i].p);
+
+	HornerTable table = HornerTableInit(p->arr, p->size, n, xs);
+	poly_coeff_t *values = safeMalloc(n * sizeof(poly_coeff_t));
+	if (allCoeffs)
+	{
+		HornerMany(&table, p->arr, p->size, values);
+		for (size_t j = 0; j < n; j++)
+			out[j] = PolyFromCoeff(values[j]);
+		HornerTableDestroy(&table);
+		free(values);
+		return;
+	}
+
+	PolyAcc *accs = safeMalloc(n * sizeof(PolyAcc));
+	for (size_t j = 0; j < n; j++)
+	{
+		accs[j] = AccInit();
+		values[j] = 1;
+	}
+
+	for (size_t i = 0; i < p->size; i++)
+	{
+		HornerPowMany(&table, p->arr[i].exp - (i > 0 ? p->arr[i - 1].exp : 0), values);
+		for (size_t j = 0; j < n; j++)
+		{
+			if (values[j] == 0)
+				continue;
+			Poly coeffPoly = PolyClone(&p->arr[i].p);
+			AccAddScaled(&accs[j], &coeffPoly, values[j]);
+		}
+	}
+
+	for (size_t j = 0; j < n; j++)
+	{
+		out[j] = AccFinish(&accs[j]);
+		assert(PolyIsSorted(&out[j]));
+	}
+	HornerTableDestroy(&table);
+	free(accs);
+	free(values);
+}
+
+/**
+ * To jest struktura przechowująca obliczone potęgi wielomianu podstawianego
+ * w złożeniu. Potęgi są jednomianami, których wykładnik jest wykładnikiem
+ * potęgi, a współczynnik jej wartością, posortowanymi rosnąco po wykładnikach.
+ * Wykładniki potrzebne w złożeniu są zbierane przed obliczeniem potęg,
+ * dzięki czemu w trakcie składania tablica jest tylko czytana.
+ */
+typedef struct PowerCache
 {
-	assert(p != NULL);
-	if (PolyIsZero(p))
-		return -1;
-	poly_exp_t result = 0;
-	if (p->arr != NULL)
-		for (size_t i = 0; i < p->size; i++)
-			result = ExpMax(result, PolyDeg(&p->arr[i].p) + p->arr[i].exp);
-	return result;
+	Mono *powers;          ///< tablica obliczonych potęg
+	size_t size;           ///< liczba obliczonych potęg
+	size_t capacity;       ///< pojemność tablicy potęg
+	poly_exp_t *wanted;    ///< wykładniki potrzebnych potęg
+	size_t wantedSize;     ///< liczba wykładników potrzebnych potęg
+	size_t wantedCapacity; ///< pojemność tablicy wykładników
+	size_t leaves;         ///< liczba współczynników stałych podstawianego wielomianu
+} PowerCache;
+
+/**
+ * Tworzy tablicę potęg wielomianu zawierającą jego zerową i pierwszą potęgę.
+ * @param[in] q : wielomian @f$q@f$
+ * @return tablica potęg
+ */
+static PowerCache PowerCacheInit(const Poly *q)
+{
+	PowerCache cache = {.powers = safeMalloc(2 * sizeof(Mono)), .size = 2, .capacity = 2,
+	                    .wanted = NULL, .wantedSize = 0, .wantedCapacity = 0,
+	                    .leaves = PolyLeafCount(q)};
+	cache.powers[0] = (Mono){.p = PolyFromCoeff(1), .exp = 0};
+	cache.powers[1] = (Mono){.p = PolyClone(q), .exp = 1};
+	return cache;
 }
 
-/*
-Wyjaśnienie implementacji:
-Ze względu na to, że każdy wielomian tworzony przez moje
-	funkcje spełnia standard, który zakłada:
-1. Posortowaną malejąco po wykłądnikach tablicę `arr`
-2. Utożsamienie wielomianów, w których wykładnik przy
-	jedynym jednomianie jest zerowy z wielomianem współczynnikowym
-To dwa wielomiany są równe wtedy i tylko wtedy, gdy albo są
-	równymi sobie współczynnikami, albo mają tablice jednomianów
-	tej samej długości i każdy jednomian z p jest równy odpowiedniemu
-	jednomianowi z q ze względu na wykładnik i współczynnik wielomianowy.
-*/
-bool PolyIsEq(const Poly *p, const Poly *q)
+/**
+ * Usuwa z pamięci tablicę potęg wraz z potęgami.
+ * @param[in] cache : tablica potęg
+ */
+static void PowerCacheDestroy(PowerCache *cache)
 {
-	assert(p != NULL && q != NULL);
-	assert(PolyIsSorted(p));
-	assert(PolyIsSorted(q));
+	for (size_t i = 0; i < cache->size; i++)
+		MonoDestroy(&cache->powers[i]);
+	free(cache->powers);
+	free(cache->wanted);
+}
 
-	if (PolyIsCoeff(p) && PolyIsCoeff(q))
-		return p->coeff == q->coeff;
-	if ((PolyIsCoeff(p) ^ PolyIsCoeff(q)) || p->size != q->size)
-		return false;
-	bool result = true;
-	for (size_t i = 0; i < p->size && result; i++)
+/**
+ * Wyszukuje binarnie największą obliczoną potęgę o wykładniku nie większym
+ * od @p e.
+ * @param[in] cache : tablica potęg
+ * @param[in] e : nieujemny wykładnik
+ * @return indeks potęgi w tablicy
+ */
+static size_t PowerCacheSearch(const PowerCache *cache, poly_exp_t e)
+{
+	size_t low = 0, high = cache->size;
+	while (high - low > 1)
 	{
-		result &= p->arr[i].exp == q->arr[i].exp;
-		result &= PolyIsEq(&p->arr[i].p, &q->arr[i].p);
+		size_t mid = low + (high - low) / 2;
+		if (cache->powers[mid].exp <= e)
+			low = mid;
+		else
+			high = mid;
 	}
-	return result;
+	return low;
 }
 
 /*
 Wyjaśnienie implementacji:
-Dla każdego jednomianu tworzę wielomian polyProd równy iloczynowi
-	współczynnika i odpowiedniej potęgi podanej wartości x.
-Dodaję otrzymane polyProd do wielomianu polySum, który stanie
-	się resultiem, jednak muszę pamiętać o zniszczeniu poprzedniego
-	polySum, stąd używam tempPoly.
+Znajduję największą obliczoną potęgę o wykładniku d nie większym
+	od e. Jeżeli d = e, to zwracam ją od razu. Jeżeli d jest co najmniej
+	połową e, to mnożę ją przez potęgę e - d, a w przeciwnym przypadku
+	podnoszę do kwadratu potęgę e / 2 (i dla nieparzystego e mnożę
+	przez pierwszą potęgę). Potrzebne mniejsze potęgi biorę rekurencyjnie
+	z tej samej tablicy, a wynik w niej zapamiętuję.
+Dla rosnących wykładników kosztuje to jedno mnożenie przez potęgę
+	różnicy kolejnych wykładników.
 */
-Poly PolyAt(const Poly *p, poly_coeff_t x)
+/**
+ * Daje potęgę wielomianu, obliczając ją, jeśli nie ma jej jeszcze w tablicy.
+ * @param[in,out] cache : tablica potęg wielomianu @f$q@f$
+ * @param[in] e : wykładnik
+ * @return @f$q^e@f$ współdzielone z tablicą potęg
+ */
+static Poly PowerCacheGet(PowerCache *cache, poly_exp_t e)
 {
-	assert(p != NULL);
-	if (PolyIsCoeff(p))
-		return PolyClone(p);
+	size_t low = PowerCacheSearch(cache, e);
+	if (cache->powers[low].exp == e)
+		return PolyClone(&cache->powers[low].p);
 
-	Poly powerPoly, polyProd, tempPoly, polySum = PolyZero();
-	for (size_t i = 0; i < p->size; i++)
+	poly_exp_t lowerExp = cache->powers[low].exp;
+	Poly factor, other, result;
+	if (e - lowerExp <= lowerExp)
+	{
+		factor = PolyClone(&cache->powers[low].p);
+		other = PowerCacheGet(cache, e - lowerExp);
+		result = PolyMulOwn(&factor, &other);
+	}
+	else
+	{
+		factor = PowerCacheGet(cache, e / 2);
+		result = PolyMul(&factor, &factor);
+		PolyDestroy(&factor);
+		if (e % 2 == 1)
+		{
+			other = PolyClone(&cache->powers[1].p);
+			result = PolyMulOwn(&result, &other);
+		}
+	}
+
+	low = PowerCacheSearch(cache, e) + 1;
+	if (cache->size == cache->capacity)
 	{
-		powerPoly = PolyFromCoeff(CoeffExp(x, p->arr[i].exp));
-		polyProd = PolyMul(&p->arr[i].p, &powerPoly);
-		tempPoly = PolyAdd(&polySum, &polyProd);
-		PolyDestroy(&polyProd);
-		PolyDestroy(&polySum);
-		polySum = tempPoly;
+		cache->capacity *= 2;
+		safeRealloc((void**)&cache->powers, cache->capacity * sizeof(Mono));
 	}
+	memmove(cache->powers + low + 1, cache->powers + low,
+	        (cache->size - low) * sizeof(Mono));
+	cache->powers[low] = (Mono){.p = result, .exp = e};
+	cache->size++;
 
-	assert(PolyIsSorted(&polySum));
-	return polySum;
+	return PolyClone(&result);
 }
 
-Poly PolyAtInPlace(Poly *p, poly_coeff_t x)
+/**
+ * Daje obliczoną wcześniej potęgę wielomianu. Nie modyfikuje tablicy,
+ * więc może być wywoływana jednocześnie przez wiele wątków.
+ * @param[in] cache : tablica potęg wielomianu @f$q@f$ zawierająca @f$q^e@f$
+ * @param[in] e : wykładnik
+ * @return @f$q^e@f$ współdzielone z tablicą potęg
+ */
+static Poly PowerCacheFind(const PowerCache *cache, poly_exp_t e)
 {
-	if (PolyIsCoeff(p))
-		return *p;
+	size_t index = PowerCacheSearch(cache, e);
+	assert(cache->powers[index].exp == e);
+	return PolyClone(&cache->powers[index].p);
+}
 
-	for (size_t i = 0; i < p->size; i++)
-		PolyMulByCoeffInPlace(&p->arr[i].p, CoeffExp(x, p->arr[i].exp));
-	Poly result = p->arr[0].p, polySum;
-	for (size_t i = 1; i < p->size; i++)
+/**
+ * Dopisuje wykładnik do listy potęg potrzebnych w złożeniu.
+ * @param[in,out] cache : tablica potęg
+ * @param[in] e : wykładnik
+ */
+static void PowerCacheWant(PowerCache *cache, poly_exp_t e)
+{
+	if (cache->wantedSize == cache->wantedCapacity)
 	{
-		polySum = PolyAdd(&result, &p->arr[i].p);
-		PolyDestroy(&result);
-		//PolyDestroy(&p->arr[i].p);
-		result = polySum;
+		cache->wantedCapacity = cache->wantedCapacity == 0 ? 16 : 2 * cache->wantedCapacity;
+		safeRealloc((void**)&cache->wanted, cache->wantedCapacity * sizeof(poly_exp_t));
 	}
+	cache->wanted[cache->wantedSize++] = e;
+}
 
-	return result;
+/**
+ * Porównuje wykładniki.
+ * @param[in] a : wskaźnik na pierwszy wykładnik
+ * @param[in] b : wskaźnik na drugi wykładnik
+ * @return znormalizowana różnica wykładników @f$\in\{-1,0,1\}@f$
+ */
+static int ExpCompare(const void *a, const void *b)
+{
+	poly_exp_t expA = *(const poly_exp_t*)a, expB = *(const poly_exp_t*)b;
+	return expA < expB ? -1 : (expA > expB ? 1 : 0);
 }
 
-Poly PolyCompose(const Poly *p, size_t k, const Poly q[])
+/**
+ * Oblicza wszystkie potrzebne potęgi tablicy, w kolejności rosnących wykładników.
+ * @param[in,out] arg : tablica potęg PowerCache
+ */
+static void PowerCacheFillTask(void *arg)
+{
+	PowerCache *cache = arg;
+	qsort(cache->wanted, cache->wantedSize, sizeof(poly_exp_t), ExpCompare);
+	for (size_t i = 0; i < cache->wantedSize; i++)
+	{
+		if (i > 0 && cache->wanted[i] == cache->wanted[i - 1])
+			continue;
+		Poly power = PowerCacheGet(cache, cache->wanted[i]);
+		PolyDestroy(&power);
+	}
+}
+
+/**
+ * Zbiera wykładniki potęg podstawianych wielomianów, których będzie
+ * wymagało złożenie wielomianu.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] k : liczba wielomianów do podstawienia
+ * @param[in,out] caches : tablice potęg kolejnych podstawianych wielomianów
+ */
+static void PolyComposeCollect(const Poly *p, size_t k, PowerCache caches[])
 {
 	if (PolyIsCoeff(p))
-		return *p;
+		return;
 
-	Poly result = PolyZero(), compPoly, expPoly, mulPoly, addPoly;
 	for (size_t i = 0; i < p->size; i++)
 	{
 		if (p->arr[i].exp != 0 && k == 0)
 			break;
+		if (p->arr[i].exp != 0)
+			PowerCacheWant(caches, p->arr[i].exp);
+		PolyComposeCollect(&p->arr[i].p, k == 0 ? 0 : k - 1, k == 0 ? caches : caches + 1);
+	}
+}
 
-		compPoly = PolyCompose(&p->arr[i].p, k == 0 ? 0 : k - 1, q + 1);
+static Poly PolyComposeCached(const Poly *p, size_t k, const PowerCache caches[]);
+
+/**
+ * Składa fragment tablicy jednomianów wielomianu z wielomianami,
+ * których potęgi są w tablicach potęg.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] k : liczba wielomianów do podstawienia
+ * @param[in] caches : tablice potęg kolejnych podstawianych wielomianów
+ * @param[in] low : początek fragmentu tablicy jednomianów
+ * @param[in] high : koniec fragmentu tablicy jednomianów
+ * @return suma złożeń jednomianów fragmentu
+ */
+static Poly PolyComposeRange(const Poly *p, size_t k, const PowerCache caches[],
+                             size_t low, size_t high)
+{
+	PolyAcc acc = AccInit();
+	Poly compPoly, expPoly, mulPoly;
+	for (size_t i = low; i < high; i++)
+	{
+		compPoly = PolyComposeCached(&p->arr[i].p, k == 0 ? 0 : k - 1,
+		                             k == 0 ? caches : caches + 1);
 		if (p->arr[i].exp == 0)
-			expPoly = PolyFromCoeff(1);
-		else
-			expPoly = PolyExp(q, p->arr[i].exp);
-		mulPoly = PolyMul(&compPoly, &expPoly);
-		PolyDestroy(&compPoly);
-		PolyDestroy(&expPoly);
+		{
+			AccAdd(&acc, &compPoly);
+			continue;
+		}
+		expPoly = PowerCacheFind(caches, p->arr[i].exp);
+		mulPoly = PolyMulOwn(&compPoly, &expPoly);
+		AccAdd(&acc, &mulPoly);
+	}
 
-		addPoly = PolyAdd(&result, &mulPoly);
-		PolyDestroy(&result);
-		PolyDestroy(&mulPoly);
-		result = addPoly;
+	return AccFinish(&acc);
+}
+
+/**
+ * To jest struktura zadania składającego fragment tablicy jednomianów.
+ * Pola odpowiadają argumentom funkcji PolyComposeRange.
+ */
+typedef struct PolyComposeTask
+{
+	const Poly *p; ///< składany wielomian
+	size_t k; ///< liczba wielomianów do podstawienia
+	const PowerCache *caches; ///< tablice potęg podstawianych wielomianów
+	size_t low; ///< początek fragmentu tablicy jednomianów
+	size_t high; ///< koniec fragmentu tablicy jednomianów
+	Poly *result; ///< miejsce na wynik
+} PolyComposeTask;
+
+/**
+ * Wykonuje zadanie składania fragmentu tablicy jednomianów.
+ * @param[in,out] arg : zadanie PolyComposeTask
+ */
+static void PolyComposeTaskRun(void *arg)
+{
+	PolyComposeTask *task = arg;
+	*task->result = PolyComposeRange(task->p, task->k, task->caches, task->low, task->high);
+}
+
+/*
+Wyjaśnienie implementacji:
+Gdy zabraknie wielomianów do podstawienia, podstawiam zero, więc
+	liczy się tylko jednomian o zerowym wykładniku, który jest pierwszy
+	w tablicy. Składniki złożenia, czyli złożone rekurencyjnie
+	współczynniki pomnożone przez potęgi q[0], są od siebie niezależne,
+	więc jeżeli opłaca się podział, to fragmenty tablicy jednomianów
+	składają zadania puli wątków, a ich wyniki sumuje PolyPairTree.
+	Koszt szacuję iloczynem liczby współczynników stałych p i q[0].
+Rekurencja we współczynnikach może sama dzielić się na zadania.
+*/
+/**
+ * Składa wielomian z wielomianami, których potęgi są w tablicach potęg.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] k : liczba wielomianów do podstawienia
+ * @param[in] caches : tablice potęg kolejnych podstawianych wielomianów
+ * @return @f$p(q[0], \cdots, q[k-1])@f$
+ */
+static Poly PolyComposeCached(const Poly *p, size_t k, const PowerCache caches[])
+{
+	if (PolyIsCoeff(p))
+		return PolyClone(p);
+
+	size_t count = p->size;
+	if (k == 0)
+		count = p->arr[0].exp == 0 ? 1 : 0;
+
+	size_t chunks = 1;
+	if (TaskPoolThreads() > 1 && count > 1)
+		chunks = TaskChunkCount(count, (uint64_t)PolyLeafCount(p) * caches[0].leaves);
+	if (chunks == 1)
+		return PolyComposeRange(p, k, caches, 0, count);
+
+	PolyComposeTask *tasks = safeMalloc(chunks * sizeof(PolyComposeTask));
+	Poly *terms = safeMalloc(chunks * sizeof(Poly));
+	TaskGroup group = TaskGroupInit();
+	for (size_t i = 0; i < chunks; i++)
+	{
+		tasks[i] = (PolyComposeTask){.p = p, .k = k, .caches = caches,
+		                             .low = count * i / chunks,
+		                             .high = count * (i + 1) / chunks, .result = &terms[i]};
+		TaskSpawn(&group, PolyComposeTaskRun, &tasks[i]);
 	}
+	TaskWait(&group);
 
-	assert(PolyIsSorted(&result));
+	Poly result = PolyPairTree(terms, chunks, PolyAddPairRun);
+	free(tasks);
+	free(terms);
 	return result;
 }
 
-void PolyPrint(const Poly *p)
+/*
+Wyjaśnienie implementacji:
+Tworzę tablicę potęg dla każdego podstawianego wielomianu i zbieram
+	wykładniki, w których będzie on potrzebny. Potęgi różnych
+	wielomianów liczą niezależne zadania puli wątków, a każda potęga
+	jest liczona co najwyżej raz w całym złożeniu. Podczas składania
+	tablice potęg są już tylko czytane, więc mogą je współdzielić
+	zadania składające różne fragmenty wielomianu.
+*/
+Poly PolyCompose(const Poly *p, size_t k, const Poly q[])
 {
 	assert(p != NULL);
+	PowerCache *caches = safeMalloc(k * sizeof(PowerCache));
+	for (size_t i = 0; i < k; i++)
+		caches[i] = PowerCacheInit(&q[i]);
+
+	PolyComposeCollect(p, k, caches);
+	TaskGroup group = TaskGroupInit();
+	for (size_t i = 0; i < k; i++)
+		if (caches[i].wantedSize > 0)
+			TaskSpawn(&group, PowerCacheFillTask, &caches[i]);
+	TaskWait(&group);
+
+	Poly result = PolyComposeCached(p, k, caches);
+
+	for (size_t i = 0; i < k; i++)
+		PowerCacheDestroy(&caches[i]);
+	free(caches);
+
+	assert(PolyIsSorted(&result));
+	return result;
+}
+
+/**
+ * Rozmiar bufora wypisywania wielomianów w bajtach. Bufor leży na stosie
+ * wywołującego, więc nie może być zbyt duży.
+ */
+#define PRINT_BUFFER_SIZE (1 << 14)
+
+/**
+ * Największa liczba bajtów dokładanych do bufora wypisywania naraz.
+ */
+#define PRINT_CHUNK 32
+
+/**
+ * Głębokość wielomianu, do której wypisywanie nie alokuje pamięci.
+ */
+#define PRINT_STACK_SIZE 64
+
+/**
+ * Struktura miejsca, do którego trafia wypisywany wielomian, razem
+ * z buforem wypisywania. Każde wywołanie ma własną strukturę na stosie,
+ * więc wypisywanie jest wielobieżne.
+ */
+typedef struct PrintSink
+{
+	FILE *file; ///< strumień lub NULL, jeżeli wypisujemy do deskryptora
+	int fd; ///< deskryptor pliku, używany, gdy @p file jest równe NULL
+	size_t used; ///< liczba zajętych bajtów bufora
+	bool ok; ///< czy wszystkie zapisy się powiodły?
+	char buffer[PRINT_BUFFER_SIZE]; ///< bufor wypisywania
+} PrintSink;
+
+/**
+ * Przygotowuje miejsce docelowe z pustym buforem. Bufor nie jest
+ * zerowany, bo są z niego czytane tylko zapisane bajty.
+ * @param[out] sink : miejsce docelowe
+ * @param[in] file : strumień lub NULL, jeżeli wypisujemy do deskryptora
+ * @param[in] fd : deskryptor pliku, używany, gdy @p file jest równe NULL
+ */
+static void PrintSinkInit(PrintSink *sink, FILE *file, int fd)
+{
+	sink->file = file;
+	sink->fd = fd;
+	sink->used = 0;
+	sink->ok = true;
+}
+
+/**
+ * Przekazuje zawartość bufora do miejsca docelowego i opróżnia bufor.
+ * @param[in,out] sink : miejsce docelowe
+ */
+static void PrintFlush(PrintSink *sink)
+{
+	if (sink->file != NULL)
+	{
+		if (fwrite(sink->buffer, 1, sink->used, sink->file) != sink->used)
+			sink->ok = false;
+	}
+	else
+	{
+		for (size_t done = 0; done < sink->used;)
+		{
+			ssize_t bytes = write(sink->fd, sink->buffer + done, sink->used - done);
+			if (bytes < 0 && errno == EINTR)
+				continue;
+			if (bytes <= 0)
+			{
+				sink->ok = false;
+				break;
+			}
+			done += (size_t)bytes;
+		}
+	}
+	sink->used = 0;
+}
+
+/**
+ * Zwraca miejsce w buforze na co najwyżej PRINT_CHUNK bajtów.
+ * @param[in,out] sink : miejsce docelowe
+ * @return wskaźnik na wolne miejsce w buforze
+ */
+static char *PrintReserve(PrintSink *sink)
+{
+	if (sink->used + PRINT_CHUNK > PRINT_BUFFER_SIZE)
+		PrintFlush(sink);
+	return sink->buffer + sink->used;
+}
+
+/**
+ * Dokłada do bufora krótki napis.
+ * @param[in,out] sink : miejsce docelowe
+ * @param[in] text : napis
+ * @param[in] length : długość napisu, co najwyżej PRINT_CHUNK
+ */
+static void PrintText(PrintSink *sink, const char *text, size_t length)
+{
+	memcpy(PrintReserve(sink), text, length);
+	sink->used += length;
+}
+
+/**
+ * Dokłada do bufora zapis dziesiętny liczby.
+ * @param[in,out] sink : miejsce docelowe
+ * @param[in] value : liczba
+ */
+static void PrintNumber(PrintSink *sink, long value)
+{
+	char digits[20];
+	size_t count = 0;
+	unsigned long magnitude = value < 0 ? -(unsigned long)value : (unsigned long)value;
+	do
+	{
+		digits[count++] = (char)('0' + magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude != 0);
+
+	char *out = PrintReserve(sink);
+	size_t length = 0;
+	if (value < 0)
+		out[length++] = '-';
+	while (count > 0)
+		out[length++] = digits[--count];
+	sink->used += length;
+}
+
+/**
+ * Dokłada do bufora zapis dziesiętny współczynnika, który może być
+ * wielką liczbą. Długi zapis jest dokładany kawałkami.
+ * @param[in,out] sink : miejsce docelowe
+ * @param[in] c : wielomian stały
+ */
+static void PrintCoeff(PrintSink *sink, const Poly *c)
+{
+	if (!PolyIsBig(c))
+	{
+		PrintNumber(sink, c->coeff);
+		return;
+	}
+
+	size_t length;
+	char *text = BigToString(c, &length);
+	for (size_t done = 0; done < length; done += PRINT_CHUNK)
+		PrintText(sink, text + done, length - done < PRINT_CHUNK ? length - done : PRINT_CHUNK);
+	free(text);
+}
+
+/**
+ * Zamyka bieżący jednomian wielomianu i otwiera następny, jeżeli istnieje.
+ * @param[in,out] sink : miejsce docelowe
+ * @param[in] p : wielomian niebędący współczynnikiem
+ * @param[in,out] i : indeks bieżącego jednomianu
+ */
+static void PrintCloseMono(PrintSink *sink, const Poly *p, size_t *i)
+{
+	PrintText(sink, ",", 1);
+	PrintNumber(sink, p->arr[*i].exp);
+	PrintText(sink, ")", 1);
+	if (++*i < p->size)
+		PrintText(sink, "+(", 2);
+}
+
+/**
+ * Element stosu wypisywania: wielomian i indeks jego bieżącego jednomianu.
+ */
+typedef struct PrintFrame
+{
+	const Poly *p; ///< wypisywany wielomian
+	size_t i; ///< indeks bieżącego jednomianu
+} PrintFrame;
 
+/*
+Wyjaśnienie implementacji:
+Drzewo wielomianu przechodzę bez rekurencji, trzymając na jawnym stosie
+	wielomiany, których jednomiany są właśnie wypisywane. Do głębokości
+	PRINT_STACK_SIZE stos leży na stosie wywołań, więc zwykle nic nie jest
+	alokowane. Tekst trafia do wspólnego bufora, który jest opróżniany
+	dużymi blokami, a liczby zamieniam na zapis dziesiętny ręcznie.
+	Wypisywanie odbywa się tylko w wątku głównym, więc jeden bufor wystarcza.
+*/
+/**
+ * Wypisuje wielomian do bufora miejsca docelowego.
+ * @param[in] p : wielomian
+ * @param[in,out] sink : miejsce docelowe
+ */
+static void PolyPrintTo(const Poly *p, PrintSink *sink)
+{
+	assert(p != NULL);
 	if (PolyIsCoeff(p))
 	{
-		printf("%ld", p->coeff);
+		PrintCoeff(sink, p);
 		return;
 	}
 
-	printf("(");
-	PolyPrint(&p->arr[0].p);
-	printf(",%d)", p->arr[0].exp);
+	PrintFrame local[PRINT_STACK_SIZE], *stack = local;
+	size_t depth = 0, capacity = PRINT_STACK_SIZE;
+	stack[depth++] = (PrintFrame){.p = p, .i = 0};
+	PrintText(sink, "(", 1);
 
-	for (size_t i = 1; i < p->size; i++)
+	while (depth > 0)
 	{
-		printf("+(");
-		PolyPrint(&p->arr[i].p);
-		printf(",%d)", p->arr[i].exp);
+		PrintFrame *top = &stack[depth - 1];
+		if (top->i == top->p->size)
+		{
+			if (--depth > 0)
+				PrintCloseMono(sink, stack[depth - 1].p, &stack[depth - 1].i);
+			continue;
+		}
+
+		const Poly *child = &top->p->arr[top->i].p;
+		if (PolyIsCoeff(child))
+		{
+			PrintCoeff(sink, child);
+			PrintCloseMono(sink, top->p, &top->i);
+			continue;
+		}
+
+		if (depth == capacity)
+		{
+			capacity *= 2;
+			if (stack == local)
+			{
+				stack = safeMalloc(capacity * sizeof(PrintFrame));
+				memcpy(stack, local, depth * sizeof(PrintFrame));
+			}
+			else
+			{
+				safeRealloc((void**)&stack, capacity * sizeof(PrintFrame));
+			}
+		}
+		stack[depth++] = (PrintFrame){.p = child, .i = 0};
+		PrintText(sink, "(", 1);
 	}
+
+	if (stack != local)
+		free(stack);
+}
+
+void PolyPrint(const Poly *p)
+{
+	PrintSink sink;
+	PrintSinkInit(&sink, stdout, -1);
+	PolyPrintTo(p, &sink);
+	PrintFlush(&sink);
 }
 
 void PolyPrintln(const Poly *p)
 {
-	PolyPrint(p);
-	printf("\n");
-}
\ No newline at end of file
+	PrintSink sink;
+	PrintSinkInit(&sink, stdout, -1);
+	PolyPrintTo(p, &sink);
+	PrintText(&sink, "\n", 1);
+	PrintFlush(&sink);
+}
+
+bool PolyPrintFd(const Poly *p, int fd)
+{
+	PrintSink sink;
+	PrintSinkInit(&sink, NULL, fd);
+	PolyPrintTo(p, &sink);
+	PrintFlush(&sink);
+	return sink.ok;
+}
+
+bool PolyPrintlnFd(const Poly *p, int fd)
+{
+	PrintSink sink;
+	PrintSinkInit(&sink, NULL, fd);
+	PolyPrintTo(p, &sink);
+	PrintText(&sink, "\n", 1);
+	PrintFlush(&sink);
+	return sink.ok;
+}
@@ -30,6 +30,8 @@ struct Mono;
  * To jest struktura przechowująca wielomian.
  * Wielomian jest albo liczbą całkowitą, czyli wielomianem stałym
  * (wtedy `arr == NULL`), albo niepustą listą jednomianów (wtedy `arr != NULL`).
+ * Wielomianem stałym jest też wielka liczba, która nie mieści się w typie
+ * poly_coeff_t (wtedy `arr != NULL`, a `size == 0`).
  */
 typedef struct Poly 
 {
@@ -37,7 +39,8 @@ typedef struct Poly
 	 * To jest unia przechowująca współczynnik wielomianu lub
 	 * liczbę jednomianów w wielomianie.
 	 * Jeżeli `arr == NULL`, wtedy jest to współczynnik będący liczbą całkowitą.
-	 * W przeciwnym przypadku jest to niepusta lista jednomianów.
+	 * W przeciwnym przypadku jest to rozmiar niepustej listy jednomianów
+	 * albo 0, gdy `arr` wskazuje na blok wielkiej liczby.
 	 */
 	union 
 	{
@@ -114,20 +117,115 @@ static inline Mono MonoFromPoly(const Poly *p, poly_exp_t n)
 static inline bool PolyIsCoeff(const Poly *p) 
 {
 	assert(p != NULL);
-	return p->arr == NULL;
+	return p->arr == NULL || p->size == 0;
+}
+
+/**
+ * Sprawdza, czy wielomian jest wielką liczbą, czyli współczynnikiem,
+ * który nie mieści się w typie poly_coeff_t.
+ * @param[in] p : wielomian
+ * @return Czy wielomian jest wielką liczbą?
+ */
+static inline bool PolyIsBig(const Poly *p)
+{
+	assert(p != NULL);
+	return p->arr != NULL && p->size == 0;
 }
 
 /**
  * Sprawdza, czy wielomian jest tożsamościowo równy zeru.
+ * Wielka liczba nigdy nie jest zerem.
  * @param[in] p : wielomian
  * @return Czy wielomian jest równy zeru?
  */
 static inline bool PolyIsZero(const Poly *p) 
 {
 	assert(p != NULL);
-	return PolyIsCoeff(p) && p->coeff == 0;
+	return p->arr == NULL && p->coeff == 0;
 }
 
+/**
+ * Wyłączna górna granica modułu arytmetyki współczynników.
+ */
+#define POLY_MODULUS_LIMIT ((poly_coeff_t)1 << 62)
+
+/**
+ * Ustawia tryb arytmetyki współczynników dla wszystkich operacji biblioteki.
+ * Dla @p mod równego 0 współczynniki zawijają się przy przepełnieniu modulo
+ * @f$2^{64}@f$. W przeciwnym przypadku wszystkie działania na współczynnikach
+ * są wykonywane modulo @p mod, a współczynniki są resztami z przedziału
+ * @f$[0, mod)@f$. Współczynniki wielomianów i argumenty przekazywane
+ * do biblioteki muszą wtedy należeć do tego przedziału, do czego służy
+ * funkcja PolyReduce. Moduł nie musi być liczbą pierwszą: dodawanie,
+ * odejmowanie i mnożenie są poprawne dla każdego nieparzystego modułu,
+ * a nieparzystości wymaga jedynie redukcja Montgomery'ego. Trybu nie wolno
+ * zmieniać w trakcie operacji na wielomianach.
+ * @param[in] mod : 0 albo nieparzysty moduł większy niż 1
+ * i mniejszy niż POLY_MODULUS_LIMIT
+ */
+void PolySetModulus(poly_coeff_t mod);
+
+/**
+ * Zwraca moduł arytmetyki współczynników.
+ * @return moduł lub 0, jeżeli współczynniki zawijają się modulo @f$2^{64}@f$
+ */
+poly_coeff_t PolyGetModulus(void);
+
+/**
+ * Włącza lub wyłącza tryb sprawdzany. Gdy moduł jest równy 0, a tryb
+ * sprawdzany jest włączony, współczynniki wielomianów są liczone
+ * dokładnie: współczynnik, który nie mieści się w typie poly_coeff_t,
+ * jest promowany do wielkiej liczby, a wynik, który znów się mieści,
+ * wraca do zwykłej postaci. Flagę sprawdzaną funkcją PolyTakeOverflow
+ * podnoszą tylko działania, których wynikiem jest pojedyncza liczba,
+ * na przykład PolyEval, gdy wynik lub wynik pośredni się nie mieści.
+ * Wielka liczba dłuższa niż BIG_MAX_LIMBS słów jest błędem: działanie
+ * daje wtedy zero w jej miejsce i podnosi flagę sprawdzaną funkcją
+ * PolyTakeTooBig. W trybie modularnym przepełnienia nie występują.
+ * Po wyłączeniu trybu sprawdzanego wielkie liczby trzeba sprowadzić
+ * funkcją PolyReduce. Trybu nie wolno zmieniać w trakcie operacji
+ * na wielomianach.
+ * @param[in] checked : czy liczyć współczynniki dokładnie?
+ */
+void PolySetChecked(bool checked);
+
+/**
+ * Sprawdza, czy wykrywanie przepełnień współczynników jest włączone.
+ * @return czy wykrywać przepełnienia?
+ */
+bool PolyIsChecked(void);
+
+/**
+ * Zwraca flagę przepełnienia współczynników i ją opuszcza.
+ * @return czy od ostatniego wywołania któreś działanie na współczynnikach
+ * się przepełniło?
+ */
+bool PolyTakeOverflow(void);
+
+/**
+ * Zwraca flagę przekroczenia limitu długości wielkiej liczby i ją opuszcza.
+ * @return czy od ostatniego wywołania któryś wynik w trybie sprawdzanym
+ * był dłuższy niż BIG_MAX_LIMBS słów?
+ */
+bool PolyTakeTooBig(void);
+
+/**
+ * Sprowadza współczynniki wielomianu do bieżącego trybu arytmetyki,
+ * przejmując go na własność. Poza trybem sprawdzanym wielkie liczby
+ * są zamieniane na reszty modulo moduł lub zawijane modulo @f$2^{64}@f$.
+ * Jednomiany, których współczynniki wyzerowały się po redukcji, są usuwane. Po wywołaniu w @p p jest wielomian zerowy.
+ * @param[in,out] p : wielomian
+ * @return wielomian o zredukowanych współczynnikach
+ */
+Poly PolyReduce(Poly *p);
+
+/**
+ * Sprawdza, czy któryś współczynnik wielomianu jest wielką liczbą.
+ * @param[in] p : wielomian
+ * @return Czy wielomian ma współczynnik, który nie mieści się w typie poly_coeff_t?
+ */
+bool PolyHasBig(const Poly *p);
+
 /**
  * Usuwa wielomian z pamięci.
  * @param[in] p : wielomian
@@ -145,14 +243,18 @@ static inline void MonoDestroy(Mono *m)
 }
 
 /**
- * Robi pełną, głęboką kopię wielomianu.
+ * Robi kopię wielomianu.
+ * Kopia współdzieli tablicę jednomianów z oryginałem za pomocą licznika
+ * referencji, więc jej wykonanie zajmuje stały czas. Współdzielone
+ * fragmenty są kopiowane dopiero wtedy, gdy któryś z właścicieli
+ * modyfikuje je w miejscu.
  * @param[in] p : wielomian
  * @return skopiowany wielomian
  */
 Poly PolyClone(const Poly *p);
 
 /**
- * Robi pełną, głęboką kopię jednomianu.
+ * Robi kopię jednomianu, współdzieląc jego współczynnik z oryginałem.
  * @param[in] m : jednomian
  * @return skopiowany jednomian
  */
@@ -170,6 +272,26 @@ static inline Mono MonoClone(const Mono *m)
  */
 Poly PolyAdd(const Poly *p, const Poly *q);
 
+/**
+ * Dodaje dwa wielomiany, przejmując je na własność.
+ * Zamiast kopiować jednomiany składników, wykorzystuje ponownie ich
+ * tablice i poddrzewa. Po wywołaniu w @p p i @p q są wielomiany zerowe.
+ * @param[in,out] p : wielomian @f$p@f$
+ * @param[in,out] q : wielomian @f$q@f$
+ * @return @f$p + q@f$
+ */
+Poly PolyAddOwn(Poly *p, Poly *q);
+
+/**
+ * Dodaje @p n wielomianów w jednym przebiegu. Tablice jednomianów
+ * wszystkich składników są scalane naraz za pomocą kopca, zamiast
+ * dodawać kolejne składniki do rosnącej sumy.
+ * @param[in] n : liczba składników
+ * @param[in] ps : tablica składników
+ * @return @f$p_0 + p_1 + \cdots + p_{n-1}@f$
+ */
+Poly PolyAddMany(size_t n, const Poly ps[]);
+
 /**
  * Sumuje listę jednomianów i tworzy z nich wielomian.
  * Przejmuje na własność zawartość tablicy @p monos.
@@ -202,6 +324,65 @@ Poly PolyOwnMonos(size_t count, Mono *monos);
  */
 Poly PolyCloneMonos(size_t count, const Mono monos[]);
 
+/**
+ * Maksymalna liczba posortowanych ciągów w akumulatorze. Długości kolejnych
+ * ciągów maleją więcej niż dwukrotnie, więc tyle wystarcza dla każdego
+ * rozmiaru tablicy mieszczącego się w pamięci.
+ */
+#define ACC_MAX_RUNS 64
+
+/**
+ * To jest struktura akumulatora sumy wielomianów.
+ * Dodawane wielomiany są dopisywane do jednej rosnącej tablicy jednomianów
+ * jako posortowane ciągi, które są scalane w miejscu, dopóki długości
+ * kolejnych ciągów nie maleją więcej niż dwukrotnie. Wynik jest normalizowany
+ * dopiero w funkcji AccFinish, więc suma @f$n@f$ jednomianów kosztuje
+ * @f$O(n \log n)@f$ zamiast przebudowywania całej sumy po każdym kroku.
+ */
+typedef struct PolyAcc
+{
+	Mono *arr;                  ///< tablica jednomianów z puli
+	size_t size;                ///< liczba jednomianów w tablicy
+	size_t capacity;            ///< pojemność tablicy
+	size_t runs[ACC_MAX_RUNS];  ///< początki posortowanych ciągów
+	size_t runCount;            ///< liczba posortowanych ciągów
+	Poly coeff;                 ///< suma dodanych współczynników
+} PolyAcc;
+
+/**
+ * Tworzy pusty akumulator, którego suma jest tożsamościowo równa zeru.
+ * @return akumulator
+ */
+static inline PolyAcc AccInit(void)
+{
+	return (PolyAcc) {.arr = NULL, .size = 0, .capacity = 0, .runCount = 0, .coeff = PolyZero()};
+}
+
+/**
+ * Dodaje wielomian do akumulatora, przejmując go na własność.
+ * Po wywołaniu w @p p jest wielomian zerowy.
+ * @param[in,out] acc : akumulator
+ * @param[in,out] p : wielomian @f$p@f$
+ */
+void AccAdd(PolyAcc *acc, Poly *p);
+
+/**
+ * Dodaje do akumulatora wielomian pomnożony przez stałą, przejmując go
+ * na własność. Po wywołaniu w @p p jest wielomian zerowy.
+ * @param[in,out] acc : akumulator
+ * @param[in,out] p : wielomian @f$p@f$
+ * @param[in] c : stała @f$c@f$
+ */
+void AccAddScaled(PolyAcc *acc, Poly *p, poly_coeff_t c);
+
+/**
+ * Kończy sumowanie i zwraca znormalizowaną sumę dodanych wielomianów.
+ * Akumulator zostaje opróżniony i może być używany ponownie.
+ * @param[in,out] acc : akumulator
+ * @return suma wielomianów dodanych do akumulatora
+ */
+Poly AccFinish(PolyAcc *acc);
+
 /**
  * Mnoży wielomian w miejscu przez stałą.
  * @param[in] p : wielomian @f$p@f$
@@ -217,6 +398,38 @@ void PolyMulByCoeffInPlace(Poly *p, poly_coeff_t c);
  */
 Poly PolyMul(const Poly *p, const Poly *q);
 
+/**
+ * Mnoży dwa wielomiany, przejmując je na własność.
+ * Po wywołaniu w @p p i @p q są wielomiany zerowe.
+ * @param[in,out] p : wielomian @f$p@f$
+ * @param[in,out] q : wielomian @f$q@f$
+ * @return @f$p * q@f$
+ */
+Poly PolyMulOwn(Poly *p, Poly *q);
+
+/**
+ * Mnoży dwa wielomiany i dodaje do iloczynu trzeci, przejmując go na
+ * własność. Składnik jest dodawany do iloczynu jeszcze przed odtworzeniem
+ * wyniku z postaci płaskiej, więc iloczyn nie powstaje jako osobny
+ * wielomian. Po wywołaniu w @p r jest wielomian zerowy.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in,out] r : wielomian @f$r@f$
+ * @return @f$p * q + r@f$
+ */
+Poly PolyMulAdd(const Poly *p, const Poly *q, Poly *r);
+
+/**
+ * Mnoży @p n wielomianów w zrównoważonym drzewie, rozdzielając mnożenia
+ * z różnych poddrzew między wątki puli. Dzięki temu mnożone są ze sobą
+ * czynniki o podobnych rozmiarach, zamiast mnożyć kolejne czynniki przez
+ * rosnący iloczyn.
+ * @param[in] n : liczba czynników
+ * @param[in] ps : tablica czynników
+ * @return @f$p_0 p_1 \cdots p_{n-1}@f$, a dla @f$n = 0@f$ wielomian stały 1
+ */
+Poly PolyMulMany(size_t n, const Poly ps[]);
+
 /**
  * Potęguje wielomian.
  * @param[in] p : wielomian @f$p@f$
@@ -258,6 +471,15 @@ static inline Mono MonoNeg(const Mono *m)
  */
 Poly PolySub(const Poly *p, const Poly *q);
 
+/**
+ * Odejmuje wielomian od wielomianu, przejmując je na własność.
+ * Po wywołaniu w @p p i @p q są wielomiany zerowe.
+ * @param[in,out] p : wielomian @f$p@f$
+ * @param[in,out] q : wielomian @f$q@f$
+ * @return @f$p - q@f$
+ */
+Poly PolySubOwn(Poly *p, Poly *q);
+
 /**
  * Zwraca stopień wielomianu ze względu na zadaną zmienną (-1 dla wielomianu
  * tożsamościowo równego zeru). Zmienne indeksowane są od 0.
@@ -307,6 +529,42 @@ Poly PolyAt(const Poly *p, poly_coeff_t x);
  */
 Poly PolyAtInPlace(Poly *p, poly_coeff_t x);
 
+/**
+ * Wylicza wartości wielomianu w wielu punktach naraz.
+ * Dla każdego @f$j \in \{0,\cdots,n-1\}@f$ wstawia pod pierwszą zmienną
+ * wielomianu wartość @f$xs[j]@f$, tak jak PolyAt, przechodząc tablice
+ * jednomianów tylko raz dla wszystkich punktów.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] n : liczba punktów
+ * @param[in] xs : tablica punktów
+ * @param[out] out : tablica na @p n wielomianów @f$p(xs[j], x_0, x_1, \ldots)@f$
+ */
+void PolyAtMany(const Poly *p, size_t n, const poly_coeff_t xs[], Poly out[]);
+
+/**
+ * Wylicza wartość liczbową wielomianu w punkcie.
+ * Dla każdego @f$i \in \{0,\cdots,k-1\}@f$ wstawia pod zmienną @f$x_i@f$
+ * wartość @f$x[i]@f$, a pod zmienne o większych indeksach zero, tak jak
+ * PolyCompose z wielomianami stałymi. Nie alokuje pamięci.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] k : liczba wartości zmiennych
+ * @param[in] x : tablica wartości zmiennych
+ * @return @f$p(x[0], \cdots, x[k-1], 0, \ldots)@f$
+ */
+poly_coeff_t PolyEval(const Poly *p, size_t k, const poly_coeff_t x[]);
+
+/**
+ * Wylicza wartość wielomianu w punkcie tak jak PolyEval, ale daje ją jako
+ * wielomian stały. W trybie sprawdzanym wartość jest dokładna i w razie
+ * potrzeby jest wielką liczbą, a w pozostałych trybach jest równa
+ * wynikowi PolyEval.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] k : liczba wartości zmiennych
+ * @param[in] x : tablica wartości zmiennych
+ * @return @f$p(x[0], \cdots, x[k-1], 0, \ldots)@f$
+ */
+Poly PolyEvalExact(const Poly *p, size_t k, const poly_coeff_t x[]);
+
 /**
  * Wylicza wartość wielomianu przy podstawieniu wielomianów pod jego zmienne.
  * Dla każdego @f$i \in \{0,\cdots,k-1\}@f$ podstawia wielomian @f$q[i]@f$ pod
@@ -334,4 +592,22 @@ void PolyPrint(const Poly *p);
  */
 void PolyPrintln(const Poly *p);
 
+/**
+ * Wypisuje wielomian @p p do pliku o deskryptorze @p fd z pominięciem
+ * buforów biblioteki standardowej.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] fd : deskryptor pliku otwartego do zapisu
+ * @return czy zapis się powiódł?
+ */
+bool PolyPrintFd(const Poly *p, int fd);
+
+/**
+ * Wypisuje wielomian @p p do pliku o deskryptorze @p fd
+ * z dodatkowym znakiem przejścia do nowego wiersza.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] fd : deskryptor pliku otwartego do zapisu
+ * @return czy zapis się powiódł?
+ */
+bool PolyPrintlnFd(const Poly *p, int fd);
+
 #endif /* __POLY_H__ */
\ No newline at end of file
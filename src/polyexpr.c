@@ -0,0 +1,237 @@
+/** @file
+ * @brief Implementacja leniwych wyrażeń na wielomianach.
+ *
+ * @author Maurycy Wojda
+ * @date 2021
+ */
+
+#include "polyexpr.h"
+#include "safealloc.h"
+#include <stdbool.h>
+#include <string.h>
+
+/**
+ * Wysokość, od której argumenty nowych węzłów są wyliczane od razu.
+ * Dzięki temu rekurencja przy wyliczaniu i zwalnianiu wyrażeń jest płytka,
+ * nawet gdy wyrażenie buduje bardzo długi ciąg poleceń.
+ */
+#define EXPR_HEIGHT_LIMIT 32
+
+PolyExpr *ExprValue(Poly p)
+{
+	PolyExpr *e = safeMalloc(sizeof(PolyExpr));
+	*e = (PolyExpr){.kind = EXPR_VALUE, .refs = 1, .height = 0, .value = p,
+	                .args = NULL, .count = 0, .capacity = 0};
+	return e;
+}
+
+PolyExpr *ExprRetain(PolyExpr *e)
+{
+	e->refs++;
+	return e;
+}
+
+void ExprRelease(PolyExpr *e)
+{
+	if (--e->refs > 0)
+		return;
+	if (e->kind == EXPR_VALUE)
+		PolyDestroy(&e->value);
+	for (size_t i = 0; i < e->count; i++)
+		ExprRelease(e->args[i]);
+	free(e->args);
+	free(e);
+}
+
+static const Poly *ExprForce(PolyExpr *e);
+
+/**
+ * Wylicza argument wyliczanego węzła i zwraca jego wartość. Jeżeli węzeł
+ * nadrzędny ma jedyną referencję do argumentu, to wartość jest z niego
+ * zabierana, dzięki czemu jej tablica nie jest współdzielona.
+ * @param[in] arg : argument
+ * @return wartość argumentu
+ */
+static Poly ExprTakeArg(PolyExpr *arg)
+{
+	ExprForce(arg);
+	if (arg->refs > 1)
+		return PolyClone(&arg->value);
+	Poly value = arg->value;
+	arg->value = PolyZero();
+	return value;
+}
+
+/**
+ * Mnoży wartości argumentów w zrównoważonym drzewie.
+ * @param[in] args : niepusta tablica argumentów
+ * @param[in] count : liczba argumentów
+ * @return iloczyn wartości argumentów
+ */
+static Poly ExprProduct(PolyExpr *args[], size_t count)
+{
+	if (count == 1)
+		return ExprTakeArg(args[0]);
+
+	Poly *factors = safeMalloc(count * sizeof(Poly));
+	for (size_t i = 0; i < count; i++)
+		factors[i] = ExprTakeArg(args[i]);
+	Poly result = PolyMulMany(count, factors);
+	for (size_t i = 0; i < count; i++)
+		PolyDestroy(&factors[i]);
+	free(factors);
+	return result;
+}
+
+/**
+ * Sprawdza, czy argument sumy jest iloczynem, który można policzyć
+ * razem z dodawaniem, bo nikt poza sumą go nie współdzieli.
+ * @param[in] arg : argument sumy
+ * @return wynik
+ */
+static bool ExprFusable(const PolyExpr *arg)
+{
+	return arg->kind == EXPR_PRODUCT && arg->refs == 1;
+}
+
+/*
+Wyjaśnienie implementacji:
+Wartości zwykłych składników trafiają do jednego akumulatora, który scala
+	je wszystkie naraz. Następnie każdy iloczyn, który należy tylko do tej
+	sumy, jest liczony przez PolyMulAdd: wszystkie czynniki oprócz
+	ostatniego mnożę zwykle, a ostatnie mnożenie łączę z dodaniem
+	dotychczasowej sumy.
+*/
+/**
+ * Sumuje wartości argumentów.
+ * @param[in] args : tablica argumentów
+ * @param[in] count : liczba argumentów
+ * @return suma wartości argumentów
+ */
+static Poly ExprSum(PolyExpr *args[], size_t count)
+{
+	PolyAcc acc = AccInit();
+	for (size_t i = 0; i < count; i++)
+	{
+		if (ExprFusable(args[i]))
+			continue;
+		Poly term = ExprTakeArg(args[i]);
+		AccAdd(&acc, &term);
+	}
+	Poly sum = AccFinish(&acc);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!ExprFusable(args[i]))
+			continue;
+		PolyExpr *product = args[i];
+		Poly head = ExprProduct(product->args, product->count - 1);
+		sum = PolyMulAdd(&head, ExprForce(product->args[product->count - 1]), &sum);
+		PolyDestroy(&head);
+	}
+	return sum;
+}
+
+/**
+ * Wylicza wartość węzła i zamienia go w węzeł z wartością.
+ * @param[in,out] e : węzeł
+ * @return wskaźnik na wartość węzła
+ */
+static const Poly *ExprForce(PolyExpr *e)
+{
+	if (e->kind == EXPR_VALUE)
+		return &e->value;
+
+	Poly value = e->kind == EXPR_SUM ? ExprSum(e->args, e->count) :
+	             ExprProduct(e->args, e->count);
+	for (size_t i = 0; i < e->count; i++)
+		ExprRelease(e->args[i]);
+	free(e->args);
+
+	*e = (PolyExpr){.kind = EXPR_VALUE, .refs = e->refs, .height = 0, .value = value,
+	                .args = NULL, .count = 0, .capacity = 0};
+	return &e->value;
+}
+
+/**
+ * Dopisuje argument do węzła sumy lub iloczynu, przejmując referencję.
+ * Argument tego samego rodzaju, którego nikt inny nie współdzieli,
+ * jest rozpakowywany, a jego argumenty trafiają bezpośrednio do węzła.
+ * @param[in,out] e : węzeł
+ * @param[in] arg : argument
+ */
+static void ExprAppend(PolyExpr *e, PolyExpr *arg)
+{
+	bool unpack = arg->kind == e->kind && arg->refs == 1;
+	size_t extra = unpack ? arg->count : 1;
+	if (e->count + extra > e->capacity)
+	{
+		e->capacity = e->capacity == 0 ? DEFAULT_SIZE : 2 * e->capacity;
+		if (e->capacity < e->count + extra)
+			e->capacity = e->count + extra;
+		safeRealloc((void**)&e->args, e->capacity * sizeof(PolyExpr*));
+	}
+
+	if (!unpack)
+	{
+		e->args[e->count++] = arg;
+		e->height = e->height > arg->height + 1 ? e->height : arg->height + 1;
+		return;
+	}
+	memcpy(e->args + e->count, arg->args, arg->count * sizeof(PolyExpr*));
+	e->count += arg->count;
+	e->height = e->height > arg->height ? e->height : arg->height;
+	free(arg->args);
+	free(arg);
+}
+
+/**
+ * Łączy dwa wyrażenia w sumę lub iloczyn, przejmując ich referencje.
+ * Zbyt wysokie wyrażenia są najpierw wyliczane.
+ * @param[in] kind : EXPR_SUM lub EXPR_PRODUCT
+ * @param[in] p : pierwsze wyrażenie
+ * @param[in] q : drugie wyrażenie
+ * @return nowe wyrażenie z jedną referencją
+ */
+static PolyExpr *ExprCombine(ExprKind kind, PolyExpr *p, PolyExpr *q)
+{
+	if (p->height >= EXPR_HEIGHT_LIMIT)
+		ExprForce(p);
+	if (q->height >= EXPR_HEIGHT_LIMIT)
+		ExprForce(q);
+
+	if (p->kind == kind && p->refs == 1)
+	{
+		ExprAppend(p, q);
+		return p;
+	}
+	if (q->kind == kind && q->refs == 1)
+	{
+		ExprAppend(q, p);
+		return q;
+	}
+
+	PolyExpr *e = safeMalloc(sizeof(PolyExpr));
+	*e = (PolyExpr){.kind = kind, .refs = 1, .height = 0, .value = PolyZero(),
+	                .args = NULL, .count = 0, .capacity = 0};
+	ExprAppend(e, p);
+	ExprAppend(e, q);
+	return e;
+}
+
+PolyExpr *ExprAdd(PolyExpr *p, PolyExpr *q)
+{
+	return ExprCombine(EXPR_SUM, p, q);
+}
+
+PolyExpr *ExprMul(PolyExpr *p, PolyExpr *q)
+{
+	return ExprCombine(EXPR_PRODUCT, p, q);
+}
+
+Poly ExprTake(PolyExpr *e)
+{
+	Poly value = ExprTakeArg(e);
+	ExprRelease(e);
+	return value;
+}
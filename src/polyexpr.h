@@ -0,0 +1,90 @@
+/** @file
+ * @brief Interfejs leniwych wyrażeń na wielomianach.
+ *
+ * Wyrażenie to węzeł grafu acyklicznego: wartość, suma lub iloczyn
+ * dowolnej liczby wyrażeń. Węzły są współdzielone za pomocą liczników
+ * referencji, a wartość węzła jest liczona dopiero wtedy, gdy jest
+ * potrzebna, i zapamiętywana. Dodawanie do sumy lub iloczynu, którego
+ * nikt inny nie współdzieli, dopisuje składnik do istniejącego węzła,
+ * więc ciąg dodawań daje jeden węzeł sumy, liczony jednym scalaniem.
+ * Iloczyn będący składnikiem sumy jest liczony razem z dodawaniem
+ * za pomocą PolyMulAdd.
+ *
+ * @author Maurycy Wojda
+ * @date 2021
+ */
+
+#ifndef __POLY_EXPR_H__
+#define __POLY_EXPR_H__
+
+#include "poly.h"
+#include <stddef.h>
+
+/**
+ * To jest typ wyliczeniowy rodzajów węzłów wyrażeń.
+ */
+typedef enum ExprKind
+{
+	EXPR_VALUE,  ///< wyliczona wartość
+	EXPR_SUM,    ///< suma argumentów
+	EXPR_PRODUCT ///< iloczyn argumentów
+} ExprKind;
+
+/**
+ * To jest struktura węzła wyrażenia.
+ */
+typedef struct PolyExpr
+{
+	ExprKind kind; ///< rodzaj węzła
+	size_t refs; ///< liczba referencji
+	size_t height; ///< górne ograniczenie wysokości poddrzewa węzła
+	Poly value; ///< wartość węzła EXPR_VALUE
+	struct PolyExpr **args; ///< argumenty sumy lub iloczynu
+	size_t count; ///< liczba argumentów
+	size_t capacity; ///< liczba argumentów, na które jest zaalokowana pamięć
+} PolyExpr;
+
+/**
+ * Tworzy węzeł z wartością, przejmując wielomian na własność.
+ * @param[in] p : wielomian
+ * @return nowy węzeł z jedną referencją
+ */
+PolyExpr *ExprValue(Poly p);
+
+/**
+ * Dodaje referencję do węzła.
+ * @param[in] e : węzeł
+ * @return @p e
+ */
+PolyExpr *ExprRetain(PolyExpr *e);
+
+/**
+ * Usuwa referencję do węzła i zwalnia go, jeśli była ostatnia.
+ * @param[in] e : węzeł
+ */
+void ExprRelease(PolyExpr *e);
+
+/**
+ * Tworzy wyrażenie będące sumą dwóch wyrażeń, przejmując ich referencje.
+ * @param[in] p : wyrażenie @f$p@f$
+ * @param[in] q : wyrażenie @f$q@f$
+ * @return wyrażenie @f$p + q@f$ z jedną referencją
+ */
+PolyExpr *ExprAdd(PolyExpr *p, PolyExpr *q);
+
+/**
+ * Tworzy wyrażenie będące iloczynem dwóch wyrażeń, przejmując ich referencje.
+ * @param[in] p : wyrażenie @f$p@f$
+ * @param[in] q : wyrażenie @f$q@f$
+ * @return wyrażenie @f$p * q@f$ z jedną referencją
+ */
+PolyExpr *ExprMul(PolyExpr *p, PolyExpr *q);
+
+/**
+ * Wylicza wartość wyrażenia i usuwa referencję do niego.
+ * @param[in] e : wyrażenie
+ * @return wartość wyrażenia
+ */
+Poly ExprTake(PolyExpr *e);
+
+#endif /* __POLY_EXPR_H__ */
@@ -0,0 +1,340 @@
+/** @file
+ * @brief Implementacja wielomianów skompilowanych do programów obliczających ich wartości.
+ *
+ * @author Maurycy Wojda
+ * @date 2021
+ */
+
+#include "polyprog.h"
+#include "coeff.h"
+#include "safealloc.h"
+#include <string.h>
+
+/**
+ * Liczba punktów paczki, dla której interpreter wykonuje naraz każdą instrukcję.
+ */
+#define PROG_BATCH 64
+
+/**
+ * Mnoży wartość przez potęgę w bieżącym trybie arytmetyki współczynników.
+ * Potęgi są czynnikami w rozumieniu CoeffToFactor.
+ * @param[in] a : wartość lub potęga
+ * @param[in] b : potęga
+ * @return @f$a \cdot b@f$
+ */
+static inline uint64_t ProgMul(uint64_t a, uint64_t b)
+{
+	return (uint64_t)CoeffMulFactor((poly_coeff_t)a, (poly_coeff_t)b);
+}
+
+/**
+ * Mnoży wartość przez potęgę i dodaje składnik w bieżącym trybie
+ * arytmetyki współczynników.
+ * @param[in] a : wartość
+ * @param[in] b : potęga
+ * @param[in] c : składnik
+ * @return @f$a \cdot b + c@f$
+ */
+static inline uint64_t ProgMulAdd(uint64_t a, uint64_t b, uint64_t c)
+{
+	return (uint64_t)CoeffAdd(CoeffMulFactor((poly_coeff_t)a, (poly_coeff_t)b), (poly_coeff_t)c);
+}
+
+/**
+ * To jest struktura kompilowanego programu. Dla instrukcji mnożących
+ * przez potęgę tablica @p pending przechowuje zmienną i wykładnik potęgi,
+ * które po kompilacji są zamieniane na indeks w tablicy potęg.
+ */
+typedef struct ProgBuilder
+{
+	PolyProg prog; ///< budowany program
+	size_t capacity; ///< pojemność tablicy instrukcji
+	ProgPower *pending; ///< potęgi kolejnych instrukcji
+	size_t depth; ///< bieżąca głębokość stosu wartości
+} ProgBuilder;
+
+/**
+ * Dopisuje instrukcję do kompilowanego programu.
+ * @param[in,out] builder : kompilowany program
+ * @param[in] op : kod instrukcji
+ * @param[in] var : indeks zmiennej potęgi
+ * @param[in] exp : wykładnik potęgi
+ * @param[in] coeff : stała instrukcji
+ */
+static void ProgEmit(ProgBuilder *builder, ProgOp op, size_t var, poly_exp_t exp,
+                     poly_coeff_t coeff)
+{
+	if (builder->prog.size == builder->capacity)
+	{
+		builder->capacity *= 2;
+		safeRealloc((void**)&builder->prog.code, builder->capacity * sizeof(ProgInstr));
+		safeRealloc((void**)&builder->pending, builder->capacity * sizeof(ProgPower));
+	}
+	builder->pending[builder->prog.size] = (ProgPower){.var = (uint32_t)var, .exp = exp};
+	builder->prog.code[builder->prog.size++] = (ProgInstr){.op = op, .power = 0, .coeff = coeff};
+
+	if (op == PROG_CONST && ++builder->depth > builder->prog.depth)
+		builder->prog.depth = builder->depth;
+	else if (op == PROG_MUL_ADD)
+		builder->depth--;
+}
+
+/**
+ * Daje stałą programu dla współczynnika wielomianu.
+ * @param[in] p : wielomian stały
+ * @return wartość @p p zawinięta modulo @f$2^{64}@f$
+ */
+static inline poly_coeff_t ProgCoeff(const Poly *p)
+{
+	return PolyIsBig(p) ? BigWrap(p) : p->coeff;
+}
+
+/*
+Wyjaśnienie implementacji:
+Poziom wielomianu kompiluję do schematu Hornera od największego
+	wykładnika: kod współczynnika jednomianu zostawia jego wartość na stosie,
+	a instrukcja PROG_MUL_ADD mnoży sumę częściową przez potęgę różnicy
+	wykładników i dodaje do niej tę wartość. Stałe współczynniki są
+	wtapiane w instrukcję PROG_MUL_ADD_C, więc poziom o stałych
+	współczynnikach jest ciągiem instrukcji bez użycia stosu.
+*/
+/**
+ * Kompiluje wielomian, którego zmienna główna ma indeks @p var.
+ * @param[in,out] builder : kompilowany program
+ * @param[in] p : wielomian
+ * @param[in] var : indeks zmiennej głównej wielomianu
+ */
+static void ProgCompileLevel(ProgBuilder *builder, const Poly *p, size_t var)
+{
+	if (PolyIsCoeff(p))
+		return ProgEmit(builder, PROG_CONST, 0, 0, ProgCoeff(p));
+
+	if (builder->prog.vars < var + 1)
+		builder->prog.vars = var + 1;
+
+	ProgCompileLevel(builder, &p->arr[p->size - 1].p, var + 1);
+	for (size_t i = p->size - 1; i > 0; i--)
+	{
+		poly_exp_t gap = p->arr[i].exp - p->arr[i - 1].exp;
+		const Poly *coeff = &p->arr[i - 1].p;
+		if (PolyIsCoeff(coeff))
+		{
+			ProgEmit(builder, PROG_MUL_ADD_C, var, gap, ProgCoeff(coeff));
+		}
+		else
+		{
+			ProgCompileLevel(builder, coeff, var + 1);
+			ProgEmit(builder, PROG_MUL_ADD, var, gap, 0);
+		}
+	}
+	if (p->arr[0].exp != 0)
+		ProgEmit(builder, PROG_MUL_POW, var, p->arr[0].exp, 0);
+}
+
+/**
+ * Porównuje potęgi zmiennych najpierw po zmiennych, a potem po wykładnikach.
+ * @param[in] a : wskaźnik na pierwszą potęgę
+ * @param[in] b : wskaźnik na drugą potęgę
+ * @return znormalizowana różnica potęg @f$\in\{-1,0,1\}@f$
+ */
+static int ProgPowerCompare(const void *a, const void *b)
+{
+	const ProgPower *powA = a, *powB = b;
+	if (powA->var != powB->var)
+		return powA->var < powB->var ? -1 : 1;
+	return powA->exp < powB->exp ? -1 : (powA->exp > powB->exp ? 1 : 0);
+}
+
+/*
+Wyjaśnienie implementacji:
+Po wygenerowaniu instrukcji zbieram potęgi wszystkich instrukcji
+	mnożących, sortuję je i usuwam powtórzenia, a każdej instrukcji
+	przypisuję indeks jej potęgi wyszukany binarnie. Dzięki temu każda
+	potęga jest liczona w interpreterze raz na punkt.
+*/
+PolyProg ProgCompile(const Poly *p)
+{
+	assert(p != NULL);
+	ProgBuilder builder = {.prog = {.code = safeMalloc(DEFAULT_SIZE * sizeof(ProgInstr)),
+	                                .size = 0, .powers = NULL, .powerCount = 0,
+	                                .vars = 0, .depth = 0},
+	                       .capacity = DEFAULT_SIZE,
+	                       .pending = safeMalloc(DEFAULT_SIZE * sizeof(ProgPower)),
+	                       .depth = 0};
+	ProgCompileLevel(&builder, p, 0);
+	PolyProg prog = builder.prog;
+
+	ProgPower *powers = safeMalloc(prog.size * sizeof(ProgPower));
+	for (size_t i = 0; i < prog.size; i++)
+		if (prog.code[i].op != PROG_CONST)
+			powers[prog.powerCount++] = builder.pending[i];
+	qsort(powers, prog.powerCount, sizeof(ProgPower), ProgPowerCompare);
+
+	size_t unique = 0;
+	for (size_t i = 0; i < prog.powerCount; i++)
+		if (unique == 0 || ProgPowerCompare(&powers[unique - 1], &powers[i]) != 0)
+			powers[unique++] = powers[i];
+	prog.powerCount = unique;
+	safeRealloc((void**)&powers, (unique > 0 ? unique : 1) * sizeof(ProgPower));
+	prog.powers = powers;
+
+	for (size_t i = 0; i < prog.size; i++)
+	{
+		if (prog.code[i].op == PROG_CONST)
+			continue;
+		ProgPower *found = bsearch(&builder.pending[i], powers, unique,
+		                           sizeof(ProgPower), ProgPowerCompare);
+		prog.code[i].power = (uint32_t)(found - powers);
+	}
+
+	safeRealloc((void**)&prog.code, prog.size * sizeof(ProgInstr));
+	free(builder.pending);
+	return prog;
+}
+
+/*
+Wyjaśnienie implementacji:
+Potęgi są posortowane po zmiennych i wykładnikach, więc kolejną potęgę
+	zmiennej liczę z poprzedniej, mnożąc ją przez potęgę różnicy
+	wykładników. Potęgowanie przez podnoszenie do kwadratu ma wspólny
+	dla paczki wykładnik, więc pętle po punktach nie mają rozgałęzień.
+Potęgi są czynnikami, więc w trybie modularnym są w postaci
+	Montgomery'ego i każde mnożenie programu kosztuje jedną redukcję.
+	Wartości zmiennych zamieniam na czynniki przy przepisywaniu do paczki.
+*/
+/**
+ * Wylicza tablicę potęg programu dla paczki punktów.
+ * @param[in] prog : program
+ * @param[in] m : liczba punktów paczki
+ * @param[in] xs : wartości zmiennych paczki, zmienna po zmiennej
+ * @param[out] table : tablica na potęgi paczki, potęga po potędze
+ * @param[out] base : tablica pomocnicza na @p m liczb
+ */
+static void ProgPowers(const PolyProg *prog, size_t m, const uint64_t xs[],
+                       uint64_t table[], uint64_t base[])
+{
+	uint64_t one = (uint64_t)CoeffToFactor(1);
+	for (size_t i = 0; i < prog->powerCount; i++)
+	{
+		const ProgPower *power = &prog->powers[i];
+		uint64_t *out = table + i * PROG_BATCH;
+		poly_exp_t e = power->exp;
+		bool chained = i > 0 && prog->powers[i - 1].var == power->var;
+		if (chained)
+			e -= prog->powers[i - 1].exp;
+
+		memcpy(base, xs + power->var * PROG_BATCH, m * sizeof(uint64_t));
+		for (size_t j = 0; j < m; j++)
+			out[j] = one;
+		for (; e; e /= 2)
+		{
+			if (e&1)
+				for (size_t j = 0; j < m; j++)
+					out[j] = ProgMul(out[j], base[j]);
+			if (e > 1)
+				for (size_t j = 0; j < m; j++)
+					base[j] = ProgMul(base[j], base[j]);
+		}
+
+		if (chained)
+			for (size_t j = 0; j < m; j++)
+				out[j] = ProgMul(out[j], out[j - PROG_BATCH]);
+	}
+}
+
+/**
+ * Wykonuje instrukcje programu dla paczki punktów.
+ * @param[in] prog : program
+ * @param[in] m : liczba punktów paczki
+ * @param[in] table : tablica potęg paczki
+ * @param[out] stack : stos wartości o głębokości programu
+ */
+static void ProgRun(const PolyProg *prog, size_t m, const uint64_t table[], uint64_t stack[])
+{
+	uint64_t *top = stack - PROG_BATCH;
+	for (size_t i = 0; i < prog->size; i++)
+	{
+		const ProgInstr *instr = &prog->code[i];
+		const uint64_t *power = table + instr->power * PROG_BATCH;
+		uint64_t coeff = (uint64_t)instr->coeff;
+		switch (instr->op)
+		{
+			case PROG_CONST:
+				top += PROG_BATCH;
+				for (size_t j = 0; j < m; j++)
+					top[j] = coeff;
+				break;
+			case PROG_MUL_POW:
+				for (size_t j = 0; j < m; j++)
+					top[j] = ProgMul(top[j], power[j]);
+				break;
+			case PROG_MUL_ADD_C:
+				for (size_t j = 0; j < m; j++)
+					top[j] = ProgMulAdd(top[j], power[j], coeff);
+				break;
+			case PROG_MUL_ADD:
+				for (size_t j = 0; j < m; j++)
+					top[j - PROG_BATCH] = ProgMulAdd(top[j - PROG_BATCH], power[j], top[j]);
+				top -= PROG_BATCH;
+				break;
+		}
+	}
+}
+
+/*
+Wyjaśnienie implementacji:
+Punkty przetwarzam paczkami po PROG_BATCH. Wartości zmiennych paczki
+	przepisuję do tablicy ułożonej zmienna po zmiennej, a potęgi i stos
+	wartości trzymam w ten sam sposób, dzięki czemu każda instrukcja
+	jest pętlą po ciągłych tablicach.
+*/
+void ProgEvalMany(const PolyProg *prog, size_t n, const poly_coeff_t xs[],
+                  poly_coeff_t values[])
+{
+	assert(prog != NULL);
+	size_t vars = prog->vars;
+	uint64_t *buffer = safeMalloc((vars + prog->powerCount + prog->depth + 1) *
+	                              PROG_BATCH * sizeof(uint64_t));
+	uint64_t *columns = buffer, *table = columns + vars * PROG_BATCH;
+	uint64_t *stack = table + prog->powerCount * PROG_BATCH;
+	uint64_t *base = stack + prog->depth * PROG_BATCH;
+
+	for (size_t first = 0; first < n; first += PROG_BATCH)
+	{
+		size_t m = n - first < PROG_BATCH ? n - first : PROG_BATCH;
+		for (size_t j = 0; j < m; j++)
+			for (size_t v = 0; v < vars; v++)
+				columns[v * PROG_BATCH + j] = (uint64_t)CoeffToFactor(xs[(first + j) * vars + v]);
+
+		ProgPowers(prog, m, columns, table, base);
+		ProgRun(prog, m, table, stack);
+		for (size_t j = 0; j < m; j++)
+			values[first + j] = (poly_coeff_t)stack[j];
+	}
+
+	free(buffer);
+}
+
+poly_coeff_t ProgEval(const PolyProg *prog, size_t k, const poly_coeff_t x[])
+{
+	assert(prog != NULL);
+	poly_coeff_t *point = safeMalloc((prog->vars + 1) * sizeof(poly_coeff_t));
+	for (size_t v = 0; v < prog->vars; v++)
+		point[v] = v < k ? x[v] : 0;
+
+	poly_coeff_t result;
+	ProgEvalMany(prog, 1, point, &result);
+	free(point);
+	return result;
+}
+
+void ProgDestroy(PolyProg *prog)
+{
+	if (prog != NULL)
+	{
+		free(prog->code);
+		free(prog->powers);
+		prog->code = NULL;
+		prog->powers = NULL;
+	}
+}
@@ -0,0 +1,104 @@
+/** @file
+ * @brief Interfejs wielomianów skompilowanych do programów obliczających ich wartości.
+ *
+ * Program wielomianu to płaska tablica instrukcji schematu Hornera dla
+ * kolejnych poziomów wielomianu oraz tablica potęg zmiennych, które są
+ * w nim potrzebne. Każda potęga jest liczona raz na punkt, niezależnie
+ * od tego, ile razy występuje w programie. Interpreter wykonuje każdą
+ * instrukcję naraz dla całej paczki punktów, więc jego wewnętrzne pętle
+ * mogą być wektoryzowane przez kompilator. Arytmetyka współczynników
+ * jest prowadzona w bieżącym trybie, tak jak w PolyAt i PolyEval.
+ *
+ * @author Maurycy Wojda
+ * @date 2021
+ */
+
+#ifndef __POLY_PROG_H__
+#define __POLY_PROG_H__
+
+#include "poly.h"
+#include <stdint.h>
+
+/**
+ * To jest typ wyliczeniowy kodów instrukcji programu wielomianu.
+ */
+typedef enum ProgOp
+{
+	PROG_CONST,      ///< wkłada na stos stałą
+	PROG_MUL_POW,    ///< mnoży wierzch stosu przez potęgę
+	PROG_MUL_ADD_C,  ///< mnoży wierzch stosu przez potęgę i dodaje stałą
+	PROG_MUL_ADD     ///< zdejmuje wartość, a nowy wierzch mnoży przez potęgę i dodaje do niego tę wartość
+} ProgOp;
+
+/**
+ * To jest struktura instrukcji programu wielomianu.
+ */
+typedef struct ProgInstr
+{
+	ProgOp op; ///< kod instrukcji
+	uint32_t power; ///< indeks potęgi w tablicy potęg programu
+	poly_coeff_t coeff; ///< stała instrukcji
+} ProgInstr;
+
+/**
+ * To jest struktura potęgi zmiennej potrzebnej w programie.
+ */
+typedef struct ProgPower
+{
+	uint32_t var; ///< indeks zmiennej
+	poly_exp_t exp; ///< dodatni wykładnik
+} ProgPower;
+
+/**
+ * To jest struktura wielomianu skompilowanego do programu.
+ */
+typedef struct PolyProg
+{
+	ProgInstr *code; ///< tablica instrukcji
+	size_t size; ///< liczba instrukcji
+	ProgPower *powers; ///< tablica potęg zmiennych posortowana po zmiennych i wykładnikach
+	size_t powerCount; ///< liczba potęg
+	size_t vars; ///< liczba zmiennych wielomianu
+	size_t depth; ///< największa głębokość stosu wartości
+} PolyProg;
+
+/**
+ * Kompiluje wielomian do programu obliczającego jego wartości.
+ * Program nie zależy od wielomianu, który może zostać potem zniszczony.
+ * Program liczy na liczbach 64-bitowych, więc wielkie liczby we
+ * współczynnikach są zawijane modulo @f$2^{64}@f$. Dokładne wartości
+ * w trybie sprawdzanym liczy PolyEvalExact z samego wielomianu.
+ * @param[in] p : wielomian @f$p@f$
+ * @return program wielomianu @p p
+ */
+PolyProg ProgCompile(const Poly *p);
+
+/**
+ * Wylicza wartości skompilowanego wielomianu w @p n punktach.
+ * Każdy punkt to @c prog->vars kolejnych wartości zmiennych
+ * @f$x_0, x_1, \ldots@f$ w tablicy @p xs.
+ * @param[in] prog : program wielomianu @f$p@f$
+ * @param[in] n : liczba punktów
+ * @param[in] xs : tablica @f$n \cdot@f$ @c prog->vars wartości zmiennych
+ * @param[out] values : tablica na @p n wartości wielomianu
+ */
+void ProgEvalMany(const PolyProg *prog, size_t n, const poly_coeff_t xs[],
+                  poly_coeff_t values[]);
+
+/**
+ * Wylicza wartość skompilowanego wielomianu w punkcie, tak jak PolyEval.
+ * Pod zmienne o indeksach nie mniejszych niż @p k podstawia zero.
+ * @param[in] prog : program wielomianu @f$p@f$
+ * @param[in] k : liczba wartości zmiennych
+ * @param[in] x : tablica wartości zmiennych
+ * @return @f$p(x[0], \cdots, x[k-1], 0, \ldots)@f$
+ */
+poly_coeff_t ProgEval(const PolyProg *prog, size_t k, const poly_coeff_t x[]);
+
+/**
+ * Usuwa program z pamięci.
+ * @param[in] prog : program
+ */
+void ProgDestroy(PolyProg *prog);
+
+#endif /* __POLY_PROG_H__ */
@@ -0,0 +1,280 @@
+/** @file
+ * @brief Implementacja skryptów kalkulatora skompilowanych do kodu bajtowego.
+ *
+ * @author Maurycy Wojda
+ * @date 2021
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "polyscript.h"
+#include "byteorder.h"
+#include "safealloc.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Znacznik na początku pliku skryptu.
+ */
+#define SCRIPT_MAGIC "POLYCODE"
+
+/**
+ * Długość znacznika skryptu.
+ */
+#define SCRIPT_MAGIC_LENGTH 8
+
+/**
+ * Wersja formatu skryptu.
+ */
+#define SCRIPT_VERSION 3
+
+/**
+ * Rozmiar nagłówka skryptu w bajtach.
+ */
+#define SCRIPT_HEADER_SIZE 56
+
+/**
+ * Rozmiar zapisanej instrukcji w bajtach.
+ */
+#define SCRIPT_INSTR_SIZE 48
+
+PolyScript ScriptInit(void)
+{
+	return (PolyScript){.code = NULL, .size = 0, .capacity = 0, .literals = PSInit(),
+	                    .coeffs = NULL, .coeffCount = 0, .coeffCapacity = 0,
+	                    .text = NULL, .textSize = 0, .textCapacity = 0};
+}
+
+/**
+ * Zapewnia, że w tablicy zmieści się jeszcze @p extra elementów.
+ * @param[in,out] array : wskaźnik na tablicę
+ * @param[in,out] capacity : liczba elementów, na które jest zaalokowana pamięć
+ * @param[in] size : liczba zajętych elementów
+ * @param[in] extra : liczba dopisywanych elementów
+ * @param[in] elemSize : rozmiar elementu w bajtach
+ */
+static void ScriptReserve(void **array, size_t *capacity, size_t size,
+                          size_t extra, size_t elemSize)
+{
+	if (size + extra <= *capacity)
+		return;
+	*capacity = *capacity == 0 ? DEFAULT_SIZE : 2 * *capacity;
+	if (*capacity < size + extra)
+		*capacity = size + extra;
+	safeRealloc(array, *capacity * elemSize);
+}
+
+void ScriptAppend(PolyScript *script, ScriptInstr instr)
+{
+	ScriptReserve((void**)&script->code, &script->capacity, script->size, 1, sizeof(ScriptInstr));
+	script->code[script->size++] = instr;
+}
+
+size_t ScriptAddLiteral(PolyScript *script, Poly p)
+{
+	PSPush(&script->literals, p);
+	return script->literals.elems - 1;
+}
+
+size_t ScriptAddCoeffs(PolyScript *script, const poly_coeff_t coeffs[], size_t count)
+{
+	ScriptReserve((void**)&script->coeffs, &script->coeffCapacity, script->coeffCount,
+	              count, sizeof(poly_coeff_t));
+	memcpy(script->coeffs + script->coeffCount, coeffs, count * sizeof(poly_coeff_t));
+	script->coeffCount += count;
+	return script->coeffCount - count;
+}
+
+size_t ScriptAddText(PolyScript *script, const char *text, size_t length)
+{
+	ScriptReserve((void**)&script->text, &script->textCapacity, script->textSize,
+	              length + 1, sizeof(char));
+	memcpy(script->text + script->textSize, text, length);
+	script->text[script->textSize + length] = '\0';
+	script->textSize += length + 1;
+	return script->textSize - length - 1;
+}
+
+/*
+Wyjaśnienie implementacji:
+Argumenty poleceń są liczbami całkowitymi z zakresu od @f$-2^{63}@f$
+	do @f$2^{64} - 1@f$, więc zapisuję osobno wartość bezwzględną i znak,
+	co odtwarza je dokładnie bez zależności od formatu typu long double.
+*/
+/**
+ * Zapisuje instrukcję skryptu.
+ * @param[out] out : bufor na SCRIPT_INSTR_SIZE bajtów
+ * @param[in] instr : instrukcja
+ */
+static void StoreInstr(unsigned char *out, const ScriptInstr *instr)
+{
+	bool negative = instr->arg < 0;
+	StoreLE32(out, instr->op);
+	StoreLE32(out + 4, instr->error);
+	StoreLE64(out + 8, instr->line);
+	StoreLE64(out + 16, (uint64_t)(negative ? -instr->arg : instr->arg));
+	StoreLE32(out + 24, negative);
+	StoreLE32(out + 28, 0);
+	StoreLE64(out + 32, instr->data);
+	StoreLE64(out + 40, instr->count);
+}
+
+/**
+ * Odczytuje instrukcję skryptu.
+ * @param[in] in : SCRIPT_INSTR_SIZE bajtów instrukcji
+ * @return : instrukcja
+ */
+static ScriptInstr LoadInstr(const unsigned char *in)
+{
+	long double magnitude = (long double)LoadLE64(in + 16);
+	return (ScriptInstr){.op = LoadLE32(in), .error = LoadLE32(in + 4),
+	                     .line = LoadLE64(in + 8),
+	                     .arg = LoadLE32(in + 24) != 0 ? -magnitude : magnitude,
+	                     .data = LoadLE64(in + 32), .count = LoadLE64(in + 40)};
+}
+
+bool ScriptSave(PolyScript *script, const char *path, uint64_t key,
+                const char *source, size_t sourceLength)
+{
+	FILE *file = fopen(path, "wb");
+	if (file == NULL)
+		return false;
+
+	unsigned char record[SCRIPT_HEADER_SIZE];
+	memcpy(record, SCRIPT_MAGIC, SCRIPT_MAGIC_LENGTH);
+	StoreLE32(record + 8, SCRIPT_VERSION);
+	StoreLE32(record + 12, 0);
+	StoreLE64(record + 16, key);
+	StoreLE64(record + 24, script->size);
+	StoreLE64(record + 32, script->coeffCount);
+	StoreLE64(record + 40, script->textSize);
+	StoreLE64(record + 48, sourceLength);
+	bool ok = fwrite(record, 1, SCRIPT_HEADER_SIZE, file) == SCRIPT_HEADER_SIZE;
+
+	for (size_t i = 0; i < script->size && ok; i++)
+	{
+		StoreInstr(record, &script->code[i]);
+		ok = fwrite(record, 1, SCRIPT_INSTR_SIZE, file) == SCRIPT_INSTR_SIZE;
+	}
+	for (size_t i = 0; i < script->coeffCount && ok; i++)
+	{
+		StoreLE64(record, (uint64_t)script->coeffs[i]);
+		ok = fwrite(record, 1, 8, file) == 8;
+	}
+	if (ok && script->textSize != 0)
+		ok = fwrite(script->text, 1, script->textSize, file) == script->textSize;
+	if (ok && sourceLength != 0)
+		ok = fwrite(source, 1, sourceLength, file) == sourceLength;
+	if (ok)
+		ok = PSWrite(&script->literals, file);
+
+	if (fclose(file) != 0)
+		ok = false;
+	return ok;
+}
+
+/**
+ * Wczytuje skrypt z danych pliku zmapowanych do pamięci.
+ * @param[out] script : skrypt, ustawiany tylko przy sukcesie
+ * @param[in] data : dane pliku
+ * @param[in] length : długość danych
+ * @param[in] key : oczekiwany klucz
+ * @param[in] source : oczekiwany tekst źródłowy
+ * @param[in] sourceLength : długość tekstu źródłowego
+ * @return : czy dane są poprawne i pochodzą z tego tekstu?
+ */
+static bool ScriptRead(PolyScript *script, const unsigned char *data, size_t length,
+                       uint64_t key, const char *source, size_t sourceLength)
+{
+	if (length < SCRIPT_HEADER_SIZE ||
+	    memcmp(data, SCRIPT_MAGIC, SCRIPT_MAGIC_LENGTH) != 0 ||
+	    LoadLE32(data + 8) != SCRIPT_VERSION || LoadLE64(data + 16) != key ||
+	    LoadLE64(data + 48) != sourceLength)
+		return false;
+
+	uint64_t size = LoadLE64(data + 24), coeffCount = LoadLE64(data + 32),
+	         textSize = LoadLE64(data + 40);
+	size_t rest = length - SCRIPT_HEADER_SIZE;
+	if (size > rest / SCRIPT_INSTR_SIZE)
+		return false;
+	rest -= SCRIPT_INSTR_SIZE * size;
+	if (coeffCount > rest / 8)
+		return false;
+	rest -= 8 * coeffCount;
+	if (textSize > rest)
+		return false;
+	rest -= textSize;
+	if (sourceLength > rest)
+		return false;
+	rest -= sourceLength;
+
+	const unsigned char *sourcePos = data + (length - rest - sourceLength);
+	if (sourceLength != 0 && memcmp(sourcePos, source, sourceLength) != 0)
+		return false;
+
+	const unsigned char *pos = data + SCRIPT_HEADER_SIZE;
+	PolyScript result = ScriptInit();
+	if (!PSRead(&result.literals, data + (length - rest), rest))
+	{
+		ScriptDestroy(&result);
+		return false;
+	}
+
+	result.code = safeMalloc(size * sizeof(ScriptInstr));
+	result.size = result.capacity = size;
+	for (size_t i = 0; i < size; i++, pos += SCRIPT_INSTR_SIZE)
+		result.code[i] = LoadInstr(pos);
+
+	result.coeffs = safeMalloc(coeffCount * sizeof(poly_coeff_t));
+	result.coeffCount = result.coeffCapacity = coeffCount;
+	for (size_t i = 0; i < coeffCount; i++, pos += 8)
+		result.coeffs[i] = (poly_coeff_t)LoadLE64(pos);
+
+	result.text = safeMalloc(textSize);
+	result.textSize = result.textCapacity = textSize;
+	if (textSize != 0)
+		memcpy(result.text, pos, textSize);
+
+	*script = result;
+	return true;
+}
+
+bool ScriptLoad(PolyScript *script, const char *path, uint64_t key,
+                const char *source, size_t sourceLength)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat info;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size < SCRIPT_HEADER_SIZE)
+	{
+		close(fd);
+		return false;
+	}
+	size_t length = (size_t)info.st_size;
+	void *mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED)
+		return false;
+	posix_madvise(mapping, length, POSIX_MADV_WILLNEED);
+
+	bool ok = ScriptRead(script, mapping, length, key, source, sourceLength);
+	munmap(mapping, length);
+	return ok;
+}
+
+void ScriptDestroy(PolyScript *script)
+{
+	free(script->code);
+	PSDestroy(&script->literals);
+	free(script->coeffs);
+	free(script->text);
+	*script = (PolyScript){.code = NULL, .size = 0, .capacity = 0,
+	                       .literals = {.elems = 0, .size = 0, .stack = NULL, .exprs = NULL},
+	                       .coeffs = NULL, .coeffCount = 0, .coeffCapacity = 0,
+	                       .text = NULL, .textSize = 0, .textCapacity = 0};
+}
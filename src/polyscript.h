@@ -0,0 +1,138 @@
+/** @file
+ * @brief Interfejs skryptów kalkulatora skompilowanych do kodu bajtowego.
+ *
+ * Skrypt to tablica instrukcji, po jednej na każdy niepusty wiersz
+ * wejścia, który nie jest komentarzem, oraz pule danych, do których
+ * instrukcje się odwołują: tablica literałów wielomianowych, lista stałych
+ * będących argumentami poleceń i napisy. Znaczenie kodów instrukcji
+ * nadaje interfejs użytkownika, a ten moduł jedynie przechowuje skrypt
+ * i zapisuje go do pliku, z którego można go potem wczytać bez ponownego
+ * parsowania tekstu.
+ *
+ * @author Maurycy Wojda
+ * @date 2021
+ */
+
+#ifndef __POLY_SCRIPT_H__
+#define __POLY_SCRIPT_H__
+
+#include "poly.h"
+#include "polystack.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * To jest struktura instrukcji skryptu.
+ */
+typedef struct ScriptInstr
+{
+	uint32_t op; ///< kod instrukcji
+	uint32_t error; ///< błąd wykryty przy kompilacji wiersza
+	uint64_t line; ///< numer wiersza wejścia
+	long double arg; ///< argument liczbowy polecenia
+	size_t data; ///< indeks literału albo przesunięcie stałych lub napisu w puli
+	size_t count; ///< liczba stałych lub długość napisu
+} ScriptInstr;
+
+/**
+ * To jest struktura skryptu skompilowanego do kodu bajtowego.
+ */
+typedef struct PolyScript
+{
+	ScriptInstr *code; ///< tablica instrukcji
+	size_t size; ///< liczba instrukcji
+	size_t capacity; ///< liczba instrukcji, na które jest zaalokowana pamięć
+	PolyStack literals; ///< literały wielomianowe, indeksowane od dna stosu
+	poly_coeff_t *coeffs; ///< pula stałych
+	size_t coeffCount; ///< liczba stałych w puli
+	size_t coeffCapacity; ///< liczba stałych, na które jest zaalokowana pamięć
+	char *text; ///< pula napisów zakończonych znakiem '\0'
+	size_t textSize; ///< liczba bajtów w puli napisów
+	size_t textCapacity; ///< liczba bajtów, na które jest zaalokowana pamięć
+} PolyScript;
+
+/**
+ * Tworzy pusty skrypt.
+ * @return pusty skrypt
+ */
+PolyScript ScriptInit(void);
+
+/**
+ * Dopisuje na koniec skryptu instrukcję.
+ * @param[in,out] script : skrypt
+ * @param[in] instr : instrukcja
+ */
+void ScriptAppend(PolyScript *script, ScriptInstr instr);
+
+/**
+ * Dodaje do skryptu literał wielomianowy, przejmując go na własność.
+ * @param[in,out] script : skrypt
+ * @param[in] p : wielomian
+ * @return indeks literału
+ */
+size_t ScriptAddLiteral(PolyScript *script, Poly p);
+
+/**
+ * Kopiuje stałe do puli skryptu.
+ * @param[in,out] script : skrypt
+ * @param[in] coeffs : tablica stałych
+ * @param[in] count : liczba stałych
+ * @return przesunięcie pierwszej stałej w puli
+ */
+size_t ScriptAddCoeffs(PolyScript *script, const poly_coeff_t coeffs[], size_t count);
+
+/**
+ * Kopiuje napis do puli skryptu i kończy go znakiem '\0'.
+ * @param[in,out] script : skrypt
+ * @param[in] text : napis
+ * @param[in] length : długość napisu
+ * @return przesunięcie napisu w puli
+ */
+size_t ScriptAddText(PolyScript *script, const char *text, size_t length);
+
+/**
+ * Zapisuje skrypt do pliku w binarnym formacie. Wszystkie liczby są
+ * zapisane w porządku little-endian:
+ * - nagłówek: 8 bajtów `POLYCODE`, 32-bitowa wersja, 32 bity
+ *   zarezerwowane, 64-bitowy klucz oraz 64-bitowe liczby instrukcji,
+ *   stałych, bajtów puli napisów i bajtów tekstu źródłowego;
+ * - instrukcje: 32-bitowy kod, 32-bitowy błąd, 64-bitowy numer wiersza,
+ *   64-bitowa wartość bezwzględna argumentu, 32-bitowy znak argumentu,
+ *   32 bity zarezerwowane oraz 64-bitowe pola @p data i @p count;
+ * - stałe jako 64-bitowe liczby, pula napisów i tekst źródłowy skryptu;
+ * - literały w formacie migawki stosu opisanym przy PSSave.
+ * @param[in,out] script : skrypt, którego stos literałów jest zapisywany
+ * funkcją PSWrite
+ * @param[in] path : ścieżka do pliku
+ * @param[in] key : klucz, na przykład skrót tekstu skryptu, który musi się
+ * zgadzać przy wczytywaniu
+ * @param[in] source : tekst źródłowy skryptu
+ * @param[in] sourceLength : długość tekstu źródłowego
+ * @return czy zapis się powiódł?
+ */
+bool ScriptSave(PolyScript *script, const char *path, uint64_t key,
+                const char *source, size_t sourceLength);
+
+/**
+ * Wczytuje skrypt z pliku zapisanego funkcją ScriptSave. Sprawdza tylko,
+ * czy plik ma poprawną budowę, podany klucz i zapisany w nim tekst
+ * źródłowy identyczny z podanym, a poprawność kodów instrukcji i ich
+ * odwołań do pul musi sprawdzić wywołujący. Porównanie całego tekstu
+ * sprawia, że kolizja klucza nie może uruchomić innego skryptu.
+ * @param[out] script : skrypt, ustawiany tylko przy sukcesie
+ * @param[in] path : ścieżka do pliku
+ * @param[in] key : oczekiwany klucz
+ * @param[in] source : oczekiwany tekst źródłowy skryptu
+ * @param[in] sourceLength : długość tekstu źródłowego
+ * @return czy odczyt się powiódł?
+ */
+bool ScriptLoad(PolyScript *script, const char *path, uint64_t key,
+                const char *source, size_t sourceLength);
+
+/**
+ * Usuwa skrypt z pamięci.
+ * @param[in] script : skrypt
+ */
+void ScriptDestroy(PolyScript *script);
+
+#endif /* __POLY_SCRIPT_H__ */
@@ -5,11 +5,59 @@
  * @date 2021
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "polystack.h"
+#include "bigcoeff.h"
+#include "byteorder.h"
 #include "safealloc.h"
+#include "taskpool.h"
 #include "poly.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Znacznik na początku pliku migawki.
+ */
+#define SNAPSHOT_MAGIC "POLYSNAP"
+
+/**
+ * Długość znacznika migawki.
+ */
+#define SNAPSHOT_MAGIC_LENGTH 8
+
+/**
+ * Wersja formatu migawki.
+ */
+#define SNAPSHOT_VERSION 1
+
+/**
+ * Rozmiar nagłówka migawki w bajtach.
+ */
+#define SNAPSHOT_HEADER_SIZE 32
+
+/**
+ * Największa głębokość zagnieżdżenia wielomianu w migawce. Głębsze
+ * rekordy są odrzucane, żeby odczyt nie przepełnił stosu wywołań.
+ */
+#define SNAPSHOT_MAX_DEPTH 4096
+
+/**
+ * Liczba jednomianów w rekordzie, która oznacza rekord wielkiej liczby.
+ */
+#define SNAPSHOT_BIG_TAG UINT32_MAX
+
+/**
+ * Rozmiar bufora zapisu migawki w bajtach.
+ */
+#define SNAPSHOT_BUFFER_SIZE (1 << 16)
 
 PolyStack PSInit()
 {
@@ -17,6 +65,7 @@ PolyStack PSInit()
 	result.elems = 0;
 	result.size = DEFAULT_SIZE;
 	result.stack = safeMalloc(DEFAULT_SIZE * sizeof(Poly));
+	result.exprs = safeMalloc(DEFAULT_SIZE * sizeof(PolyExpr*));
 	return result;
 }
 
@@ -26,46 +75,489 @@ void PSPush(PolyStack *s, const Poly p)
 	{
 		s->size *= 2;
 		safeRealloc((void**)&s->stack, s->size * sizeof(Poly));
+		safeRealloc((void**)&s->exprs, s->size * sizeof(PolyExpr*));
 	}
+	s->exprs[s->elems] = NULL;
 	s->stack[s->elems++] = p;
 }
 
-Poly PSGet(const PolyStack *s, size_t pos)
+void PSPushExpr(PolyStack *s, PolyExpr *e)
 {
-	return s->stack[s->elems - pos];
+	if (e->kind == EXPR_VALUE)
+	{
+		PSPush(s, ExprTake(e));
+		return;
+	}
+	PSPush(s, PolyZero());
+	s->exprs[s->elems - 1] = e;
 }
 
-Poly *PSGetPtr(const PolyStack *s, size_t pos)
+/**
+ * Wylicza element stosu, jeżeli nie jest jeszcze wyliczony.
+ * @param[in,out] s : wskaźnik na stos
+ * @param[in] index : indeks elementu od dna stosu
+ * @return : wskaźnik na wielomian elementu
+ */
+static Poly *PSForce(PolyStack *s, size_t index)
+{
+	if (s->exprs[index] != NULL)
+	{
+		s->stack[index] = ExprTake(s->exprs[index]);
+		s->exprs[index] = NULL;
+	}
+	return s->stack + index;
+}
+
+void PSForceAll(PolyStack *s)
+{
+	for (size_t i = 0; i < s->elems; i++)
+		PSForce(s, i);
+}
+
+Poly PSGet(PolyStack *s, size_t pos)
+{
+	return *PSForce(s, s->elems - pos);
+}
+
+Poly *PSGetPtr(PolyStack *s, size_t pos)
 {
-	return s->stack + (s->elems - pos);
+	return PSForce(s, s->elems - pos);
 }
 
-Poly PSPeek(const PolyStack *s)
+Poly PSPeek(PolyStack *s)
 {
 	return PSGet(s, 1);
 }
 
-Poly *PSPeekPtr(const PolyStack *s)
+Poly *PSPeekPtr(PolyStack *s)
 {
 	return PSGetPtr(s, 1);
 }
 
-Poly PSPop(PolyStack *s)
+/**
+ * Usuwa wierzchni element z tablic stosu, zmniejszając je,
+ * gdy są zajęte w co najwyżej jednej czwartej.
+ * @param[in] s : wskaźnik na stos
+ */
+static void PSShrink(PolyStack *s)
 {
-	Poly result = s->stack[--s->elems];
-
+	s->elems--;
 	if (s->elems <= s->size / 4 && s->size > DEFAULT_SIZE)
 	{
 		s->size /= 2;
 		safeRealloc((void**)&s->stack, s->size * sizeof(Poly));
+		safeRealloc((void**)&s->exprs, s->size * sizeof(PolyExpr*));
 	}
+}
+
+Poly PSPop(PolyStack *s)
+{
+	Poly result = *PSForce(s, s->elems - 1);
+	PSShrink(s);
+	return result;
+}
 
+PolyExpr *PSPopExpr(PolyStack *s)
+{
+	PolyExpr *result = s->exprs[s->elems - 1];
+	if (result == NULL)
+		result = ExprValue(s->stack[s->elems - 1]);
+	PSShrink(s);
 	return result;
 }
 
+void PSDrop(PolyStack *s)
+{
+	size_t top = s->elems - 1;
+	if (s->exprs[top] != NULL)
+		ExprRelease(s->exprs[top]);
+	PolyDestroy(&s->stack[top]);
+	PSShrink(s);
+}
+
 void PSDestroy(PolyStack *s)
 {
 	for (size_t i = 0; i < s->elems; i++)
+	{
+		if (s->exprs[i] != NULL)
+			ExprRelease(s->exprs[i]);
 		PolyDestroy(&s->stack[i]);
+	}
 	free(s->stack);
-}
\ No newline at end of file
+	free(s->exprs);
+}
+
+/**
+ * Struktura buforowanego zapisu migawki do pliku.
+ */
+typedef struct SnapshotWriter
+{
+	FILE *file; ///< plik migawki
+	size_t used; ///< liczba zajętych bajtów bufora
+	bool ok; ///< czy wszystkie zapisy się powiodły?
+	unsigned char buffer[SNAPSHOT_BUFFER_SIZE]; ///< bufor zapisu
+} SnapshotWriter;
+
+/**
+ * Zapisuje zawartość bufora do pliku i opróżnia bufor.
+ * @param[in,out] w : zapis migawki
+ */
+static void WriterFlush(SnapshotWriter *w)
+{
+	if (w->used != 0 && fwrite(w->buffer, 1, w->used, w->file) != w->used)
+		w->ok = false;
+	w->used = 0;
+}
+
+/**
+ * Zwraca miejsce w buforze na kolejne bajty migawki.
+ * @param[in,out] w : zapis migawki
+ * @param[in] length : liczba bajtów, co najwyżej 8
+ * @return : wskaźnik na miejsce w buforze
+ */
+static unsigned char *WriterReserve(SnapshotWriter *w, size_t length)
+{
+	if (w->used + length > SNAPSHOT_BUFFER_SIZE)
+		WriterFlush(w);
+	unsigned char *out = w->buffer + w->used;
+	w->used += length;
+	return out;
+}
+
+/**
+ * Zwraca rozmiar rekordu wielomianu w migawce.
+ * @param[in] p : wielomian
+ * @return : liczba bajtów rekordu
+ */
+static uint64_t SnapshotPolySize(const Poly *p)
+{
+	if (PolyIsBig(p))
+		return 4 + 4 + 4 + 8 * (uint64_t)BigOf(p)->length;
+	if (PolyIsCoeff(p))
+		return 4 + 8;
+	uint64_t size = 4 + 4 * (uint64_t)p->size;
+	for (size_t i = 0; i < p->size; i++)
+		size += SnapshotPolySize(&p->arr[i].p);
+	return size;
+}
+
+/**
+ * Zapisuje rekord wielomianu w porządku preorder.
+ * @param[in,out] w : zapis migawki
+ * @param[in] p : wielomian
+ */
+static void SnapshotWritePoly(SnapshotWriter *w, const Poly *p)
+{
+	if (PolyIsBig(p))
+	{
+		const BigCoeff *big = BigOf(p);
+		StoreLE32(WriterReserve(w, 4), SNAPSHOT_BIG_TAG);
+		StoreLE32(WriterReserve(w, 4), big->negative);
+		StoreLE32(WriterReserve(w, 4), (uint32_t)big->length);
+		for (size_t i = 0; i < big->length; i++)
+			StoreLE64(WriterReserve(w, 8), big->limbs[i]);
+		return;
+	}
+	if (PolyIsCoeff(p))
+	{
+		StoreLE32(WriterReserve(w, 4), 0);
+		StoreLE64(WriterReserve(w, 8), (uint64_t)p->coeff);
+		return;
+	}
+
+	if (p->size >= SNAPSHOT_BIG_TAG)
+		w->ok = false;
+	StoreLE32(WriterReserve(w, 4), (uint32_t)p->size);
+	for (size_t i = 0; i < p->size; i++)
+		StoreLE32(WriterReserve(w, 4), (uint32_t)p->arr[i].exp);
+	for (size_t i = 0; i < p->size; i++)
+		SnapshotWritePoly(w, &p->arr[i].p);
+}
+
+bool PSWrite(PolyStack *s, FILE *file)
+{
+	SnapshotWriter *w = safeMalloc(sizeof(SnapshotWriter));
+	w->file = file;
+	w->used = 0;
+	w->ok = true;
+
+	memcpy(WriterReserve(w, SNAPSHOT_MAGIC_LENGTH), SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LENGTH);
+	StoreLE32(WriterReserve(w, 4), SNAPSHOT_VERSION);
+	StoreLE32(WriterReserve(w, 4), 0);
+	StoreLE64(WriterReserve(w, 8), (uint64_t)PolyGetModulus());
+	StoreLE64(WriterReserve(w, 8), s->elems);
+
+	uint64_t offset = SNAPSHOT_HEADER_SIZE + 8 * (uint64_t)s->elems;
+	for (size_t i = 0; i < s->elems; i++)
+	{
+		StoreLE64(WriterReserve(w, 8), offset);
+		offset += SnapshotPolySize(PSForce(s, i));
+	}
+	for (size_t i = 0; i < s->elems; i++)
+		SnapshotWritePoly(w, &s->stack[i]);
+	WriterFlush(w);
+
+	bool ok = w->ok;
+	free(w);
+	return ok;
+}
+
+bool PSSave(PolyStack *s, const char *path)
+{
+	FILE *file = fopen(path, "wb");
+	if (file == NULL)
+		return false;
+
+	bool ok = PSWrite(s, file);
+	if (fclose(file) != 0)
+		ok = false;
+	return ok;
+}
+
+/**
+ * Odczytuje treść rekordu wielkiej liczby, za znacznikiem SNAPSHOT_BIG_TAG.
+ * @param[in,out] pos : kursor w danych migawki
+ * @param[in] end : koniec danych, za którym nie wolno czytać
+ * @param[out] p : odczytana liczba, ustawiana tylko przy sukcesie
+ * @return : czy rekord jest poprawny?
+ */
+static bool SnapshotReadBig(const unsigned char **pos, const unsigned char *end, Poly *p)
+{
+	if (end - *pos < 8)
+		return false;
+	uint32_t negative = LoadLE32(*pos), length = LoadLE32(*pos + 4);
+	*pos += 8;
+	if (negative > 1 || length == 0 || length > BIG_MAX_LIMBS ||
+	    (uint64_t)(end - *pos) / 8 < length)
+		return false;
+
+	uint64_t *limbs = safeMalloc(length * sizeof(uint64_t));
+	for (size_t i = 0; i < length; i++)
+		limbs[i] = LoadLE64(*pos + 8 * i);
+	*pos += 8 * (size_t)length;
+	bool ok = limbs[length - 1] != 0 &&
+	          (length > 1 || limbs[0] > (uint64_t)LONG_MAX + negative);
+	if (ok)
+		*p = BigFromLimbs(negative, limbs, length);
+	free(limbs);
+	return ok;
+}
+
+/*
+Wyjaśnienie implementacji:
+Rozmiar każdej tablicy jednomianów jest zapisany przed nią, więc
+	tablicę alokuję od razu w docelowym rozmiarze i wypełniam ją
+	bez sortowania i scalania. Dlatego sprawdzam wszystkie niezmienniki
+	wielomianów tworzonych przez bibliotekę: wykładniki rosną ściśle,
+	żaden współczynnik nie jest zerem, a tablica nie składa się z samego
+	współczynnika stałego przy zerowym wykładniku. Jeżeli migawka była
+	zapisana w trybie modularnym, to współczynniki stałe muszą być
+	resztami modulo jej moduł, a zagnieżdżenie nie może przekraczać
+	SNAPSHOT_MAX_DEPTH.
+Wielka liczba może wystąpić tylko w migawce zapisanej bez modułu i musi
+	być w postaci kanonicznej: najbardziej znaczące słowo jest niezerowe,
+	a liczba nie mieści się w typie poly_coeff_t. BigFromLimbs sprowadza
+	ją do bieżącego trybu arytmetyki, a poza trybem sprawdzanym może przy
+	tym wyjść zero. Dlatego niezmienniki jednomianu, w którego
+	współczynniku była sprowadzona wielka liczba, sprawdzam dopiero
+	po odczycie, sprowadzając cały wielomian funkcją PolyReduce.
+*/
+/**
+ * Odczytuje rekord wielomianu i przesuwa kursor za niego.
+ * @param[in,out] pos : kursor w danych migawki
+ * @param[in] end : koniec danych, za którym nie wolno czytać
+ * @param[in] modulus : moduł migawki lub 0
+ * @param[in] depth : głębokość zagnieżdżenia rekordu
+ * @param[out] p : odczytany wielomian, ustawiany tylko przy sukcesie
+ * @param[out] wrapped : czy któraś wielka liczba rekordu przestała być
+ * wielką liczbą, więc wielomian trzeba jeszcze sprowadzić?
+ * @return : czy rekord jest poprawny?
+ */
+static bool SnapshotReadPoly(const unsigned char **pos, const unsigned char *end,
+                             uint64_t modulus, size_t depth, Poly *p, bool *wrapped)
+{
+	*wrapped = false;
+	if (depth > SNAPSHOT_MAX_DEPTH)
+		return false;
+	if (end - *pos < 4)
+		return false;
+	uint32_t size = LoadLE32(*pos);
+	*pos += 4;
+
+	if (size == SNAPSHOT_BIG_TAG)
+	{
+		if (modulus != 0 || !SnapshotReadBig(pos, end, p))
+			return false;
+		*wrapped = !PolyIsBig(p);
+		return true;
+	}
+	if (size == 0)
+	{
+		if (end - *pos < 8)
+			return false;
+		uint64_t coeff = LoadLE64(*pos);
+		if (modulus != 0 && coeff >= modulus)
+			return false;
+		*p = PolyFromCoeff((poly_coeff_t)coeff);
+		*pos += 8;
+		return true;
+	}
+
+	if ((uint64_t)(end - *pos) / 4 < size)
+		return false;
+	const unsigned char *exps = *pos;
+	*pos += 4 * (size_t)size;
+
+	Mono *monos = poolMalloc(size * sizeof(Mono));
+	for (size_t i = 0; i < size; i++)
+	{
+		uint32_t exp = LoadLE32(exps + 4 * i);
+		bool monoWrapped = false;
+		bool ok = exp <= POLY_EXP_T_MAX && (i == 0 || (poly_exp_t)exp > monos[i - 1].exp) &&
+		          SnapshotReadPoly(pos, end, modulus, depth + 1, &monos[i].p, &monoWrapped);
+		if (ok && !monoWrapped && (PolyIsZero(&monos[i].p) ||
+		                           (size == 1 && exp == 0 && PolyIsCoeff(&monos[i].p))))
+			ok = false;
+		if (!ok)
+		{
+			for (size_t j = 0; j < i; j++)
+				MonoDestroy(&monos[j]);
+			poolFree(monos);
+			return false;
+		}
+		monos[i].exp = (poly_exp_t)exp;
+		*wrapped = *wrapped || monoWrapped;
+	}
+
+	*p = (Poly){.size = size, .arr = monos};
+	return true;
+}
+
+/**
+ * Zadanie odczytania ciągu kolejnych wielomianów migawki.
+ */
+typedef struct SnapshotLoadTask
+{
+	const unsigned char *data; ///< dane migawki
+	size_t length; ///< długość danych
+	uint64_t modulus; ///< moduł migawki lub 0
+	size_t count; ///< liczba wielomianów w migawce
+	size_t from; ///< indeks pierwszego odczytywanego wielomianu
+	size_t to; ///< indeks za ostatnim odczytywanym wielomianem
+	Poly *polys; ///< tablica na wszystkie wielomiany migawki
+	bool ok; ///< czy wszystkie rekordy zadania są poprawne?
+} SnapshotLoadTask;
+
+/**
+ * Odczytuje wielomiany zadania. Wielomiany, których nie udało się
+ * odczytać, pozostają zerowe.
+ * @param[in,out] arg : zadanie SnapshotLoadTask
+ */
+static void SnapshotLoadChunk(void *arg)
+{
+	SnapshotLoadTask *task = arg;
+	const unsigned char *offsets = task->data + SNAPSHOT_HEADER_SIZE;
+	uint64_t tableEnd = SNAPSHOT_HEADER_SIZE + 8 * (uint64_t)task->count;
+	task->ok = true;
+	for (size_t i = task->from; i < task->to && task->ok; i++)
+	{
+		uint64_t start = LoadLE64(offsets + 8 * i);
+		uint64_t stop = i + 1 < task->count ? LoadLE64(offsets + 8 * (i + 1)) : task->length;
+		if (start < tableEnd || start > stop || stop > task->length)
+		{
+			task->ok = false;
+			break;
+		}
+
+		const unsigned char *pos = task->data + start, *end = task->data + stop;
+		bool wrapped;
+		task->ok = SnapshotReadPoly(&pos, end, task->modulus, 0, &task->polys[i], &wrapped);
+		if (task->ok && pos != end)
+		{
+			PolyDestroy(&task->polys[i]);
+			task->polys[i] = PolyZero();
+			task->ok = false;
+		}
+		else if (task->ok && wrapped)
+		{
+			task->polys[i] = PolyReduce(&task->polys[i]);
+		}
+	}
+}
+
+/*
+Wyjaśnienie implementacji:
+Tablica przesunięć pozwala odczytywać wielomiany niezależnie od siebie,
+	więc dzielę je na ciągi odczytywane przez zadania puli wątków.
+	Wielomiany trafiają na stos dopiero wtedy, gdy cała migawka okaże się
+	poprawna.
+*/
+bool PSRead(PolyStack *s, const void *snapshot, size_t length)
+{
+	const unsigned char *data = snapshot;
+	if (length < SNAPSHOT_HEADER_SIZE)
+		return false;
+	uint64_t modulus = LoadLE64(data + 16), count = LoadLE64(data + 24);
+	if (memcmp(data, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LENGTH) != 0 ||
+	    LoadLE32(data + 8) != SNAPSHOT_VERSION ||
+	    count > (length - SNAPSHOT_HEADER_SIZE) / 8)
+		return false;
+
+	Poly *polys = safeMalloc(count * sizeof(Poly));
+	for (size_t i = 0; i < count; i++)
+		polys[i] = PolyZero();
+
+	size_t chunks = count == 0 ? 1 : TaskChunkCount(count, length);
+	SnapshotLoadTask *tasks = safeMalloc(chunks * sizeof(SnapshotLoadTask));
+	TaskGroup group = TaskGroupInit();
+	for (size_t c = 0; c < chunks; c++)
+	{
+		tasks[c] = (SnapshotLoadTask){.data = data, .length = length, .modulus = modulus,
+		                              .count = count, .from = count * c / chunks,
+		                              .to = count * (c + 1) / chunks, .polys = polys,
+		                              .ok = false};
+		TaskSpawn(&group, SnapshotLoadChunk, &tasks[c]);
+	}
+	TaskWait(&group);
+
+	bool ok = true;
+	for (size_t c = 0; c < chunks; c++)
+		ok = ok && tasks[c].ok;
+	free(tasks);
+
+	poly_coeff_t current = PolyGetModulus();
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!ok)
+			PolyDestroy(&polys[i]);
+		else if (current != 0 && (uint64_t)current != modulus)
+			PSPush(s, PolyReduce(&polys[i]));
+		else
+			PSPush(s, polys[i]);
+	}
+	free(polys);
+	return ok;
+}
+
+bool PSLoad(PolyStack *s, const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat info;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size < SNAPSHOT_HEADER_SIZE)
+	{
+		close(fd);
+		return false;
+	}
+	size_t length = (size_t)info.st_size;
+	void *mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED)
+		return false;
+	posix_madvise(mapping, length, POSIX_MADV_WILLNEED);
+
+	bool ok = PSRead(s, mapping, length);
+	munmap(mapping, length);
+	return ok;
+}
@@ -9,6 +9,9 @@
 #define __POLY_STACK_H__
 
 #include "poly.h"
+#include "polyexpr.h"
+#include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 /**
@@ -28,6 +31,12 @@ typedef struct PolyStack
 	 * Tablica na której implementowany jest stos.
 	 */
 	Poly *stack;
+	/**
+	 * Tablica wyrażeń niewyliczonych jeszcze elementów stosu, równoległa
+	 * do tablicy @p stack. Dla wyliczonego elementu wyrażenie jest `NULL`,
+	 * a dla niewyliczonego element tablicy @p stack jest zerem.
+	 */
+	PolyExpr **exprs;
 } PolyStack;
 
 /**
@@ -43,39 +52,70 @@ PolyStack PSInit();
  */
 void PSPush(PolyStack *s, const Poly p);
 
+/**
+ * Kładzie wyrażenie na wierzch stosu @f$s@f$, przejmując jego referencję.
+ * Wyrażenie, które ma już wartość, jest od razu zamieniane na wielomian.
+ * @param[in] s : wskaźnik na stos @f$s@f$
+ * @param[in] e : wyrażenie
+ */
+void PSPushExpr(PolyStack *s, PolyExpr *e);
+
+/**
+ * Zdejmuje element z wierzchu stosu @f$s@f$ bez wyliczania go.
+ * Nie zawiera obsługi błędu przy próbie czytania z pustego stosu.
+ * @param[in] s : wskaźnik na stos @f$s@f$
+ * @return : wyrażenie z jedną referencją o wartości elementu
+ */
+PolyExpr *PSPopExpr(PolyStack *s);
+
+/**
+ * Usuwa element z wierzchu stosu @f$s@f$ bez wyliczania go.
+ * Nie zawiera obsługi błędu przy próbie usunięcia z pustego stosu.
+ * @param[in] s : wskaźnik na stos @f$s@f$
+ */
+void PSDrop(PolyStack *s);
+
+/**
+ * Wylicza wszystkie niewyliczone elementy stosu @f$s@f$.
+ * @param[in] s : wskaźnik na stos @f$s@f$
+ */
+void PSForceAll(PolyStack *s);
+
 /**
  * Zwraca wielomian na pozycji @f$pos@f$ od wierzchu stosu @f$s@f$.
+ * Niewyliczony element jest najpierw wyliczany, tak jak we wszystkich
+ * pozostałych funkcjach czytających elementy stosu.
  * Nie obsługuje błędu `index out of bounds`.
- * @param[in] s : wskaźnik na stos @f$s@f$
+ * @param[in,out] s : wskaźnik na stos @f$s@f$
  * @param[in] pos : pozycja od wierzchu stosu
  * @return : @f$pos@f$-ty element od wierzchu stosu @f$s@f$.
  */
-Poly PSGet(const PolyStack *s, size_t pos);
+Poly PSGet(PolyStack *s, size_t pos);
 
 /**
  * Zwraca wskaźnik na wielomian na pozycji @f$pos@f$ od wierzchu stosu @f$s@f$.
  * Nie obsługuje błędu `index out of bounds`.
- * @param[in] s : wskaźnik na stos @f$s@f$
+ * @param[in,out] s : wskaźnik na stos @f$s@f$
  * @param[in] pos : pozycja od wierzchu stosu
  * @return : wskaźnik na @f$pos@f$-ty element od wierzchu stosu @f$s@f$.
  */
-Poly *PSGetPtr(const PolyStack *s, size_t pos);
+Poly *PSGetPtr(PolyStack *s, size_t pos);
 
 /**
  * Zwraca wielomian z wierzchu stosu @f$s@f$.
  * Nie zawiera obsługi błędu przy próbie czytania z pustego stosu.
- * @param[in] s : wskaźnik na stos @f$s@f$
+ * @param[in,out] s : wskaźnik na stos @f$s@f$
  * @return : wielomian z wierzchu stosu
  */
-Poly PSPeek(const PolyStack *s);
+Poly PSPeek(PolyStack *s);
 
 /**
  * Zwraca wskaźnik na wielomian z wierzchu stosu @f$s@f$.
  * Nie zawiera obsługi błędu przy próbie czytania z pustego stosu.
- * @param[in] s : wskaźnik na stos @f$s@f$
+ * @param[in,out] s : wskaźnik na stos @f$s@f$
  * @return : wskaźnik na wielomian z wierzchu stosu
  */
-Poly *PSPeekPtr(const PolyStack *s);
+Poly *PSPeekPtr(PolyStack *s);
 
 /**
  * Zwraca wielomian z wierzchu stosu @f$s@f$ i usuwa go ze stosu.
@@ -91,4 +131,71 @@ Poly PSPop(PolyStack *s);
  */
 void PSDestroy(PolyStack *s);
 
+/**
+ * Zapisuje wszystkie wielomiany stosu @f$s@f$, od dna do wierzchu,
+ * do pliku w binarnym formacie migawki. Format jest wersjonowany,
+ * a wszystkie liczby są zapisane w porządku little-endian:
+ * - nagłówek: 8 bajtów `POLYSNAP`, 32-bitowa wersja, 32 bity zarezerwowane,
+ *   64-bitowy moduł arytmetyki współczynników z chwili zapisu
+ *   i 64-bitowa liczba wielomianów;
+ * - tablica 64-bitowych przesunięć rekordów wielomianów od początku pliku;
+ * - rekordy wielomianów zapisane w porządku preorder: 32-bitowa liczba
+ *   jednomianów, po której dla wielomianu stałego następuje 64-bitowy
+ *   współczynnik, a w przeciwnym przypadku 32-bitowe wykładniki
+ *   wszystkich jednomianów i rekordy ich współczynników;
+ *   liczba jednomianów równa @f$2^{32}-1@f$ oznacza wielką liczbę, po
+ *   której następuje 32-bitowy znak (1 dla liczby ujemnej), 32-bitowa
+ *   liczba słów i 64-bitowe słowa wartości bezwzględnej, od najmniej
+ *   znaczącego.
+ *
+ * Niewyliczone elementy stosu są przed zapisem wyliczane.
+ * @param[in,out] s : wskaźnik na stos @f$s@f$
+ * @param[in] path : ścieżka do pliku
+ * @return : `true`, jeżeli zapis się powiódł,
+ * `false` w przeciwnym przypadku.
+ */
+bool PSSave(PolyStack *s, const char *path);
+
+/**
+ * Dopisuje migawkę stosu @f$s@f$ w formacie opisanym przy PSSave
+ * do otwartego pliku, od jego bieżącej pozycji. Przesunięcia rekordów
+ * są liczone od początku migawki, więc migawka może być częścią
+ * większego pliku. Niewyliczone elementy stosu są przed zapisem wyliczane.
+ * @param[in,out] s : wskaźnik na stos @f$s@f$
+ * @param[in] file : plik otwarty do zapisu
+ * @return : `true`, jeżeli zapis się powiódł,
+ * `false` w przeciwnym przypadku.
+ */
+bool PSWrite(PolyStack *s, FILE *file);
+
+/**
+ * Kładzie na stos @f$s@f$ wielomiany z migawki znajdującej się
+ * w pamięci, tak jak PSLoad. Jeżeli migawka jest niepoprawna,
+ * to stos pozostaje niezmieniony.
+ * @param[in,out] s : wskaźnik na stos @f$s@f$
+ * @param[in] snapshot : początek migawki
+ * @param[in] length : długość migawki w bajtach
+ * @return : `true`, jeżeli odczyt się powiódł,
+ * `false` w przeciwnym przypadku.
+ */
+bool PSRead(PolyStack *s, const void *snapshot, size_t length);
+
+/**
+ * Wczytuje wielomiany z pliku zapisanego funkcją PSSave i kładzie je na
+ * stos @f$s@f$ w zapisanej kolejności, tak że ostatni zapisany wielomian
+ * trafia na wierzch. Plik jest mapowany do pamięci, a każda tablica
+ * jednomianów jest alokowana od razu w docelowym rozmiarze. Jeżeli plik
+ * był zapisany z innym modułem niż bieżący moduł niezerowy, to
+ * współczynniki są do niego sprowadzane, a wielkie liczby są sprowadzane
+ * do bieżącego trybu arytmetyki. Plik jest niepoprawny także
+ * wtedy, gdy współczynnik nie jest resztą modulo zapisany moduł albo
+ * wielomian jest zagnieżdżony głębiej niż na SNAPSHOT_MAX_DEPTH poziomów.
+ * Jeżeli plik jest niepoprawny, to stos pozostaje niezmieniony.
+ * @param[in,out] s : wskaźnik na stos @f$s@f$
+ * @param[in] path : ścieżka do pliku
+ * @return : `true`, jeżeli odczyt się powiódł,
+ * `false` w przeciwnym przypadku.
+ */
+bool PSLoad(PolyStack *s, const char *path);
+
 #endif /* __POLY_STACK_H__ */
\ No newline at end of file
@@ -5,15 +5,24 @@
  * @date 2021
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "polyui.h"
+#include "coeff.h"
+#include "polyprog.h"
+#include "polyscript.h"
 #include "polystack.h"
 #include "safealloc.h"
 #include <stdbool.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
+#include <unistd.h>
 
 /**
  * Typ wyliczeniowy do obsługi błędów.
@@ -24,6 +33,8 @@ typedef enum ErrorType
 	STACK_UNDERFLOW,
 	WRONG_POLY,
 	WRONG_COMMAND,
+	COEFF_OVERFLOW,
+	COEFF_TOO_BIG,
 	WRONG_ARGUMENT
 } ErrorType;
 
@@ -41,9 +52,21 @@ static const char *errorMessages[NO_OF_ERRORS] =
 	"",
 	"STACK UNDERFLOW",
 	"WRONG POLY",
-	"WRONG COMMAND"
+	"WRONG COMMAND",
+	"COEFF OVERFLOW",
+	"COEFF TOO BIG"
 };
 
+/**
+ * Typ wyliczeniowy rodzajów argumentów poleceń.
+ */
+typedef enum ArgKind
+{
+	ARG_SINGLE, ///< brak argumentu lub jeden argument czytany funkcją readArgFunc
+	ARG_LIST,   ///< niepusta lista stałych oddzielonych spacjami
+	ARG_PATH    ///< ścieżka do pliku, czyli cała reszta wiersza
+} ArgKind;
+
 /**
  * Struktura przechowująca kontekst wywołania polecenia.
  */
@@ -57,6 +80,18 @@ typedef struct ExectionContext
 	 * Opcjonalny argument polecenia.
 	 */
 	long double arg;
+	/**
+	 * Lista argumentów polecenia przyjmującego listę stałych lub NULL.
+	 */
+	poly_coeff_t *args;
+	/**
+	 * Liczba argumentów na liście.
+	 */
+	size_t argCount;
+	/**
+	 * Ścieżka do pliku podana jako argument polecenia lub NULL.
+	 */
+	const char *path;
 	/**
 	 * Wskaźnik na flagę błędu.
 	 */
@@ -93,8 +128,41 @@ typedef struct CommandInfo
 	 * Komunikat błedu do wypisanie, jeżeli argument będzie źle podany.
 	 */
 	const char *argErrMsg;
+	/**
+	 * Rodzaj argumentu polecenia.
+	 */
+	ArgKind argKind;
 } CommandInfo;
 
+/**
+ * Czy polecenie LAZY włączyło leniwe wyliczanie?
+ */
+static bool lazyMode = false;
+
+/**
+ * Sprawdza, czy ADD, MUL i CLONE mają budować wyrażenia zamiast liczyć.
+ * W trybie sprawdzanym wszystko jest liczone od razu, bo to, czy
+ * przepełnienie zostanie zgłoszone przy danym poleceniu, zależy
+ * od kolejności działań.
+ * @return wynik
+ */
+static bool isLazy(void)
+{
+	return lazyMode && !PolyIsChecked();
+}
+
+/**
+ * Sprowadza stałe podane jako argumenty polecenia do bieżącego
+ * trybu arytmetyki współczynników.
+ * @param[in,out] args : tablica stałych
+ * @param[in] count : liczba stałych
+ */
+static void reduceArgs(poly_coeff_t *args, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		args[i] = CoeffReduce(args[i]);
+}
+
 /**
  * Funkcja do wykonania na stosie przy obsłudze polecenia ZERO.
  * param[in] context : kontekst wywołania polecenia
@@ -134,6 +202,13 @@ static void executeClone(ExecutionContext context)
 {
 	if (context.stack->elems < 1)
 		return (void)(*context.errType = STACK_UNDERFLOW);
+	if (isLazy())
+	{
+		PolyExpr *top = PSPopExpr(context.stack);
+		PSPushExpr(context.stack, ExprRetain(top));
+		PSPushExpr(context.stack, top);
+		return;
+	}
 	PSPush(context.stack, PolyClone(PSPeekPtr(context.stack)));
 }
 
@@ -145,11 +220,67 @@ static void executeAdd(ExecutionContext context)
 {
 	if (context.stack->elems < 2)
 		return (void)(*context.errType = STACK_UNDERFLOW);
+	if (isLazy())
+	{
+		PolyExpr *p = PSPopExpr(context.stack);
+		PolyExpr *q = PSPopExpr(context.stack);
+		PSPushExpr(context.stack, ExprAdd(p, q));
+		return;
+	}
 	Poly p = PSPop(context.stack);
 	Poly q = PSPop(context.stack);
-	PSPush(context.stack, PolyAdd(&p, &q));
-	PolyDestroy(&p);
-	PolyDestroy(&q);
+	PSPush(context.stack, PolyAddOwn(&p, &q));
+}
+
+/**
+ * Zdejmuje ze stosu @f$n@f$ wielomianów i kładzie wynik ich połączenia.
+ * W trybie leniwym łączy wyrażenia elementów, a w przeciwnym przypadku
+ * przekazuje wszystkie wielomiany naraz funkcji @p combine.
+ * Parametr @f$n@f$ musi być dodatni.
+ * param[in] context : kontekst wywołania polecenia
+ * param[in] combineExpr : funkcja łącząca dwa wyrażenia
+ * param[in] combine : funkcja łącząca tablicę wielomianów
+ */
+static void executeMany(ExecutionContext context,
+                        PolyExpr *(*combineExpr)(PolyExpr *p, PolyExpr *q),
+                        Poly (*combine)(size_t n, const Poly ps[]))
+{
+	size_t n = (size_t)context.arg;
+	if (n == 0)
+		return (void)(*context.errType = WRONG_ARGUMENT);
+	if (context.stack->elems < n)
+		return (void)(*context.errType = STACK_UNDERFLOW);
+	if (isLazy())
+	{
+		PolyExpr *result = PSPopExpr(context.stack);
+		for (size_t i = 1; i < n; i++)
+			result = combineExpr(result, PSPopExpr(context.stack));
+		PSPushExpr(context.stack, result);
+		return;
+	}
+
+	Poly *ps = safeMalloc(n * sizeof(Poly));
+	for (size_t i = 0; i < n; i++)
+		ps[n - i - 1] = PSPop(context.stack);
+
+	Poly result = combine(n, ps);
+
+	for (size_t i = 0; i < n; i++)
+		PolyDestroy(&ps[i]);
+	free(ps);
+
+	PSPush(context.stack, result);
+}
+
+/**
+ * Funkcja do wykonania na stosie przy obsłudze polecenia ADD_N.
+ * Zdejmuje ze stosu @f$n@f$ wielomianów i kładzie ich sumę,
+ * policzoną jednym scalaniem wszystkich składników.
+ * param[in] context : kontekst wywołania polecenia
+ */
+static void executeAddMany(ExecutionContext context)
+{
+	executeMany(context, ExprAdd, PolyAddMany);
 }
 
 /**
@@ -160,11 +291,27 @@ static void executeMul(ExecutionContext context)
 {
 	if (context.stack->elems < 2)
 		return (void)(*context.errType = STACK_UNDERFLOW);
+	if (isLazy())
+	{
+		PolyExpr *p = PSPopExpr(context.stack);
+		PolyExpr *q = PSPopExpr(context.stack);
+		PSPushExpr(context.stack, ExprMul(p, q));
+		return;
+	}
 	Poly p = PSPop(context.stack);
 	Poly q = PSPop(context.stack);
-	PSPush(context.stack, PolyMul(&p, &q));
-	PolyDestroy(&p);
-	PolyDestroy(&q);
+	PSPush(context.stack, PolyMulOwn(&p, &q));
+}
+
+/**
+ * Funkcja do wykonania na stosie przy obsłudze polecenia MUL_N.
+ * Zdejmuje ze stosu @f$n@f$ wielomianów i kładzie ich iloczyn,
+ * policzony w zrównoważonym drzewie mnożeń.
+ * param[in] context : kontekst wywołania polecenia
+ */
+static void executeMulMany(ExecutionContext context)
+{
+	executeMany(context, ExprMul, PolyMulMany);
 }
 
 /**
@@ -188,9 +335,7 @@ static void executeSub(ExecutionContext context)
 		return (void)(*context.errType = STACK_UNDERFLOW);
 	Poly p = PSPop(context.stack);
 	Poly q = PSPop(context.stack);
-	PSPush(context.stack, PolySub(&p, &q));
-	PolyDestroy(&p);
-	PolyDestroy(&q);
+	PSPush(context.stack, PolySubOwn(&p, &q));
 }
 
 /**
@@ -237,7 +382,219 @@ static void executeAt(ExecutionContext context)
 	if (context.stack->elems < 1)
 		return (void)(*context.errType = STACK_UNDERFLOW);
 	Poly p = PSPop(context.stack);
-	PSPush(context.stack, PolyAtInPlace(&p, (poly_coeff_t)context.arg));
+	PSPush(context.stack, PolyAtInPlace(&p, CoeffReduce((poly_coeff_t)context.arg)));
+}
+
+/**
+ * Funkcja do wykonania na stosie przy obsłudze polecenia AT_MANY.
+ * Zastępuje wielomian z wierzchu stosu jego wartościami w kolejnych
+ * punktach, tak że na wierzchu jest wartość w ostatnim punkcie.
+ * param[in] context : kontekst wywołania polecenia
+ */
+static void executeAtMany(ExecutionContext context)
+{
+	if (context.stack->elems < 1)
+		return (void)(*context.errType = STACK_UNDERFLOW);
+	Poly p = PSPop(context.stack);
+	Poly *values = safeMalloc(context.argCount * sizeof(Poly));
+	reduceArgs(context.args, context.argCount);
+	PolyAtMany(&p, context.argCount, context.args, values);
+	for (size_t i = 0; i < context.argCount; i++)
+		PSPush(context.stack, values[i]);
+	PolyDestroy(&p);
+	free(values);
+}
+
+/**
+ * Funkcja do wykonania na stosie przy obsłudze polecenia EVAL.
+ * Wypisuje wartość wielomianu z wierzchu stosu w punkcie podanym
+ * jako lista wartości kolejnych zmiennych, nie zmieniając stosu.
+ * W trybie sprawdzanym wartość jest dokładna.
+ * param[in] context : kontekst wywołania polecenia
+ */
+static void executeEval(ExecutionContext context)
+{
+	if (context.stack->elems < 1)
+		return (void)(*context.errType = STACK_UNDERFLOW);
+	reduceArgs(context.args, context.argCount);
+	Poly value = PolyEvalExact(PSPeekPtr(context.stack), context.argCount, context.args);
+	PolyPrintln(&value);
+	PolyDestroy(&value);
+}
+
+/**
+ * To jest struktura programu skompilowanego poleceniem COMPILE.
+ * Stałe programu zależą od trybu arytmetyki, więc razem z nim jest
+ * trzymany wielomian, z którego program jest kompilowany na nowo
+ * po zmianie trybu.
+ */
+typedef struct CompiledPoly
+{
+	Poly source; ///< skompilowany wielomian w bieżącym trybie arytmetyki
+	PolyProg prog; ///< program wielomianu
+} CompiledPoly;
+
+/**
+ * Tablica programów skompilowanych poleceniem COMPILE.
+ * Indeks programu w tablicy jest jego uchwytem.
+ */
+static CompiledPoly *programs = NULL;
+
+/**
+ * Liczba skompilowanych programów.
+ */
+static size_t programCount = 0;
+
+/**
+ * Liczba programów, na które jest zaalokowana pamięć.
+ */
+static size_t programCapacity = 0;
+
+/**
+ * Funkcja do wykonania na stosie przy obsłudze polecenia COMPILE.
+ * Kompiluje wielomian z wierzchu stosu, nie zmieniając stosu,
+ * i wypisuje uchwyt programu.
+ * param[in] context : kontekst wywołania polecenia
+ */
+static void executeCompile(ExecutionContext context)
+{
+	if (context.stack->elems < 1)
+		return (void)(*context.errType = STACK_UNDERFLOW);
+	if (programCount == programCapacity)
+	{
+		programCapacity = programCapacity == 0 ? DEFAULT_SIZE : 2 * programCapacity;
+		safeRealloc((void**)&programs, programCapacity * sizeof(CompiledPoly));
+	}
+	Poly source = PolyClone(PSPeekPtr(context.stack));
+	programs[programCount] = (CompiledPoly){.source = source, .prog = ProgCompile(&source)};
+	printf("%zu\n", programCount++);
+}
+
+/**
+ * Funkcja do wykonania przy obsłudze polecenia RUN.
+ * Pierwszym argumentem jest uchwyt programu, a kolejne to punkty,
+ * z których każdy składa się z wartości wszystkich zmiennych programu.
+ * Wypisuje wartości wielomianu w kolejnych punktach. W trybie
+ * sprawdzanym wartości są liczone dokładnie z zapamiętanego wielomianu,
+ * bo program liczy na liczbach 64-bitowych.
+ * param[in] context : kontekst wywołania polecenia
+ */
+static void executeRun(ExecutionContext context)
+{
+	poly_coeff_t handle = context.args[0];
+	size_t count = context.argCount - 1;
+	if (handle < 0 || (size_t)handle >= programCount)
+		return (void)(*context.errType = WRONG_ARGUMENT);
+
+	const PolyProg *prog = &programs[handle].prog;
+	if (prog->vars == 0 ? count != 0 : count == 0 || count % prog->vars != 0)
+		return (void)(*context.errType = WRONG_ARGUMENT);
+
+	size_t n = prog->vars == 0 ? 1 : count / prog->vars;
+	reduceArgs(context.args + 1, count);
+	if (CoeffIsChecked())
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			Poly value = PolyEvalExact(&programs[handle].source, prog->vars,
+			                           context.args + 1 + i * prog->vars);
+			PolyPrintln(&value);
+			PolyDestroy(&value);
+		}
+		return;
+	}
+	poly_coeff_t *values = safeMalloc(n * sizeof(poly_coeff_t));
+	ProgEvalMany(prog, n, context.args + 1, values);
+	for (size_t i = 0; i < n; i++)
+		printf("%ld\n", values[i]);
+	free(values);
+}
+
+/**
+ * Sprowadza wszystkie wielomiany na stosie oraz wielomiany skompilowanych
+ * programów do bieżącego trybu arytmetyki i kompiluje programy na nowo.
+ * param[in,out] s : wskaźnik na stos
+ */
+static void reduceToMode(PolyStack *s)
+{
+	for (size_t i = 0; i < s->elems; i++)
+		s->stack[i] = PolyReduce(&s->stack[i]);
+	for (size_t i = 0; i < programCount; i++)
+	{
+		programs[i].source = PolyReduce(&programs[i].source);
+		ProgDestroy(&programs[i].prog);
+		programs[i].prog = ProgCompile(&programs[i].source);
+	}
+}
+
+/**
+ * Funkcja do wykonania na stosie przy obsłudze polecenia MOD.
+ * Ustawia moduł arytmetyki współczynników (0 oznacza zawijanie modulo
+ * @f$2^{64}@f$) i sprowadza do niego wszystkie wielomiany na stosie
+ * i skompilowane programy. Moduł może być złożony, byle był nieparzysty.
+ * param[in] context : kontekst wywołania polecenia
+ */
+static void executeMod(ExecutionContext context)
+{
+	unsigned long mod = (unsigned long)context.arg;
+	if (mod != 0 && (mod == 1 || mod % 2 == 0 || mod >= (unsigned long)POLY_MODULUS_LIMIT))
+		return (void)(*context.errType = WRONG_ARGUMENT);
+
+	PSForceAll(context.stack);
+	PolySetModulus((poly_coeff_t)mod);
+	reduceToMode(context.stack);
+}
+
+/**
+ * Funkcja do wykonania przy obsłudze polecenia CHECK.
+ * Włącza (1) lub wyłącza (0) dokładną arytmetykę współczynników.
+ * Po wyłączeniu wielkie liczby na stosie i w skompilowanych programach
+ * są sprowadzane do bieżącego trybu arytmetyki.
+ * param[in] context : kontekst wywołania polecenia
+ */
+static void executeCheck(ExecutionContext context)
+{
+	if (context.arg > 1)
+		return (void)(*context.errType = WRONG_ARGUMENT);
+	PSForceAll(context.stack);
+	PolySetChecked(context.arg == 1);
+	reduceToMode(context.stack);
+}
+
+/**
+ * Funkcja do wykonania przy obsłudze polecenia LAZY.
+ * Włącza (1) lub wyłącza (0) leniwe wyliczanie poleceń ADD, MUL i CLONE.
+ * Wyniki są wtedy liczone dopiero, gdy są potrzebne, co pozwala scalić
+ * ciąg dodawań w jedno scalanie i policzyć iloczyn razem z dodawaniem.
+ * param[in] context : kontekst wywołania polecenia
+ */
+static void executeLazy(ExecutionContext context)
+{
+	if (context.arg > 1)
+		return (void)(*context.errType = WRONG_ARGUMENT);
+	lazyMode = context.arg == 1;
+}
+
+/**
+ * Funkcja do wykonania na stosie przy obsłudze polecenia SAVE.
+ * Zapisuje cały stos do pliku w formacie migawki, nie zmieniając stosu.
+ * param[in] context : kontekst wywołania polecenia
+ */
+static void executeSave(ExecutionContext context)
+{
+	if (!PSSave(context.stack, context.path))
+		*context.errType = WRONG_ARGUMENT;
+}
+
+/**
+ * Funkcja do wykonania na stosie przy obsłudze polecenia LOAD.
+ * Kładzie na stos wielomiany z pliku migawki zapisanego poleceniem SAVE.
+ * param[in] context : kontekst wywołania polecenia
+ */
+static void executeLoad(ExecutionContext context)
+{
+	if (!PSLoad(context.stack, context.path))
+		*context.errType = WRONG_ARGUMENT;
 }
 
 /**
@@ -251,6 +608,25 @@ static void executePrint(ExecutionContext context)
 	PolyPrintln(PSPeekPtr(context.stack));
 }
 
+/**
+ * Funkcja do wykonania na stosie przy obsłudze polecenia PRINT_FILE.
+ * Dopisuje wielomian z wierzchu stosu na koniec podanego pliku.
+ * param[in] context : kontekst wywołania polecenia
+ */
+static void executePrintFile(ExecutionContext context)
+{
+	if (context.stack->elems < 1)
+		return (void)(*context.errType = STACK_UNDERFLOW);
+	int fd = open(context.path, O_WRONLY | O_CREAT | O_APPEND, 0666);
+	if (fd < 0)
+		return (void)(*context.errType = WRONG_ARGUMENT);
+	fflush(stdout);
+	if (!PolyPrintlnFd(PSPeekPtr(context.stack), fd))
+		*context.errType = WRONG_ARGUMENT;
+	if (close(fd) != 0)
+		*context.errType = WRONG_ARGUMENT;
+}
+
 /**
  * Funkcja do wykonania na stosie przy obsłudze polecenia POP.
  * param[in] context : kontekst wywołania polecenia
@@ -259,8 +635,7 @@ static void executePop(ExecutionContext context)
 {
 	if (context.stack->elems < 1)
 		return (void)(*context.errType = STACK_UNDERFLOW);
-	PolyDestroy(PSPeekPtr(context.stack));
-	PSPop(context.stack);
+	PSDrop(context.stack);
 }
 
 /**
@@ -299,6 +674,29 @@ bool checkEOF()
 	return EOF_FLAG;
 }
 
+/**
+ * Początkowy rozmiar bufora wejścia w bajtach.
+ */
+#define INPUT_BUFFER_SIZE (1 << 20)
+
+/**
+ * Struktura buforowanego wejścia standardowego.
+ * Nieprzetworzone dane wejścia zajmują bajty bufora od @p begin do @p end.
+ */
+typedef struct InputBuffer
+{
+	char *data; ///< bufor z jednym zapasowym bajtem na końcu
+	size_t size; ///< pojemność bufora bez zapasowego bajtu
+	size_t begin; ///< indeks pierwszego nieprzetworzonego bajtu
+	size_t end; ///< indeks za ostatnim wczytanym bajtem
+	bool eof; ///< czy funkcja read zgłosiła koniec wejścia?
+} InputBuffer;
+
+/**
+ * Bufor wejścia standardowego.
+ */
+static InputBuffer input = {NULL, 0, 0, 0, false};
+
 /**
  * Stwierdza, czy znak jest cyfrą.
  * @param[in] c : znak
@@ -351,21 +749,33 @@ static long double readCoeffAsLDbl(char *firstChar, char **nextChar, bool *errFl
  */
 static CommandInfo const commandList[] =
 {
-	{"ZERO", executeZero, NULL, ""},
-	{"SUB", executeSub, NULL, ""},
-	{"PRINT", executePrint, NULL, ""},
-	{"POP", executePop, NULL, ""},
-	{"NEG", executeNeg, NULL, ""},
-	{"MUL", executeMul, NULL, ""},
-	{"IS_ZERO", executeIsZero, NULL, ""},
-	{"IS_EQ", executeIsEq, NULL, ""},
-	{"IS_COEFF", executeIsCoeff, NULL, ""},
-	{"DEG_BY", executeDegBy, readArgULongAsLDbl, "DEG BY WRONG VARIABLE"},
-	{"DEG", executeDeg, NULL, ""},
-	{"COMPOSE", executeCompose, readArgULongAsLDbl, "COMPOSE WRONG PARAMETER"},
-	{"CLONE", executeClone, NULL, ""},
-	{"AT", executeAt, readCoeffAsLDbl, "AT WRONG VALUE"},
-	{"ADD", executeAdd, NULL, ""}
+	{"ZERO", executeZero, NULL, "", ARG_SINGLE},
+	{"SUB", executeSub, NULL, "", ARG_SINGLE},
+	{"PRINT_FILE", executePrintFile, NULL, "PRINT FILE WRONG FILE", ARG_PATH},
+	{"PRINT", executePrint, NULL, "", ARG_SINGLE},
+	{"POP", executePop, NULL, "", ARG_SINGLE},
+	{"NEG", executeNeg, NULL, "", ARG_SINGLE},
+	{"MUL_N", executeMulMany, readArgULongAsLDbl, "MUL N WRONG PARAMETER", ARG_SINGLE},
+	{"MUL", executeMul, NULL, "", ARG_SINGLE},
+	{"IS_ZERO", executeIsZero, NULL, "", ARG_SINGLE},
+	{"IS_EQ", executeIsEq, NULL, "", ARG_SINGLE},
+	{"IS_COEFF", executeIsCoeff, NULL, "", ARG_SINGLE},
+	{"DEG_BY", executeDegBy, readArgULongAsLDbl, "DEG BY WRONG VARIABLE", ARG_SINGLE},
+	{"DEG", executeDeg, NULL, "", ARG_SINGLE},
+	{"COMPOSE", executeCompose, readArgULongAsLDbl, "COMPOSE WRONG PARAMETER", ARG_SINGLE},
+	{"CLONE", executeClone, NULL, "", ARG_SINGLE},
+	{"AT_MANY", executeAtMany, NULL, "AT MANY WRONG VALUE", ARG_LIST},
+	{"AT", executeAt, readCoeffAsLDbl, "AT WRONG VALUE", ARG_SINGLE},
+	{"ADD_N", executeAddMany, readArgULongAsLDbl, "ADD N WRONG PARAMETER", ARG_SINGLE},
+	{"ADD", executeAdd, NULL, "", ARG_SINGLE},
+	{"EVAL", executeEval, NULL, "EVAL WRONG VALUE", ARG_LIST},
+	{"COMPILE", executeCompile, NULL, "", ARG_SINGLE},
+	{"RUN", executeRun, NULL, "RUN WRONG VALUE", ARG_LIST},
+	{"MOD", executeMod, readArgULongAsLDbl, "MOD WRONG VALUE", ARG_SINGLE},
+	{"CHECK", executeCheck, readArgULongAsLDbl, "CHECK WRONG VALUE", ARG_SINGLE},
+	{"LAZY", executeLazy, readArgULongAsLDbl, "LAZY WRONG VALUE", ARG_SINGLE},
+	{"SAVE", executeSave, NULL, "SAVE WRONG FILE", ARG_PATH},
+	{"LOAD", executeLoad, NULL, "LOAD WRONG FILE", ARG_PATH}
 };
 
 /**
@@ -379,21 +789,144 @@ static CommandInfo const commandList[] =
 #define ERROR_COMMAND NO_OF_COMMANDS
 
 /**
- * Tablica długości nazw poleceń.
+ * Liczba znaków, z których mogą się składać nazwy poleceń:
+ * wielkie litery i podkreślnik.
+ */
+#define TRIE_ALPHABET 27
+
+/**
+ * Największa liczba węzłów drzewa nazw poleceń.
  */
-static size_t commandNameLengths[NO_OF_COMMANDS] = {};
+#define TRIE_MAX_NODES 256
+
+/**
+ * Węzeł drzewa trie nazw poleceń.
+ */
+typedef struct CommandTrieNode
+{
+	/**
+	 * Indeksy synów dla kolejnych znaków alfabetu lub 0, jeżeli syna nie ma.
+	 * Korzeń ma indeks 0 i nie jest niczyim synem.
+	 */
+	uint8_t next[TRIE_ALPHABET];
+	/**
+	 * Numer polecenia, którego nazwa kończy się w węźle,
+	 * lub ERROR_COMMAND.
+	 */
+	uint8_t command;
+} CommandTrieNode;
+
+/**
+ * Drzewo trie nazw poleceń, zbudowane przez PolyUIInit.
+ */
+static CommandTrieNode commandTrie[TRIE_MAX_NODES];
+
+/**
+ * Liczba węzłów drzewa nazw poleceń.
+ */
+static size_t commandTrieSize = 0;
+
+/**
+ * Zwraca numer znaku w alfabecie nazw poleceń.
+ * @param[in] c : znak
+ * @return : numer znaku lub TRIE_ALPHABET, jeżeli znak do alfabetu nie należy
+ */
+static size_t trieSymbol(char c)
+{
+	if ('A' <= c && c <= 'Z')
+		return (size_t)(c - 'A');
+	return c == '_' ? TRIE_ALPHABET - 1 : TRIE_ALPHABET;
+}
 
 void PolyUIInit()
 {
-	for (size_t i = 0; i < NO_OF_COMMANDS; i++)
-		commandNameLengths[i] = strlen(commandList[i].cmndName);
+	static_assert(NO_OF_COMMANDS < UINT8_MAX, "numery poleceń muszą się mieścić w węźle");
+	commandTrieSize = 1;
+	memset(commandTrie, 0, sizeof(commandTrie));
+	commandTrie[0].command = ERROR_COMMAND;
+
+	for (size_t op = 0; op < NO_OF_COMMANDS; op++)
+	{
+		size_t node = 0;
+		for (const char *c = commandList[op].cmndName; *c != '\0'; c++)
+		{
+			size_t symbol = trieSymbol(*c);
+			assert(symbol < TRIE_ALPHABET);
+			if (commandTrie[node].next[symbol] == 0)
+			{
+				assert(commandTrieSize < TRIE_MAX_NODES);
+				commandTrie[commandTrieSize].command = ERROR_COMMAND;
+				commandTrie[node].next[symbol] = (uint8_t)commandTrieSize++;
+			}
+			node = commandTrie[node].next[symbol];
+		}
+		commandTrie[node].command = (uint8_t)op;
+	}
+}
+
+void PolyUIDestroy()
+{
+	for (size_t i = 0; i < programCount; i++)
+	{
+		PolyDestroy(&programs[i].source);
+		ProgDestroy(&programs[i].prog);
+	}
+	free(programs);
+	programs = NULL;
+	programCount = programCapacity = 0;
+	lazyMode = false;
+	free(input.data);
+	input = (InputBuffer){NULL, 0, 0, 0, false};
+}
+
+/**
+ * Dokłada do bufora wejścia kolejny blok danych ze standardowego wejścia.
+ * Przesuwa nieprzetworzone dane na początek bufora, a jeżeli zajmują
+ * cały bufor, to go powiększa.
+ */
+static void fillInput()
+{
+	if (input.data == NULL)
+	{
+		input.size = INPUT_BUFFER_SIZE;
+		input.data = safeMalloc(input.size + 1);
+	}
+	if (input.begin > 0)
+	{
+		memmove(input.data, input.data + input.begin, input.end - input.begin);
+		input.end -= input.begin;
+		input.begin = 0;
+	}
+	if (input.end == input.size)
+	{
+		input.size *= 2;
+		safeRealloc((void**)&input.data, input.size + 1);
+	}
+
+	ssize_t bytes;
+	do
+		bytes = read(STDIN_FILENO, input.data + input.end, input.size - input.end);
+	while (bytes < 0 && errno == EINTR);
+
+	if (bytes <= 0)
+		input.eof = true;
+	else
+		input.end += (size_t)bytes;
 }
 
+/*
+Wyjaśnienie implementacji:
+Wejście jest czytane dużymi blokami funkcją read, a końców wierszy
+	szukam funkcją memchr, zaczynając od miejsca, w którym skończyło się
+	poprzednie szukanie. Znak nowej linii zamieniam w buforze na znak
+	'\0', więc wiersz nie jest kopiowany. Ostatni wiersz wejścia może nie
+	mieć znaku nowej linii, wtedy '\0' trafia do zapasowego bajtu bufora.
+*/
 /**
  * Zwraca stringa z jednym wierszem z wejścia.
  * Ustawia wartość wskazanej zmiennej na liczbę znaków w wierszu.
- * Ignoruje komentarze i podnosi wskazaną flagę jeżeli wczytany
- * wiersz jest komentarzem.
+ * Podnosi wskazaną flagę, jeżeli wczytany wiersz jest komentarzem.
+ * Wiersz jest fragmentem bufora wejścia, ważnym do następnego wywołania.
  * @param[out] charsRead : wskaźnik na zmienną, w której ma być
  * zapisana liczba znaków w wierszu.
  * @param[out] isComment : wskaźnik na flagę oznaczającą wczytanie komentarza.
@@ -401,34 +934,64 @@ void PolyUIInit()
  */
 static char *readLine(size_t *charsRead, bool *isComment)
 {
-	*charsRead = 0;
-	*isComment = false;
-	size_t bufferSize = DEFAULT_SIZE;
-	char *buffer, newChar = '\0';
-	buffer = (char*)safeMalloc(bufferSize * sizeof(char));
-
-	while (scanf("%c", &newChar) != -1 && newChar != '\n')
+	size_t scanned = 0;
+	char *newline = NULL;
+	while (input.data == NULL ||
+	       (newline = memchr(input.data + input.begin + scanned, '\n',
+	                         input.end - input.begin - scanned)) == NULL)
 	{
-		if (!*isComment)
-		{
-			if (*charsRead == bufferSize)
-			{
-				bufferSize *= 2;
-				safeRealloc((void**)&buffer, bufferSize * sizeof(char));
-			}
-
-			buffer[(*charsRead)++] = newChar; // Fun fact: bez nawiasów jest problem.
-
-			*isComment = (buffer[0] == '#');
-		}
+		if (input.eof)
+			break;
+		scanned = input.end - input.begin;
+		fillInput();
 	}
 
-	if (newChar != '\n')
+	char *line = input.data + input.begin;
+	*charsRead = newline != NULL ? (size_t)(newline - line) : input.end - input.begin;
+	*isComment = (*charsRead > 0 && line[0] == '#');
+	line[*charsRead] = '\0';
+	input.begin += *charsRead + (newline != NULL);
+
+	if (newline == NULL)
 		EOF_FLAG = true;
 
-	safeRealloc((void**)&buffer, (*charsRead + 1) * sizeof(char));
-	buffer[*charsRead] = '\0';
-	return buffer;
+	return line;
+}
+
+/*
+Wyjaśnienie implementacji:
+Cyfry czytam ręcznie, porównując przed każdym krokiem dotychczasową
+	wartość z ograniczeniem, więc przekroczenie zakresu jest wykrywane
+	bez strtol i errno. Po przekroczeniu dalsze cyfry są tylko pomijane.
+*/
+/**
+ * Wczytuje ciąg cyfr dziesiętnych jako liczbę bez znaku.
+ * @param[in] firstChar : pierwszy znak liczby
+ * @param[out] nextChar : wskaźnik na wskaźnik na znak 
+ * w wierszu występujący po ostatniej cyfrze
+ * @param[in] limit : największa dopuszczalna wartość, co najmniej 9
+ * @param[out] errFlag : wskaźnik na flagę błędu, podnoszoną, gdy nie ma
+ * żadnej cyfry lub liczba przekracza @p limit
+ * @return : wczytana liczba
+ */
+static unsigned long scanDigits(char *firstChar, char **nextChar,
+                                unsigned long limit, bool *errFlag)
+{
+	unsigned long result = 0;
+	bool overflow = false;
+	char *c = firstChar;
+	for (; isDigit(*c); c++)
+	{
+		unsigned long digit = (unsigned long)(*c - '0');
+		if (result > (limit - digit) / 10)
+			overflow = true;
+		else
+			result = 10 * result + digit;
+	}
+
+	*nextChar = c;
+	*errFlag = (overflow || c == firstChar);
+	return result;
 }
 
 /**
@@ -441,12 +1004,11 @@ static char *readLine(size_t *charsRead, bool *isComment)
  */
 static poly_coeff_t readCoeff(char *firstChar, char **nextChar, bool *errFlag)
 {
-	errno = 0;
-	poly_coeff_t result = strtol(firstChar, nextChar, 10);
-
-	*errFlag = (errno != 0 || !isDigitMinus(*firstChar));
+	bool negative = (*firstChar == '-');
+	unsigned long limit = negative ? (unsigned long)LONG_MAX + 1 : (unsigned long)LONG_MAX;
+	unsigned long result = scanDigits(firstChar + negative, nextChar, limit, errFlag);
 
-	return result;
+	return negative ? (poly_coeff_t)(0 - result) : (poly_coeff_t)result;
 }
 
 /**
@@ -472,13 +1034,7 @@ static long double readCoeffAsLDbl(char *firstChar, char **nextChar, bool *errFl
  */
 static poly_exp_t readExp(char *firstChar, char **nextChar, bool *errFlag)
 {
-	errno = 0;
-	long result = strtol(firstChar, nextChar, 10);
-
-	*errFlag = (errno != 0 || !isDigit(*firstChar) ||
-	            POLY_EXP_T_MAX < result);
-
-	return (poly_exp_t)result;
+	return (poly_exp_t)scanDigits(firstChar, nextChar, POLY_EXP_T_MAX, errFlag);
 }
 
 /**
@@ -491,12 +1047,7 @@ static poly_exp_t readExp(char *firstChar, char **nextChar, bool *errFlag)
  */
 static unsigned long readArgULong(char *firstChar, char **nextChar, bool *errFlag)
 {
-	errno = 0;
-	unsigned long result = strtoul(firstChar, nextChar, 10);
-
-	*errFlag = (errno != 0 || !isDigit(*firstChar));
-
-	return result;
+	return scanDigits(firstChar, nextChar, ULONG_MAX, errFlag);
 }
 
 /**
@@ -512,6 +1063,37 @@ static long double readArgULongAsLDbl(char *firstChar, char **nextChar, bool *er
 	return (long double)readArgULong(firstChar, nextChar, errFlag);
 }
 
+/**
+ * Zwraca niepustą listę stałych typu poly_coeff_t zapisanych w wierszu
+ * i oddzielonych pojedynczymi spacjami.
+ * @param[in] firstChar : pierwszy znak czytanego wiersza
+ * @param[out] nextChar : wskaźnik na wskaźnik na znak 
+ * w wierszu występujący po ostatnim wczytanym znaku
+ * @param[out] count : wskaźnik na liczbę wczytanych stałych
+ * @param[out] errFlag : wskaźnik na flagę błędu
+ * @return : tablica wczytanych stałych zaalokowana funkcją safeMalloc
+ */
+static poly_coeff_t *readCoeffList(char *firstChar, char **nextChar,
+                                   size_t *count, bool *errFlag)
+{
+	size_t bufferSize = DEFAULT_SIZE;
+	poly_coeff_t *result = safeMalloc(bufferSize * sizeof(poly_coeff_t));
+	*count = 0;
+
+	do
+	{
+		if (*count == bufferSize)
+		{
+			bufferSize *= 2;
+			safeRealloc((void**)&result, bufferSize * sizeof(poly_coeff_t));
+		}
+		result[(*count)++] = readCoeff(firstChar, nextChar, errFlag);
+		firstChar = *nextChar + 1;
+	} while (!*errFlag && **nextChar == ' ');
+
+	return result;
+}
+
 static Poly readPoly(char *firstChar, char **nextChar, ErrorType *errType);
 
 /**
@@ -552,6 +1134,14 @@ static Mono readMono(char *firstChar, char **nextChar, ErrorType *errType)
 	return result;
 }
 
+/*
+Wyjaśnienie implementacji:
+Jednomiany czytam od razu do tablicy z puli i w trakcie czytania
+	sprawdzam, czy ich wykładniki rosną ściśle, a współczynniki są
+	niezerowe. Tak jest zapisana większość wejścia i wtedy tablica staje
+	się tablicą wielomianu bez sortowania i kopiowania. W przeciwnym
+	przypadku jednomiany sumuje PolyAddMonos.
+*/
 /**
  * Zwraca wielomian zapisany w wierszu.
  * @param[in] firstChar : pierwszy znak czytanego wiersza
@@ -562,77 +1152,85 @@ static Mono readMono(char *firstChar, char **nextChar, ErrorType *errType)
  */
 static Poly readPoly(char *firstChar, char **nextChar, ErrorType *errType)
 {
-	Poly result = PolyZero();
-
 	if (isDigitMinus(*firstChar))
 	{
 		bool errFlag = false;
-		result.arr = NULL;
-		result.coeff = readCoeff(firstChar, nextChar, &errFlag);
+		Poly result = PolyFromCoeff(CoeffReduce(readCoeff(firstChar, nextChar, &errFlag)));
 		
 		if (errFlag)
 			*errType = WRONG_POLY;
+		return result;
 	}
-	else
-	{
-		size_t noOfMonos = 0, bufferSize = DEFAULT_SIZE;
-		Mono *monoBuffer = (Mono*)safeMalloc(bufferSize * sizeof(Mono));
 
-		monoBuffer[noOfMonos++] = readMono(firstChar, nextChar, errType);
+	size_t noOfMonos = 0, bufferSize = DEFAULT_SIZE;
+	Mono *monoBuffer = poolMalloc(bufferSize * sizeof(Mono));
+	bool canonical = true;
 
-		while (**nextChar == '+' && *errType == NO_ERROR)
-		{
+	do
+	{
+		if (noOfMonos > 0)
 			firstChar = *nextChar + 1;
-			if (noOfMonos == bufferSize)
-			{
-				bufferSize *= 2;
-				safeRealloc((void**)&monoBuffer, bufferSize * sizeof(Mono));
-			}
-			monoBuffer[noOfMonos++] = readMono(firstChar, nextChar, errType);
+		if (noOfMonos == bufferSize)
+		{
+			bufferSize *= 2;
+			poolRealloc((void**)&monoBuffer, bufferSize * sizeof(Mono));
 		}
+		Mono *mono = &monoBuffer[noOfMonos++];
+		*mono = readMono(firstChar, nextChar, errType);
+		canonical = canonical && !PolyIsZero(&mono->p) &&
+		            (noOfMonos == 1 || (mono - 1)->exp < mono->exp);
+	} while (*errType == NO_ERROR && **nextChar == '+');
 
-		safeRealloc((void**)&monoBuffer, noOfMonos * sizeof(Mono));
-
-		result = PolyAddMonos(noOfMonos, monoBuffer);
-		free(monoBuffer);
+	if (*errType != NO_ERROR)
+	{
+		for (size_t i = 0; i < noOfMonos; i++)
+			MonoDestroy(&monoBuffer[i]);
+		poolFree(monoBuffer);
+		return PolyZero();
 	}
 
-	return result;
-}
-
-/**
- * Sprawdza czy string jest prefiksem innego stringa.
- * @param[in] prefix : string kandydujący na bycie prefiksem
- * @param[in] line : string, którego prefiksem ma być `prefiks`
- * @return : `true`, jeżeli `prefiks` jest prefiksem `line`a,
- * albo `false` w przeciwnym przypadku.
- */
-static bool isPrefix(const char *prefix, const char *line)
-{
-	while (*prefix != '\0' && *line != '\0')
+	if (canonical && !(noOfMonos == 1 && monoBuffer[0].exp == 0 &&
+	                   PolyIsCoeff(&monoBuffer[0].p)))
 	{
-		if (*prefix != *line)
-			return false;
-		prefix++;
-		line++;
+		poolRealloc((void**)&monoBuffer, noOfMonos * sizeof(Mono));
+		return (Poly){.size = noOfMonos, .arr = monoBuffer};
 	}
 
-	return (*prefix == '\0' || *line != '\0');
+	Poly result = PolyAddMonos(noOfMonos, monoBuffer);
+	poolFree(monoBuffer);
+	return result;
 }
 
+/*
+Wyjaśnienie implementacji:
+Idę po drzewie trie znak po znaku wiersza i zapamiętuję ostatni węzeł,
+	w którym kończy się nazwa polecenia. Rozpoznane polecenie ma więc
+	najdłuższą nazwę będącą prefiksem wiersza, niezależnie od kolejności
+	w tablicy poleceń, a długość nazwy wynika z samego przejścia.
+*/
 /**
  * Rozpoznaje rodzaj polecenia na podstawie stringa.
- * @param[in] line : string, którego poleceni ma być rozpoznane
+ * @param[in] line : string, którego polecenie ma być rozpoznane
+ * @param[out] nameLength : długość nazwy rozpoznanego polecenia
  * @return : numer operacji do przeprowadzenia na stosie
  * odpowiadający wykrytemu poleceniu, lub wartość ERROR_COMMAND
  * w przypadku, gdy żadne polecenie nie pasuje.
  */
-static size_t detectCommand(const char *line)
+static size_t detectCommand(const char *line, size_t *nameLength)
 {
-	size_t op;
-	for (op = 0; op < ERROR_COMMAND; op++)
-		if (isPrefix(commandList[op].cmndName, line))
+	size_t op = ERROR_COMMAND, node = 0, symbol;
+	*nameLength = 0;
+	for (const char *c = line; (symbol = trieSymbol(*c)) < TRIE_ALPHABET; c++)
+	{
+		node = commandTrie[node].next[symbol];
+		if (node == 0)
 			break;
+		if (commandTrie[node].command != ERROR_COMMAND)
+		{
+			op = commandTrie[node].command;
+			*nameLength = (size_t)(c - line) + 1;
+		}
+	}
 	return op;
 }
 
@@ -660,45 +1258,54 @@ static void handlePoly(PolyStack *s, char *line,
 }
 
 /**
- * Wczytuje polecenie z wejścia standardowego i je parse'uje oraz
- * wykonuje, jeżeli wczytanie odbędzie się bez błędu. Zwraca również
- * rodzaj wykrytej operacji i rodzaj błędu w celu obsługi błędów.
- * param[in] s : wskaźnik na stos
+ * Rozpoznaje polecenie zapisane w wierszu i wczytuje jego argumenty do
+ * kontekstu wywołania. Wykryty błąd zapisuje we fladze błędu kontekstu.
+ * Lista argumentów jest alokowana i trzeba ją zwolnić, także po błędzie,
+ * a ścieżka wskazuje na fragment wiersza.
  * param[in] line : string z wejścia
  * param[in] noOfChars : liczba znaków w wierszu
- * param[out] errType : wskaźnik na flagę błędu
- * param[out] op : wskaźnik na rodzaj wykrytej operacji
+ * param[in,out] context : kontekst wywołania polecenia
+ * @return : numer wykrytego polecenia lub ERROR_COMMAND
  */
-static void handleCommand(PolyStack *s, char *line, size_t noOfChars,
-	                        ErrorType *errType, size_t *op)
+static size_t parseCommand(char *line, size_t noOfChars, ExecutionContext *context)
 {
-	*op = detectCommand(line);
+	size_t nameLength;
+	size_t op = detectCommand(line, &nameLength);
+	ErrorType *errType = context->errType;
 
-	if (*op == ERROR_COMMAND)
+	if (op == ERROR_COMMAND)
 	{
 		*errType = WRONG_COMMAND;
-		return;
+		return op;
 	}
 
-	char *firstChar = line + commandNameLengths[*op];
+	char *firstChar = line + nameLength;
 	char *nextChar = firstChar;
 	bool errFlag = false;
-	ExecutionContext context = {s, 0, errType};
 
-	if (commandList[*op].readArgFunc != NULL)
+	if (commandList[op].readArgFunc != NULL || commandList[op].argKind != ARG_SINGLE)
 	{
-		if (isBadWhite(*firstChar) || commandNameLengths[*op] == noOfChars)
+		if (isBadWhite(*firstChar) || nameLength == noOfChars)
 		{
 			*errType = WRONG_ARGUMENT;
-			return;
+			return op;
 		}
 		if (*firstChar++ != ' ')
 		{
 			*errType = WRONG_COMMAND;
-			return;
+			return op;
 		}
 
-		context.arg = commandList[*op].readArgFunc(firstChar, &nextChar, &errFlag);
+		if (commandList[op].argKind == ARG_LIST)
+			context->args = readCoeffList(firstChar, &nextChar, &context->argCount, &errFlag);
+		else if (commandList[op].argKind == ARG_PATH)
+		{
+			context->path = firstChar;
+			nextChar = line + noOfChars;
+			errFlag = (*firstChar == '\0');
+		}
+		else
+			context->arg = commandList[op].readArgFunc(firstChar, &nextChar, &errFlag);
 
 		if (errFlag || nextChar != line + noOfChars)
 			*errType = WRONG_ARGUMENT;
@@ -708,9 +1315,46 @@ static void handleCommand(PolyStack *s, char *line, size_t noOfChars,
 		if (*firstChar != '\0' || nextChar != line + noOfChars)
 			*errType = WRONG_COMMAND;
 	}
+	return op;
+}
+
+/**
+ * Wykonuje poprawnie wczytane polecenie.
+ * param[in] op : numer polecenia
+ * param[in] context : kontekst wywołania polecenia
+ */
+static void executeCommand(size_t op, ExecutionContext context)
+{
+	// Polecenie, w trakcie którego współczynnik się przepełnił albo wielka
+	// liczba przekroczyła limit, zostaje wykonane do końca, ale jest
+	// zgłaszane jako błąd.
+	commandList[op].cmndFunc(context);
+	bool overflow = PolyTakeOverflow();
+	if (PolyTakeTooBig() && *context.errType == NO_ERROR)
+		*context.errType = COEFF_TOO_BIG;
+	if (overflow && *context.errType == NO_ERROR)
+		*context.errType = COEFF_OVERFLOW;
+}
+
+/**
+ * Wczytuje polecenie z wejścia standardowego i je parse'uje oraz
+ * wykonuje, jeżeli wczytanie odbędzie się bez błędu. Zwraca również
+ * rodzaj wykrytej operacji i rodzaj błędu w celu obsługi błędów.
+ * param[in] s : wskaźnik na stos
+ * param[in] line : string z wejścia
+ * param[in] noOfChars : liczba znaków w wierszu
+ * param[out] errType : wskaźnik na flagę błędu
+ * param[out] op : wskaźnik na rodzaj wykrytej operacji
+ */
+static void handleCommand(PolyStack *s, char *line, size_t noOfChars,
+	                        ErrorType *errType, size_t *op)
+{
+	ExecutionContext context = {s, 0, NULL, 0, NULL, errType};
+	*op = parseCommand(line, noOfChars, &context);
 
 	if (*errType == NO_ERROR)
-		commandList[*op].cmndFunc(context);
+		executeCommand(*op, context);
+	free(context.args);
 }
 
 /**
@@ -735,7 +1379,8 @@ static void printError(ErrorType errType, size_t op, int lineNumber)
 /*
 Wyjaśnienie implementacji:
 Funkcja wczytuje wiersz, jeżeli jest pusty lub jest komentarzem,
-	to zwalnia pamięć i kończy działanie.
+	to kończy działanie. Wiersz jest fragmentem bufora wejścia, więc nie
+	trzeba go zwalniać.
 Jeżeli wiersz okazuje się zaczynać literą, to wykrywany jest rodzaj
 	polecenia o który chodzi. Jeżeli polecenie jest inne niż DEG_BY lub AT,
 	to jest ono wykonywane, zwracając uwagę jedynie na Stack Underflow i prosty
@@ -743,7 +1388,7 @@ Jeżeli wiersz okazuje się zaczynać literą, to wykrywany jest rodzaj
 Jeżeli polecenie przyjmuje argument, to uważnie są sprawdzane kolejne znaki
 	w celu zwrócenia, jeśli wystąpi, odpowiedniego komunikatu o błędzie. Po
 	przeczytaniu argumentu sprawdzane jest czy
-		1) nie był spoza przedziału (sprawdzanie errno i pierwszego znaku)
+		1) nie był spoza przedziału (sprawdzane przy czytaniu cyfr)
 		2) był w ogóle wczytany
 		3) nic nie zostało po argumencie
 Jeżeli pierwszym znakiem nie jest litera, to czytany jest wielomian
@@ -761,10 +1406,7 @@ void handleLine(PolyStack *s)
 	char *line = readLine(&charsRead, &isComment);
 
 	if (charsRead == 0 || isComment)
-	{
-		free(line);
 		return;
-	}
 
 	if (isLetter(line[0]))
 		handleCommand(s, line, charsRead, &errType, &op);
@@ -773,6 +1415,355 @@ void handleLine(PolyStack *s)
 
 	if (errType != NO_ERROR)
 		printError(errType, op, lineNumber);
+}
+/**
+ * Kod instrukcji skryptu, która kładzie na stos literał wielomianowy.
+ */
+#define LITERAL_COMMAND (NO_OF_COMMANDS + 1)
+
+/**
+ * Kod instrukcji skryptu, która czyta wielomian z zapisanego tekstu
+ * dopiero w trakcie wykonania.
+ */
+#define TEXT_POLY_COMMAND (NO_OF_COMMANDS + 2)
+
+/**
+ * Mnożnik funkcji skrótu tekstu.
+ */
+#define HASH_MULTIPLIER 0x9E3779B97F4A7C15ULL
+
+/**
+ * Liczy 64-bitowy skrót ciągu bajtów, czytając je po osiem naraz.
+ * @param[in] data : bajty
+ * @param[in] length : liczba bajtów
+ * @param[in] seed : wartość początkowa skrótu
+ * @return : skrót
+ */
+static uint64_t hashBytes(const char *data, size_t length, uint64_t seed)
+{
+	uint64_t hash = seed ^ (length * HASH_MULTIPLIER), word;
+	size_t i = 0;
+	for (; i + 8 <= length; i += 8)
+	{
+		memcpy(&word, data + i, 8);
+		hash = (hash ^ word) * HASH_MULTIPLIER;
+		hash ^= hash >> 29;
+	}
+	word = 0;
+	memcpy(&word, data + i, length - i);
+	hash = (hash ^ word) * HASH_MULTIPLIER;
+	return hash ^ (hash >> 32);
+}
+
+/**
+ * Element tablicy wierszy już skompilowanych.
+ */
+typedef struct InternEntry
+{
+	const char *text; ///< tekst wiersza w buforze wejścia lub NULL dla pustego miejsca
+	size_t length; ///< długość wiersza
+	uint64_t hash; ///< skrót wiersza
+	ScriptInstr instr; ///< instrukcja skompilowana z wiersza
+} InternEntry;
+
+/**
+ * Tablica z haszowaniem otwartym wierszy już skompilowanych.
+ */
+typedef struct InternTable
+{
+	InternEntry *entries; ///< tablica elementów
+	size_t capacity; ///< liczba miejsc, potęga dwójki
+	size_t count; ///< liczba zajętych miejsc
+} InternTable;
+
+/**
+ * Szuka w tablicy miejsca wiersza: elementu z tym wierszem
+ * lub pustego miejsca, na które wiersz należy wstawić.
+ * @param[in] table : tablica
+ * @param[in] text : wiersz
+ * @param[in] length : długość wiersza
+ * @param[in] hash : skrót wiersza
+ * @return : wskaźnik na miejsce w tablicy
+ */
+static InternEntry *internFind(const InternTable *table, const char *text,
+                               size_t length, uint64_t hash)
+{
+	size_t mask = table->capacity - 1;
+	for (size_t i = (size_t)hash & mask;; i = (i + 1) & mask)
+	{
+		InternEntry *entry = &table->entries[i];
+		if (entry->text == NULL || (entry->hash == hash && entry->length == length &&
+		                            memcmp(entry->text, text, length) == 0))
+			return entry;
+	}
+}
+
+/**
+ * Wstawia do tablicy skompilowany wiersz, którego w niej nie ma,
+ * i podwaja tablicę, gdy jest zajęta w połowie.
+ * @param[in,out] table : tablica
+ * @param[in] entry : element z wierszem i jego instrukcją
+ */
+static void internInsert(InternTable *table, InternEntry entry)
+{
+	if (2 * (table->count + 1) > table->capacity)
+	{
+		InternTable larger = {NULL, table->capacity == 0 ? DEFAULT_SIZE : 2 * table->capacity, 0};
+		larger.entries = safeMalloc(larger.capacity * sizeof(InternEntry));
+		for (size_t i = 0; i < larger.capacity; i++)
+			larger.entries[i].text = NULL;
+		for (size_t i = 0; i < table->capacity; i++)
+			if (table->entries[i].text != NULL)
+				internInsert(&larger, table->entries[i]);
+		free(table->entries);
+		*table = larger;
+	}
+	*internFind(table, entry.text, entry.length, entry.hash) = entry;
+	table->count++;
+}
+
+/*
+Wyjaśnienie implementacji:
+Wielomiany są parsowane w trybie sprawdzanym, w którym nie ma jeszcze
+	modułu, a współczynniki są sumowane tylko wtedy, gdy jednomiany nie są
+	podane w postaci kanonicznej. Jeżeli żadna suma nie wyszła poza typ
+	poly_coeff_t, czyli nie powstała wielka liczba ani przepełnienie, to
+	w trybie modularnym wczytanie tekstu dałoby ten sam wielomian co
+	sprowadzenie literału do modułu, więc wystarcza PolyReduce w trakcie
+	wykonania. W przeciwnym przypadku wynik zależy od trybu, w którym
+	wiersz zostanie wykonany, więc zapamiętuję tekst wielomianu.
+*/
+/**
+ * Kompiluje niepusty wiersz, który nie jest komentarzem, do instrukcji
+ * skryptu. Wiersze, które już wystąpiły, nie są ponownie parsowane.
+ * @param[in,out] script : skrypt
+ * @param[in,out] table : tablica wierszy już skompilowanych
+ * @param[in] line : wiersz
+ * @param[in] noOfChars : liczba znaków w wierszu
+ * @param[in] lineNumber : numer wiersza
+ */
+static void compileLine(PolyScript *script, InternTable *table, char *line,
+                        size_t noOfChars, uint64_t lineNumber)
+{
+	uint64_t hash = hashBytes(line, noOfChars, 0);
+	InternEntry *entry = table->capacity == 0 ? NULL :
+	                     internFind(table, line, noOfChars, hash);
+	if (entry != NULL && entry->text != NULL)
+	{
+		ScriptInstr instr = entry->instr;
+		instr.line = lineNumber;
+		ScriptAppend(script, instr);
+		return;
+	}
+
+	ErrorType errType = NO_ERROR;
+	ScriptInstr instr = {LITERAL_COMMAND, NO_ERROR, lineNumber, 0, 0, 0};
+	if (isLetter(line[0]))
+	{
+		ExecutionContext context = {NULL, 0, NULL, 0, NULL, &errType};
+		instr.op = (uint32_t)parseCommand(line, noOfChars, &context);
+		instr.arg = context.arg;
+		if (errType == NO_ERROR && context.args != NULL)
+		{
+			instr.data = ScriptAddCoeffs(script, context.args, context.argCount);
+			instr.count = context.argCount;
+		}
+		else if (errType == NO_ERROR && context.path != NULL)
+		{
+			instr.count = strlen(context.path);
+			instr.data = ScriptAddText(script, context.path, instr.count);
+		}
+		free(context.args);
+	}
+	else
+	{
+		char *nextChar = line;
+		Poly polynomial = readPoly(line, &nextChar, &errType);
+		if (nextChar != line + noOfChars)
+			errType = WRONG_POLY;
+
+		bool overflow = PolyTakeOverflow();
+		overflow |= PolyTakeTooBig();
+		if ((overflow || PolyHasBig(&polynomial)) && errType == NO_ERROR)
+		{
+			instr.op = TEXT_POLY_COMMAND;
+			instr.data = ScriptAddText(script, line, noOfChars);
+			instr.count = noOfChars;
+			PolyDestroy(&polynomial);
+		}
+		else if (errType == NO_ERROR)
+			instr.data = ScriptAddLiteral(script, polynomial);
+		else
+			PolyDestroy(&polynomial);
+	}
+	instr.error = errType;
+
+	ScriptAppend(script, instr);
+	internInsert(table, (InternEntry){line, noOfChars, hash, instr});
+}
 
-	free(line);
-}
\ No newline at end of file
+/**
+ * Kompiluje całe wejście, które musi już być w buforze wejścia.
+ * @return : skrypt z instrukcjami kolejnych wierszy
+ */
+static PolyScript compileInput()
+{
+	PolyScript script = ScriptInit();
+	InternTable table = {NULL, 0, 0};
+
+	PolySetChecked(true);
+	for (uint64_t lineNumber = 1; !checkEOF(); lineNumber++)
+	{
+		bool isComment;
+		size_t charsRead;
+		char *line = readLine(&charsRead, &isComment);
+		if (charsRead != 0 && !isComment)
+			compileLine(&script, &table, line, charsRead, lineNumber);
+	}
+	PolySetChecked(false);
+	PolyTakeOverflow();
+	PolyTakeTooBig();
+
+	free(table.entries);
+	return script;
+}
+
+/**
+ * Sprawdza, czy napis w puli skryptu ma podaną długość i się w niej mieści.
+ * @param[in] script : skrypt
+ * @param[in] offset : przesunięcie napisu
+ * @param[in] length : długość napisu
+ * @return : wynik
+ */
+static bool validText(const PolyScript *script, size_t offset, size_t length)
+{
+	return offset < script->textSize && length < script->textSize - offset &&
+	       script->text[offset + length] == '\0' &&
+	       memchr(script->text + offset, '\0', length) == NULL;
+}
+
+/**
+ * Sprawdza, czy wszystkie instrukcje wczytanego skryptu mają poprawne
+ * kody i odwołują się do istniejących danych skryptu.
+ * @param[in] script : skrypt
+ * @return : wynik
+ */
+static bool validScript(const PolyScript *script)
+{
+	for (size_t i = 0; i < script->size; i++)
+	{
+		const ScriptInstr *instr = &script->code[i];
+		size_t op = instr->op;
+		if (op > TEXT_POLY_COMMAND || instr->error > WRONG_ARGUMENT ||
+		    (instr->error == WRONG_ARGUMENT && op >= NO_OF_COMMANDS))
+			return false;
+		if (instr->error != NO_ERROR)
+			continue;
+
+		bool ok = op != ERROR_COMMAND;
+		if (op == LITERAL_COMMAND)
+			ok = instr->data < script->literals.elems;
+		else if (op == TEXT_POLY_COMMAND)
+			ok = validText(script, instr->data, instr->count);
+		else if (commandList[op].argKind == ARG_LIST)
+			ok = instr->count > 0 && instr->data <= script->coeffCount &&
+			     instr->count <= script->coeffCount - instr->data;
+		else if (commandList[op].argKind == ARG_PATH)
+			ok = instr->count > 0 && validText(script, instr->data, instr->count);
+		if (!ok)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Wykonuje instrukcję skryptu, przy której kompilacji nie wykryto błędu.
+ * @param[in] s : wskaźnik na stos
+ * @param[in] script : skrypt
+ * @param[in] instr : instrukcja
+ * @param[out] errType : wskaźnik na flagę błędu
+ */
+static void executeInstr(PolyStack *s, PolyScript *script, const ScriptInstr *instr,
+                         ErrorType *errType)
+{
+	if (instr->op == LITERAL_COMMAND)
+	{
+		Poly literal = PolyClone(&script->literals.stack[instr->data]);
+		PSPush(s, CoeffIsModular() ? PolyReduce(&literal) : literal);
+		return;
+	}
+	if (instr->op == TEXT_POLY_COMMAND)
+	{
+		handlePoly(s, script->text + instr->data, instr->count, errType);
+		return;
+	}
+
+	ExecutionContext context = {s, instr->arg, NULL, 0, NULL, errType};
+	if (commandList[instr->op].argKind == ARG_LIST)
+	{
+		context.argCount = instr->count;
+		context.args = safeMalloc(instr->count * sizeof(poly_coeff_t));
+		memcpy(context.args, script->coeffs + instr->data, instr->count * sizeof(poly_coeff_t));
+	}
+	else if (commandList[instr->op].argKind == ARG_PATH)
+		context.path = script->text + instr->data;
+
+	executeCommand(instr->op, context);
+	free(context.args);
+}
+
+/*
+Wyjaśnienie implementacji:
+Kluczem pamięci podręcznej jest skrót całego tekstu wejścia połączony
+	ze skrótem nazw poleceń, bo kody instrukcji są numerami poleceń
+	w tablicy poleceń. Plik zawiera też cały tekst wejścia, z którym
+	ScriptLoad porównuje bieżące wejście, więc kolizja skrótów nie może
+	uruchomić innego skryptu. Plik, którego nie da się wczytać lub który
+	pochodzi z innego wejścia, jest zastępowany nowo skompilowanym
+	skryptem. Kompilacja zmienia bufor wejścia w miejscu, dlatego przed
+	nią kopiuję tekst do zapisania. Nieudany zapis
+	pamięci podręcznej nie jest błędem, bo skrypt i tak zostaje wykonany.
+*/
+void PolyUIRunScript(PolyStack *s, const char *cachePath)
+{
+	while (input.data == NULL || !input.eof)
+		fillInput();
+
+	uint64_t key = hashBytes(input.data, input.end, 0);
+	for (size_t op = 0; op < NO_OF_COMMANDS; op++)
+		key = hashBytes(commandList[op].cmndName, strlen(commandList[op].cmndName), key);
+
+	PolyScript script;
+	bool cached = cachePath != NULL &&
+	              ScriptLoad(&script, cachePath, key, input.data, input.end);
+	if (cached && !validScript(&script))
+	{
+		ScriptDestroy(&script);
+		cached = false;
+	}
+	if (!cached)
+	{
+		char *source = NULL;
+		if (cachePath != NULL)
+		{
+			source = safeMalloc(input.end);
+			if (input.end != 0)
+				memcpy(source, input.data, input.end);
+		}
+		script = compileInput();
+		if (cachePath != NULL)
+			ScriptSave(&script, cachePath, key, source, input.end);
+		free(source);
+	}
+
+	for (size_t i = 0; i < script.size; i++)
+	{
+		const ScriptInstr *instr = &script.code[i];
+		ErrorType errType = (ErrorType)instr->error;
+		if (errType == NO_ERROR)
+			executeInstr(s, &script, instr, &errType);
+		if (errType != NO_ERROR)
+			printError(errType, instr->op, (int)instr->line);
+	}
+	ScriptDestroy(&script);
+}
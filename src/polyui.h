@@ -23,6 +23,11 @@ bool checkEOF();
  */
 void PolyUIInit();
 
+/**
+ * Zwalnia zasoby interfejsu użytkownika, w tym skompilowane programy.
+ */
+void PolyUIDestroy();
+
 /**
  * Czyta następny wiersz wejścia standardowego i w pełni go obsługuje.
  * @param[in] s : wskaźnik na stos wielomianowy, na którym ma być
@@ -30,4 +35,17 @@ void PolyUIInit();
  */
 void handleLine(PolyStack *s);
 
+/**
+ * Wczytuje całe wejście standardowe, kompiluje je do skryptu i wykonuje
+ * go na stosie. Wynik i komunikaty o błędach są takie same jak przy
+ * obsłudze kolejnych wierszy funkcją handleLine, ale powtarzające się
+ * wiersze są parsowane tylko raz. Jeżeli podano ścieżkę pamięci
+ * podręcznej, a zapisany w niej skrypt pochodzi z takiego samego wejścia,
+ * to tekst nie jest w ogóle parsowany. W przeciwnym przypadku skompilowany
+ * skrypt jest w niej zapisywany.
+ * @param[in] s : wskaźnik na stos wielomianowy
+ * @param[in] cachePath : ścieżka do pliku pamięci podręcznej lub NULL
+ */
+void PolyUIRunScript(PolyStack *s, const char *cachePath);
+
 #endif /* __POLY_UI_H__ */
\ No newline at end of file
@@ -6,6 +6,10 @@
  */
 
 #include "safealloc.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <string.h>
 
 /**
  * Kod błędu, z którym program ma się zakończyć, jeżeli
@@ -37,4 +41,231 @@ void safeRealloc(void **bufferPointer, size_t newSize)
 	}
 	if (*bufferPointer == NULL && newSize != 0)
 		exit(MEM_PROBLEM_CODE);
+}
+
+/**
+ * Logarytm dwójkowy rozmiaru najmniejszego bloku puli (wraz z nagłówkiem).
+ */
+#define POOL_MIN_SHIFT 5
+
+/**
+ * Liczba klas rozmiarów bloków puli. Największy blok z puli
+ * ma rozmiar @f$2^{POOL\_MIN\_SHIFT + POOL\_CLASSES - 1}@f$ bajtów.
+ */
+#define POOL_CLASSES 12
+
+/**
+ * Klasa bloków większych od największej klasy puli,
+ * alokowanych bezpośrednio za pomocą `malloc`.
+ */
+#define POOL_LARGE POOL_CLASSES
+
+/**
+ * Rozmiar strony pamięci, z której wycinane są bloki puli.
+ */
+#define POOL_PAGE_SIZE (1 << 20)
+
+/**
+ * Nagłówek bloku puli, poprzedzający pamięć zwracaną użytkownikowi.
+ * Licznik referencji pozwala współdzielić blok przez wielu właścicieli,
+ * także z różnych wątków, dlatego jest atomowy. Unia z `max_align_t`
+ * gwarantuje wyrównanie pamięci za nagłówkiem.
+ */
+typedef union PoolHeader
+{
+	struct
+	{
+		size_t sizeClass; ///< klasa rozmiaru bloku
+		atomic_size_t refs; ///< licznik referencji bloku
+	};
+	max_align_t align; ///< wyrównanie
+} PoolHeader;
+
+/**
+ * Strona pamięci puli. Strony tworzą listę, dzięki której
+ * można je wszystkie zwolnić na koniec działania programu.
+ */
+typedef struct PoolPage
+{
+	struct PoolPage *next; ///< następna strona na liście
+	max_align_t data[]; ///< pamięć, z której wycinane są bloki
+} PoolPage;
+
+/**
+ * Listy wolnych bloków dla każdej klasy rozmiaru.
+ * Wskaźnik na następny wolny blok jest trzymany w treści bloku.
+ * Każdy wątek ma własne listy, więc alokacje nie wymagają blokad,
+ * a blok zwolniony przez inny wątek niż ten, który go zaalokował,
+ * trafia po prostu na listę zwalniającego wątku.
+ */
+static _Thread_local void *poolFreeLists[POOL_CLASSES];
+
+/**
+ * Lista stron pamięci puli, wspólna dla wszystkich wątków.
+ */
+static PoolPage *poolPages = NULL;
+
+/**
+ * Blokada listy stron pamięci puli.
+ */
+static pthread_mutex_t poolPagesLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Początek niewykorzystanej części bieżącej strony wątku.
+ */
+static _Thread_local char *poolBump = NULL;
+
+/**
+ * Koniec bieżącej strony wątku.
+ */
+static _Thread_local char *poolBumpEnd = NULL;
+
+/**
+ * Wyznacza klasę bloku mieszczącego @p size bajtów danych.
+ * @param[in] size : liczba bajtów danych
+ * @return : klasa rozmiaru lub POOL_LARGE
+ */
+static size_t poolClassOf(size_t size)
+{
+	size_t total = size + sizeof(PoolHeader);
+	if (total <= ((size_t)1 << POOL_MIN_SHIFT))
+		return 0;
+	size_t shift = 8 * sizeof(unsigned long) - __builtin_clzl(total - 1);
+	return shift - POOL_MIN_SHIFT < POOL_CLASSES ? shift - POOL_MIN_SHIFT : POOL_LARGE;
+}
+
+/**
+ * Zwraca liczbę bajtów danych mieszczących się w bloku danej klasy.
+ * @param[in] sizeClass : klasa rozmiaru różna od POOL_LARGE
+ * @return : pojemność bloku
+ */
+static size_t poolClassCapacity(size_t sizeClass)
+{
+	return ((size_t)1 << (sizeClass + POOL_MIN_SHIFT)) - sizeof(PoolHeader);
+}
+
+/**
+ * Wycina nowy blok danej klasy z bieżącej strony,
+ * w razie potrzeby alokując nową stronę.
+ * @param[in] sizeClass : klasa rozmiaru różna od POOL_LARGE
+ * @return : wskaźnik na nagłówek nowego bloku
+ */
+static PoolHeader *poolCarve(size_t sizeClass)
+{
+	size_t blockSize = (size_t)1 << (sizeClass + POOL_MIN_SHIFT);
+	if (poolBump == NULL || (size_t)(poolBumpEnd - poolBump) < blockSize)
+	{
+		PoolPage *page = safeMalloc(sizeof(PoolPage) + POOL_PAGE_SIZE);
+		pthread_mutex_lock(&poolPagesLock);
+		page->next = poolPages;
+		poolPages = page;
+		pthread_mutex_unlock(&poolPagesLock);
+		poolBump = (char*)page->data;
+		poolBumpEnd = poolBump + POOL_PAGE_SIZE;
+	}
+	PoolHeader *header = (PoolHeader*)poolBump;
+	poolBump += blockSize;
+	return header;
+}
+
+void *poolMalloc(size_t size)
+{
+	if (size == 0)
+		return NULL;
+
+	size_t sizeClass = poolClassOf(size);
+	PoolHeader *header;
+
+	if (sizeClass == POOL_LARGE)
+	{
+		header = safeMalloc(sizeof(PoolHeader) + size);
+	}
+	else if (poolFreeLists[sizeClass] != NULL)
+	{
+		header = (PoolHeader*)poolFreeLists[sizeClass] - 1;
+		poolFreeLists[sizeClass] = *(void**)poolFreeLists[sizeClass];
+	}
+	else
+	{
+		header = poolCarve(sizeClass);
+	}
+
+	header->sizeClass = sizeClass;
+	atomic_init(&header->refs, 1);
+	return header + 1;
+}
+
+void poolFree(void *pointer)
+{
+	if (pointer == NULL)
+		return;
+
+	PoolHeader *header = (PoolHeader*)pointer - 1;
+	if (header->sizeClass == POOL_LARGE)
+	{
+		free(header);
+	}
+	else
+	{
+		*(void**)pointer = poolFreeLists[header->sizeClass];
+		poolFreeLists[header->sizeClass] = pointer;
+	}
+}
+
+void poolRealloc(void **bufferPointer, size_t newSize)
+{
+	void *pointer = *bufferPointer;
+	if (pointer == NULL || newSize == 0)
+	{
+		poolFree(pointer);
+		*bufferPointer = poolMalloc(newSize);
+		return;
+	}
+
+	PoolHeader *header = (PoolHeader*)pointer - 1;
+	size_t newClass = poolClassOf(newSize);
+
+	if (header->sizeClass == POOL_LARGE && newClass == POOL_LARGE)
+	{
+		safeRealloc((void**)&header, sizeof(PoolHeader) + newSize);
+		*bufferPointer = header + 1;
+	}
+	else if (header->sizeClass != newClass)
+	{
+		size_t oldCapacity = header->sizeClass == POOL_LARGE ?
+		                     newSize : poolClassCapacity(header->sizeClass);
+		void *newPointer = poolMalloc(newSize);
+		memcpy(newPointer, pointer, oldCapacity < newSize ? oldCapacity : newSize);
+		poolFree(pointer);
+		*bufferPointer = newPointer;
+	}
+}
+
+void poolRefInc(void *pointer)
+{
+	atomic_fetch_add_explicit(&((PoolHeader*)pointer - 1)->refs, 1, memory_order_relaxed);
+}
+
+size_t poolRefDec(void *pointer)
+{
+	return atomic_fetch_sub_explicit(&((PoolHeader*)pointer - 1)->refs, 1,
+	                                 memory_order_acq_rel) - 1;
+}
+
+size_t poolRefCount(const void *pointer)
+{
+	return atomic_load_explicit(&((PoolHeader*)pointer - 1)->refs, memory_order_acquire);
+}
+
+void poolRelease(void)
+{
+	while (poolPages != NULL)
+	{
+		PoolPage *next = poolPages->next;
+		free(poolPages);
+		poolPages = next;
+	}
+	for (size_t i = 0; i < POOL_CLASSES; i++)
+		poolFreeLists[i] = NULL;
+	poolBump = poolBumpEnd = NULL;
 }
\ No newline at end of file
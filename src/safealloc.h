@@ -35,4 +35,64 @@ void *safeMalloc(size_t size);
  */
 void safeRealloc(void **bufferPointer, size_t newSize);
 
+/**
+ * Alokuje pamięć z puli bloków z obsługą błędu alokacji.
+ * Bloki są grupowane w klasy rozmiarów będących potęgami dwójki
+ * i wycinane z dużych stron pamięci. Zwolnione bloki trafiają na
+ * listę wolnych bloków swojej klasy i są ponownie wykorzystywane
+ * przez kolejne alokacje, bez odwoływania się do `malloc` i `free`.
+ * Bloki większe niż największa klasa są alokowane za pomocą `malloc`.
+ * Pamięć zaalokowaną tą funkcją należy zwalniać funkcją poolFree.
+ * @param[in] size : liczba bajtów do alokacji
+ * @return : wskaźnik na zaalokowany blok pamięci lub NULL dla @p size równego 0
+ */
+void *poolMalloc(size_t size);
+
+/**
+ * Realokuje blok pamięci z puli z obsługą błędu alokacji.
+ * Jeżeli nowy rozmiar mieści się w klasie bloku, to blok pozostaje
+ * na miejscu. W przeciwnym przypadku zawartość jest przenoszona do
+ * bloku odpowiedniej klasy i automatycznie podmieniany jest wskaźnik.
+ * @param[in,out] bufferPointer : wskaźnik na wskaźnik na bufor z puli
+ * @param[in] newSize : nowy rozmiar bufora w bajtach
+ */
+void poolRealloc(void **bufferPointer, size_t newSize);
+
+/**
+ * Zwraca blok pamięci do puli.
+ * @param[in] pointer : wskaźnik na blok zaalokowany przez poolMalloc lub NULL
+ */
+void poolFree(void *pointer);
+
+/**
+ * Zwiększa licznik referencji bloku z puli.
+ * Każdy blok zaalokowany przez poolMalloc ma początkowo jedną referencję.
+ * @param[in] pointer : wskaźnik na blok z puli
+ */
+void poolRefInc(void *pointer);
+
+/**
+ * Zmniejsza licznik referencji bloku z puli.
+ * Nie zwalnia bloku, jeżeli licznik spadnie do zera - robi to wywołujący,
+ * który może wcześniej zwolnić zasoby wskazywane przez zawartość bloku.
+ * @param[in] pointer : wskaźnik na blok z puli
+ * @return : liczba referencji pozostałych po zmniejszeniu licznika
+ */
+size_t poolRefDec(void *pointer);
+
+/**
+ * Zwraca wartość licznika referencji bloku z puli.
+ * @param[in] pointer : wskaźnik na blok z puli
+ * @return : liczba referencji bloku
+ */
+size_t poolRefCount(const void *pointer);
+
+/**
+ * Zwalnia wszystkie strony pamięci puli.
+ * Po wywołaniu tej funkcji żaden blok zaalokowany wcześniej
+ * przez poolMalloc nie może być już używany. Funkcję można wywołać
+ * dopiero wtedy, gdy żaden inny wątek nie korzysta już z puli.
+ */
+void poolRelease(void);
+
 #endif /* __SAFE_ALLOC_H__ */
\ No newline at end of file
@@ -0,0 +1,325 @@
+/** @file
+ * @brief Implementacja puli wątków wykonujących zadania z podkradaniem pracy.
+ *
+ * @author Maurycy Wojda
+ * @date 2021
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "taskpool.h"
+#include "safealloc.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+/**
+ * Początkowa pojemność kolejki zadań wątku.
+ */
+#define TASK_QUEUE_SIZE 64
+
+/**
+ * To jest struktura zleconego zadania.
+ */
+typedef struct Task
+{
+	TaskFunction function; ///< funkcja zadania
+	void *arg; ///< argument funkcji zadania
+	TaskGroup *group; ///< grupa zadania
+} Task;
+
+/**
+ * To jest struktura kolejki zadań jednego wątku. Właściciel dokłada
+ * i zdejmuje zadania z końca, a pozostałe wątki podkradają je z początku.
+ */
+typedef struct TaskQueue
+{
+	pthread_mutex_t lock; ///< blokada kolejki
+	Task *tasks; ///< tablica zadań
+	size_t head; ///< indeks pierwszego zadania
+	size_t tail; ///< indeks za ostatnim zadaniem
+	size_t size; ///< pojemność tablicy zadań
+} TaskQueue;
+
+/**
+ * Liczba wątków puli.
+ */
+static size_t taskThreads = 1;
+
+/**
+ * Kolejki zadań kolejnych wątków puli.
+ */
+static TaskQueue *taskQueues = NULL;
+
+/**
+ * Uchwyty wątków utworzonych przez pulę.
+ */
+static pthread_t *taskWorkers = NULL;
+
+/**
+ * Indeks kolejki wątku wykonującego kod.
+ */
+static _Thread_local size_t taskIndex = 0;
+
+/**
+ * Liczba zadań czekających w kolejkach.
+ */
+static atomic_size_t taskQueued;
+
+/**
+ * Czy wątki puli mają zakończyć pracę?
+ */
+static atomic_bool taskShutdown;
+
+/**
+ * Blokada, pod którą bezczynne wątki czekają na nowe zadania
+ * lub zakończenie grupy zadań.
+ */
+static pthread_mutex_t taskIdleLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Zmienna warunkowa budząca bezczynne wątki po zleceniu zadania
+ * i po zakończeniu ostatniego zadania grupy.
+ */
+static pthread_cond_t taskIdleCond = PTHREAD_COND_INITIALIZER;
+
+/**
+ * Zdejmuje zadanie z końca kolejki bieżącego wątku lub, gdy jest pusta,
+ * podkrada je z początku kolejki innego wątku.
+ * @param[out] task : zdjęte zadanie
+ * @return czy udało się zdjąć zadanie?
+ */
+static bool taskTake(Task *task)
+{
+	if (atomic_load(&taskQueued) == 0)
+		return false;
+
+	for (size_t i = 0; i < taskThreads; i++)
+	{
+		size_t victim = (taskIndex + i) % taskThreads;
+		TaskQueue *queue = &taskQueues[victim];
+		bool found = false;
+
+		pthread_mutex_lock(&queue->lock);
+		if (queue->head < queue->tail)
+		{
+			*task = victim == taskIndex ? queue->tasks[--queue->tail] :
+			                              queue->tasks[queue->head++];
+			found = true;
+		}
+		pthread_mutex_unlock(&queue->lock);
+
+		if (found)
+		{
+			atomic_fetch_sub(&taskQueued, 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Wykonuje zadanie i oznacza je jako zakończone w jego grupie.
+ * Po ostatnim zadaniu grupy budzi wątki czekające w TaskWait.
+ * Grupa może przestać istnieć zaraz po zmniejszeniu licznika,
+ * więc potem nie jest już używana.
+ * @param[in] task : zadanie
+ */
+static void taskRun(Task task)
+{
+	task.function(task.arg);
+	if (atomic_fetch_sub_explicit(&task.group->pending, 1, memory_order_acq_rel) == 1 &&
+	    taskQueues != NULL)
+	{
+		pthread_mutex_lock(&taskIdleLock);
+		pthread_cond_broadcast(&taskIdleCond);
+		pthread_mutex_unlock(&taskIdleLock);
+	}
+}
+
+/**
+ * Pętla wątku puli: wykonuje dostępne zadania, a gdy ich brak,
+ * zasypia do czasu zlecenia kolejnych.
+ * @param[in] arg : indeks kolejki wątku
+ * @return NULL
+ */
+static void *taskWorkerLoop(void *arg)
+{
+	taskIndex = (size_t)arg;
+	Task task;
+
+	while (true)
+	{
+		if (taskTake(&task))
+		{
+			taskRun(task);
+			continue;
+		}
+
+		pthread_mutex_lock(&taskIdleLock);
+		while (atomic_load(&taskQueued) == 0 && !atomic_load(&taskShutdown))
+			pthread_cond_wait(&taskIdleCond, &taskIdleLock);
+		pthread_mutex_unlock(&taskIdleLock);
+
+		if (atomic_load(&taskShutdown))
+			return NULL;
+	}
+}
+
+void TaskPoolInit(size_t threads)
+{
+	assert(threads >= 1 && taskQueues == NULL);
+	taskThreads = threads;
+	if (threads == 1)
+		return;
+
+	atomic_init(&taskQueued, 0);
+	atomic_init(&taskShutdown, false);
+	taskQueues = safeMalloc(threads * sizeof(TaskQueue));
+	for (size_t i = 0; i < threads; i++)
+	{
+		pthread_mutex_init(&taskQueues[i].lock, NULL);
+		taskQueues[i].tasks = safeMalloc(TASK_QUEUE_SIZE * sizeof(Task));
+		taskQueues[i].head = taskQueues[i].tail = 0;
+		taskQueues[i].size = TASK_QUEUE_SIZE;
+	}
+
+	taskIndex = 0;
+	taskWorkers = safeMalloc((threads - 1) * sizeof(pthread_t));
+	size_t started = 1;
+	while (started < threads &&
+	       pthread_create(&taskWorkers[started - 1], NULL, taskWorkerLoop, (void*)started) == 0)
+		started++;
+	if (started == threads)
+		return;
+
+	// Nie udało się utworzyć wszystkich wątków, więc pula działa z tymi,
+	// które powstały, a bez żadnego wykonuje zadania szeregowo. Żadne
+	// zadanie nie jest jeszcze zlecone, więc wątki nie czytają liczby
+	// wątków, zanim zostanie zmniejszona.
+	for (size_t i = started; i < threads; i++)
+	{
+		pthread_mutex_destroy(&taskQueues[i].lock);
+		free(taskQueues[i].tasks);
+	}
+	taskThreads = started;
+	if (started == 1)
+	{
+		free(taskQueues[0].tasks);
+		pthread_mutex_destroy(&taskQueues[0].lock);
+		free(taskQueues);
+		free(taskWorkers);
+		taskQueues = NULL;
+		taskWorkers = NULL;
+	}
+}
+
+void TaskPoolDestroy(void)
+{
+	if (taskQueues == NULL)
+		return;
+
+	pthread_mutex_lock(&taskIdleLock);
+	atomic_store(&taskShutdown, true);
+	pthread_cond_broadcast(&taskIdleCond);
+	pthread_mutex_unlock(&taskIdleLock);
+
+	for (size_t i = 1; i < taskThreads; i++)
+		pthread_join(taskWorkers[i - 1], NULL);
+	for (size_t i = 0; i < taskThreads; i++)
+	{
+		pthread_mutex_destroy(&taskQueues[i].lock);
+		free(taskQueues[i].tasks);
+	}
+	free(taskQueues);
+	free(taskWorkers);
+	taskQueues = NULL;
+	taskWorkers = NULL;
+	taskThreads = 1;
+}
+
+size_t TaskPoolThreads(void)
+{
+	return taskThreads;
+}
+
+size_t TaskChunkCount(size_t length, uint64_t work)
+{
+	uint64_t chunks = work / TASK_MIN_WORK;
+	if (chunks > taskThreads * TASK_CHUNKS_PER_THREAD)
+		chunks = taskThreads * TASK_CHUNKS_PER_THREAD;
+	if (chunks > length)
+		chunks = length;
+	return taskThreads == 1 || chunks == 0 ? 1 : (size_t)chunks;
+}
+
+/*
+Wyjaśnienie implementacji:
+Bez działającej puli zadanie jest wykonywane od razu. W przeciwnym
+	przypadku trafia na koniec kolejki bieżącego wątku. Licznik zadań
+	w kolejkach rośnie pod blokadą kolejki, zanim ktokolwiek może
+	zadanie z niej zdjąć, a bezczynny wątek jest budzony pod blokadą,
+	pod którą wątki sprawdzają ten licznik przed zaśnięciem, więc żadne
+	zbudzenie nie może zostać przegapione.
+*/
+void TaskSpawn(TaskGroup *group, TaskFunction function, void *arg)
+{
+	atomic_fetch_add(&group->pending, 1);
+	Task task = {.function = function, .arg = arg, .group = group};
+	if (taskQueues == NULL)
+	{
+		taskRun(task);
+		return;
+	}
+
+	TaskQueue *queue = &taskQueues[taskIndex];
+	pthread_mutex_lock(&queue->lock);
+	if (queue->tail == queue->size)
+	{
+		memmove(queue->tasks, queue->tasks + queue->head,
+		        (queue->tail - queue->head) * sizeof(Task));
+		queue->tail -= queue->head;
+		queue->head = 0;
+		if (queue->tail * 2 > queue->size)
+		{
+			queue->size *= 2;
+			safeRealloc((void**)&queue->tasks, queue->size * sizeof(Task));
+		}
+	}
+	queue->tasks[queue->tail++] = task;
+	atomic_fetch_add(&taskQueued, 1);
+	pthread_mutex_unlock(&queue->lock);
+
+	pthread_mutex_lock(&taskIdleLock);
+	pthread_cond_signal(&taskIdleCond);
+	pthread_mutex_unlock(&taskIdleLock);
+}
+
+/*
+Wyjaśnienie implementacji:
+Dopóki są zadania w kolejkach, wykonuję je, pomagając w ten sposób
+	pozostałym wątkom. Gdy kolejki są puste, a zadania grupy wciąż
+	wykonują inne wątki, zasypiam na zmiennej warunkowej bezczynnych
+	wątków. Budzi ją zarówno zlecenie zadania, jak i zakończenie
+	ostatniego zadania grupy, a oba warunki sprawdzam pod blokadą, pod
+	którą jest budzona, więc żadne zbudzenie nie może zostać przegapione.
+*/
+void TaskWait(TaskGroup *group)
+{
+	Task task;
+	while (atomic_load_explicit(&group->pending, memory_order_acquire) > 0)
+	{
+		if (taskTake(&task))
+		{
+			taskRun(task);
+			continue;
+		}
+
+		pthread_mutex_lock(&taskIdleLock);
+		while (atomic_load(&taskQueued) == 0 &&
+		       atomic_load_explicit(&group->pending, memory_order_acquire) > 0)
+			pthread_cond_wait(&taskIdleCond, &taskIdleLock);
+		pthread_mutex_unlock(&taskIdleLock);
+	}
+}
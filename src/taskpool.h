@@ -0,0 +1,106 @@
+/** @file
+ * @brief Interfejs puli wątków wykonujących zadania z podkradaniem pracy.
+ *
+ * Każdy wątek puli, łącznie z wątkiem, który ją utworzył, ma własną
+ * kolejkę zadań. Nowe zadania trafiają do kolejki wątku, który je zlecił,
+ * i są z niej zdejmowane od końca, a bezczynne wątki podkradają zadania
+ * z początków kolejek innych wątków. Czekający na grupę zadań wątek sam
+ * wykonuje zadania, więc zadania mogą bezpiecznie zlecać kolejne zadania.
+ *
+ * @author Maurycy Wojda
+ * @date 2021
+ */
+
+#ifndef __TASK_POOL_H__
+#define __TASK_POOL_H__
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Nazwa zmiennej środowiskowej z liczbą wątków puli.
+ */
+#define TASK_POOL_ENV "POLY_THREADS"
+
+/**
+ * Najmniejsza liczba elementarnych operacji, dla której opłaca się
+ * wydzielić fragment pracy jako osobne zadanie.
+ */
+#define TASK_MIN_WORK (1 << 15)
+
+/**
+ * Liczba fragmentów pracy przypadających na jeden wątek przy podziale,
+ * dzięki której wątki mogą wyrównywać nierówne fragmenty podkradaniem.
+ */
+#define TASK_CHUNKS_PER_THREAD 4
+
+/**
+ * Typ funkcji wykonywanej jako zadanie.
+ */
+typedef void (*TaskFunction)(void *arg);
+
+/**
+ * To jest struktura grupy zadań, na których zakończenie można czekać.
+ */
+typedef struct TaskGroup
+{
+	atomic_size_t pending; ///< liczba niezakończonych zadań grupy
+} TaskGroup;
+
+/**
+ * Tworzy pustą grupę zadań.
+ * @return grupa zadań
+ */
+static inline TaskGroup TaskGroupInit(void)
+{
+	TaskGroup group;
+	atomic_init(&group.pending, 0);
+	return group;
+}
+
+/**
+ * Uruchamia pulę wątków. Wątek wywołujący staje się jednym z wątków puli,
+ * więc tworzonych jest @p threads - 1 nowych wątków. Dla @p threads równego
+ * 1 pula nie tworzy wątków, a zadania są wykonywane od razu przy zleceniu.
+ * @param[in] threads : liczba wątków puli, co najmniej 1
+ */
+void TaskPoolInit(size_t threads);
+
+/**
+ * Kończy pracę wątków puli i zwalnia jej zasoby.
+ * Wszystkie zlecone zadania muszą być zakończone.
+ */
+void TaskPoolDestroy(void);
+
+/**
+ * Zwraca liczbę wątków puli.
+ * @return liczba wątków, 1 jeżeli pula nie działa
+ */
+size_t TaskPoolThreads(void);
+
+/**
+ * Wyznacza liczbę fragmentów, na które warto podzielić @p length elementów
+ * o łącznym koszcie @p work operacji.
+ * @param[in] length : liczba elementów do podziału
+ * @param[in] work : szacowany koszt całej pracy
+ * @return liczba fragmentów z przedziału @f$[1, length]@f$
+ */
+size_t TaskChunkCount(size_t length, uint64_t work);
+
+/**
+ * Zleca wykonanie zadania w ramach grupy.
+ * @param[in,out] group : grupa zadania
+ * @param[in] function : funkcja zadania
+ * @param[in] arg : argument funkcji zadania
+ */
+void TaskSpawn(TaskGroup *group, TaskFunction function, void *arg);
+
+/**
+ * Czeka na zakończenie wszystkich zadań grupy, wykonując w tym czasie
+ * zadania z kolejek puli.
+ * @param[in,out] group : grupa zadań
+ */
+void TaskWait(TaskGroup *group);
+
+#endif /* __TASK_POOL_H__ */
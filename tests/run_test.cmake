@@ -0,0 +1,60 @@
+# Uruchamia jeden test regresyjny kalkulatora: cmake -DPOLY=<plik wykonywalny>
+# -DTEST_DIR=<katalog testów> -DWORK_DIR=<katalog roboczy> -DNAME=<nazwa>
+# -P run_test.cmake
+#
+# Test składa się z kroków: NAME.in, NAME.2.in, NAME.3.in itd. Każdy krok
+# uruchamia kalkulator w tym samym katalogu roboczym, więc pliki zapisane
+# w jednym kroku (SAVE, --cache) są widoczne w kolejnych. Wyjście kroku
+# porównujemy z plikami .out i .err o tej samej nazwie, a jeśli istnieje
+# plik .args, to jego zawartość przekazujemy kalkulatorowi jako argumenty.
+
+foreach (var POLY TEST_DIR WORK_DIR NAME)
+	if (NOT DEFINED ${var})
+		message(FATAL_ERROR "Brak parametru ${var}")
+	endif ()
+endforeach ()
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+
+set(step "${NAME}")
+set(next 2)
+while (EXISTS "${TEST_DIR}/${step}.in")
+	set(args "")
+	if (EXISTS "${TEST_DIR}/${step}.args")
+		file(READ "${TEST_DIR}/${step}.args" args)
+		string(STRIP "${args}" args)
+		separate_arguments(args)
+	endif ()
+
+	execute_process(
+		COMMAND "${POLY}" ${args}
+		INPUT_FILE "${TEST_DIR}/${step}.in"
+		OUTPUT_VARIABLE out
+		ERROR_VARIABLE err
+		RESULT_VARIABLE result
+		WORKING_DIRECTORY "${WORK_DIR}"
+	)
+	if (NOT result EQUAL 0)
+		message(FATAL_ERROR "${step}: kod wyjścia ${result}\n${err}")
+	endif ()
+
+	foreach (stream out err)
+		set(expected "")
+		if (EXISTS "${TEST_DIR}/${step}.${stream}")
+			file(READ "${TEST_DIR}/${step}.${stream}" expected)
+		endif ()
+		if (NOT "${${stream}}" STREQUAL "${expected}")
+			file(WRITE "${WORK_DIR}/${step}.${stream}" "${${stream}}")
+			message(FATAL_ERROR "${step}: plik .${stream} różni się od "
+			        "oczekiwanego, wynik zapisano w ${WORK_DIR}/${step}.${stream}")
+		endif ()
+	endforeach ()
+
+	set(step "${NAME}.${next}")
+	math(EXPR next "${next} + 1")
+endwhile ()
+
+if (next EQUAL 2)
+	message(FATAL_ERROR "Brak pliku ${TEST_DIR}/${NAME}.in")
+endif ()